@@ -0,0 +1,226 @@
+//
+// Copyright (c) 2008-2016 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "../Precompiled.h"
+
+#include "../Audio/AmbisonicBed.h"
+#include "../Audio/AudioKernels.h"
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+/// Samples per channel decoded from an emitter at a time.
+static const unsigned EMITTER_BLOCK_SIZE = 256;
+/// Decode gain of the virtual cardioids, chosen so that a frontal emitter matches a centered voice.
+static const float CARDIOID_DECODE_GAIN = 0.70710678f;
+
+static float ReadEmitterSample(AmbientEmitter* emitter)
+{
+    if (emitter->position_ >= EMITTER_BLOCK_SIZE)
+    {
+        memset(&emitter->buffer_[0], 0, emitter->buffer_.Size() * sizeof(float));
+        if (!emitter->instance_->hasEnded())
+            emitter->instance_->getAudio(&emitter->buffer_[0], EMITTER_BLOCK_SIZE);
+        emitter->position_ = 0;
+    }
+
+    // Downmix to mono; direction comes from the emitter position only
+    float sum = 0.0f;
+    for (unsigned i = 0; i < emitter->channels_; ++i)
+        sum += emitter->buffer_[i * EMITTER_BLOCK_SIZE + emitter->position_];
+    ++emitter->position_;
+    emitter->time_ += emitter->sampleTime_;
+
+    return sum / emitter->channels_;
+}
+
+AmbientEmitter::AmbientEmitter() :
+    instance_(0),
+    channels_(1),
+    position_(EMITTER_BLOCK_SIZE),
+    previous_(0.0f),
+    next_(0.0f),
+    fraction_(1.0),
+    step_(1.0),
+    time_(0.0),
+    sampleTime_(0.0),
+    gain_(0.0f),
+    currentGain_(0.0f),
+    direction_(Vector3::FORWARD)
+{
+}
+
+AmbientEmitter::~AmbientEmitter()
+{
+    delete instance_;
+}
+
+AmbisonicBedInstance::AmbisonicBedInstance(AmbisonicBed* parent) :
+    parent_(parent)
+{
+}
+
+AmbisonicBedInstance::~AmbisonicBedInstance()
+{
+}
+
+void AmbisonicBedInstance::getAudio(float* aBuffer, unsigned int aSamples)
+{
+    mono_.Resize(aSamples);
+    w_.Resize(aSamples);
+    x_.Resize(aSamples);
+    y_.Resize(aSamples);
+    z_.Resize(aSamples);
+    memset(&w_[0], 0, aSamples * sizeof(float));
+    memset(&x_[0], 0, aSamples * sizeof(float));
+    memset(&y_[0], 0, aSamples * sizeof(float));
+    memset(&z_[0], 0, aSamples * sizeof(float));
+
+    // Encode: each emitter costs a resample and four accumulations regardless of the output layout
+    const PODVector<AmbientEmitter*>& emitters = parent_->emitters_;
+    for (unsigned i = 0; i < emitters.Size(); ++i)
+    {
+        AmbientEmitter* emitter = emitters[i];
+        // Inaudible emitters pause instead of decoding silence
+        if (emitter->gain_ <= 0.0f && emitter->currentGain_ <= 0.0f)
+            continue;
+
+        RenderEmitter(emitter, aSamples);
+        const Vector3& direction = emitter->direction_;
+        AccumulateSamples(&w_[0], &mono_[0], 1.0f, aSamples);
+        AccumulateSamples(&x_[0], &mono_[0], direction.x_, aSamples);
+        AccumulateSamples(&y_[0], &mono_[0], direction.y_, aSamples);
+        AccumulateSamples(&z_[0], &mono_[0], direction.z_, aSamples);
+    }
+
+    if (mChannels < 2)
+    {
+        memcpy(aBuffer, &w_[0], aSamples * sizeof(float));
+        return;
+    }
+
+    // Rotate into listener space once per block. A stereo decode only needs the lateral component
+    Vector3 right = parent_->listenerRotation_ * Vector3::RIGHT;
+    float* left = aBuffer;
+    float* rightOut = aBuffer + aSamples;
+    for (unsigned i = 0; i < aSamples; ++i)
+    {
+        float lateral = right.x_ * x_[i] + right.y_ * y_[i] + right.z_ * z_[i];
+        left[i] = CARDIOID_DECODE_GAIN * (w_[i] - lateral);
+        rightOut[i] = CARDIOID_DECODE_GAIN * (w_[i] + lateral);
+    }
+
+    // Further channels, if any, stay silent
+    for (unsigned i = 2; i < mChannels; ++i)
+        memset(aBuffer + i * aSamples, 0, aSamples * sizeof(float));
+}
+
+void AmbisonicBedInstance::RenderEmitter(AmbientEmitter* emitter, unsigned samples)
+{
+    float gain = emitter->currentGain_;
+    float gainStep = (emitter->gain_ - emitter->currentGain_) / samples;
+
+    // Linear interpolation is enough for diffuse, distant ambience
+    for (unsigned i = 0; i < samples; ++i)
+    {
+        while (emitter->fraction_ >= 1.0)
+        {
+            emitter->previous_ = emitter->next_;
+            emitter->next_ = ReadEmitterSample(emitter);
+            emitter->fraction_ -= 1.0;
+        }
+
+        mono_[i] = (emitter->previous_ + (emitter->next_ - emitter->previous_) * (float)emitter->fraction_) * gain;
+        gain += gainStep;
+        emitter->fraction_ += emitter->step_;
+    }
+
+    emitter->currentGain_ = emitter->gain_;
+}
+
+AmbisonicBed::AmbisonicBed()
+{
+    mChannels = 2;
+}
+
+AmbisonicBed::~AmbisonicBed()
+{
+    // Stop here, as the instance reads the emitters
+    stop();
+
+    for (unsigned i = 0; i < emitters_.Size(); ++i)
+        delete emitters_[i];
+}
+
+SoLoud::AudioSourceInstance* AmbisonicBed::createInstance()
+{
+    return new AmbisonicBedInstance(this);
+}
+
+AmbientEmitter* AmbisonicBed::CreateEmitter(SoLoud::AudioSource* source, bool looped, double position, float gain,
+    const Vector3& direction) const
+{
+    AmbientEmitter* emitter = new AmbientEmitter();
+    emitter->instance_ = source->createInstance();
+    emitter->instance_->init(*source, 0);
+    if (looped)
+        emitter->instance_->mFlags |= SoLoud::AudioSourceInstance::LOOPING;
+    if (position > 0.0)
+        emitter->instance_->seek(position, 0, 0);
+
+    emitter->channels_ = Max((int)source->mChannels, 1);
+    emitter->buffer_.Resize(EMITTER_BLOCK_SIZE * emitter->channels_);
+    emitter->step_ = mBaseSamplerate > 0.0f ? source->mBaseSamplerate / mBaseSamplerate : 1.0;
+    emitter->time_ = Max(position, 0.0);
+    emitter->sampleTime_ = source->mBaseSamplerate > 0.0f ? 1.0 / source->mBaseSamplerate : 0.0;
+    emitter->gain_ = gain;
+    // Ramp in over the first block to avoid a click
+    emitter->currentGain_ = 0.0f;
+    emitter->direction_ = direction;
+    return emitter;
+}
+
+void AmbisonicBed::AddEmitter(AmbientEmitter* emitter)
+{
+    emitters_.Push(emitter);
+}
+
+void AmbisonicBed::SetEmitter(AmbientEmitter* emitter, float gain, const Vector3& direction)
+{
+    emitter->gain_ = gain;
+    emitter->direction_ = direction;
+}
+
+void AmbisonicBed::RemoveEmitter(AmbientEmitter* emitter)
+{
+    PODVector<AmbientEmitter*>::Iterator i = emitters_.Find(emitter);
+    if (i != emitters_.End())
+    {
+        emitters_.Erase(i);
+        delete emitter;
+    }
+}
+
+}
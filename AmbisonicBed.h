@@ -0,0 +1,137 @@
+//
+// Copyright (c) 2008-2016 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../Container/Vector.h"
+#include "../Math/Quaternion.h"
+#include "soloud.h"
+
+namespace Urho3D
+{
+
+class AmbisonicBed;
+
+/// Ambient emitter encoded into the ambisonic bed: a voiceless source instance with its gain and direction from the listener.
+struct AmbientEmitter
+{
+    /// Construct.
+    AmbientEmitter();
+    /// Destruct. Delete the source instance.
+    ~AmbientEmitter();
+
+    /// Source instance.
+    SoLoud::AudioSourceInstance* instance_;
+    /// Decoded samples, non-interleaved.
+    PODVector<float> buffer_;
+    /// Number of channels in the decoded samples.
+    unsigned channels_;
+    /// Read position in the decoded samples.
+    unsigned position_;
+    /// Interpolation start sample.
+    float previous_;
+    /// Interpolation end sample.
+    float next_;
+    /// Interpolation position between the samples.
+    double fraction_;
+    /// Source samples per output sample.
+    double step_;
+    /// Playback position in seconds of the next source sample read. Written by the mixer thread.
+    double time_;
+    /// Length of a source sample in seconds.
+    double sampleTime_;
+    /// Target gain.
+    float gain_;
+    /// Gain reached by the mixer, ramped towards the target once per block.
+    float currentGain_;
+    /// Normalized world space direction from the listener.
+    Vector3 direction_;
+};
+
+/// Playing instance of the ambisonic bed. Encodes all emitters into first-order B-format, rotates it by the listener orientation and decodes it to the output channels once per block.
+class AmbisonicBedInstance : public SoLoud::AudioSourceInstance
+{
+public:
+    /// Construct.
+    AmbisonicBedInstance(AmbisonicBed* parent);
+    /// Destruct.
+    virtual ~AmbisonicBedInstance();
+
+    /// Mix the emitters into a non-interleaved buffer.
+    virtual void getAudio(float* aBuffer, unsigned int aSamples);
+    /// Return false, as the bed plays until stopped.
+    virtual bool hasEnded() { return false; }
+
+private:
+    /// Resample an emitter to mono at the output rate with its gain ramp.
+    void RenderEmitter(AmbientEmitter* emitter, unsigned samples);
+
+    /// Parent source.
+    AmbisonicBed* parent_;
+    /// Emitter samples being encoded.
+    PODVector<float> mono_;
+    /// Omnidirectional component.
+    PODVector<float> w_;
+    /// World X component.
+    PODVector<float> x_;
+    /// World Y component.
+    PODVector<float> y_;
+    /// World Z component.
+    PODVector<float> z_;
+};
+
+/// Audio source for the shared ambisonic bed voice. Distant and diffuse ambient loops are encoded into it instead of playing spatialized voices of their own, so their spatialization cost does not grow with emitter count. Emitters are changed by the main thread with the audio mutex held.
+class URHO3D_API AmbisonicBed : public SoLoud::AudioSource
+{
+    friend class AmbisonicBedInstance;
+
+public:
+    /// Construct.
+    AmbisonicBed();
+    /// Destruct. Stop the voice and delete the emitters.
+    virtual ~AmbisonicBed();
+
+    /// Create the playing instance.
+    virtual SoLoud::AudioSourceInstance* createInstance();
+    /// Create an emitter playing an audio source from a position in seconds. Seeks the source without touching the mixer, so call without the audio mutex and add the emitter with AddEmitter.
+    AmbientEmitter* CreateEmitter(SoLoud::AudioSource* source, bool looped, double position, float gain, const Vector3& direction) const;
+    /// Add an emitter created by CreateEmitter, taking ownership.
+    void AddEmitter(AmbientEmitter* emitter);
+    /// Update an emitter's gain and normalized direction from the listener.
+    void SetEmitter(AmbientEmitter* emitter, float gain, const Vector3& direction);
+    /// Remove and delete an emitter.
+    void RemoveEmitter(AmbientEmitter* emitter);
+    /// Set listener orientation for rotating the bed.
+    void SetListenerRotation(const Quaternion& rotation) { listenerRotation_ = rotation; }
+
+    /// Return number of emitters.
+    unsigned GetNumEmitters() const { return emitters_.Size(); }
+
+private:
+    /// Emitters.
+    PODVector<AmbientEmitter*> emitters_;
+    /// Listener orientation.
+    Quaternion listenerRotation_;
+};
+
+}
@@ -23,17 +23,35 @@
 #include "../Precompiled.h"
 
 #include "../Audio/Audio.h"
+#include "../Audio/AudioEvents.h"
+#include "../Audio/AudioKernels.h"
+#include "../Audio/AudioTrace.h"
+#include "../Audio/MusicPlayer.h"
+#include "../Audio/SampleBuffer.h"
 #include "../Audio/Sound.h"
+#include "../Audio/SoundEvent.h"
 #include "../Audio/SoundListener.h"
+#include "../Audio/SoundPortal.h"
+#include "../Audio/SoundPropagation.h"
+#include "../Audio/SoundRoom.h"
 #include "../Audio/SoundSource.h"
 #include "../Audio/SoundSource3D.h"
+#include "../Audio/SpeechCache.h"
+#include "../Container/Sort.h"
 #include "../Core/Context.h"
 #include "../Core/CoreEvents.h"
 #include "../Core/ProcessUtils.h"
 #include "../Core/Profiler.h"
+#include "../Core/Thread.h"
+#include "../Core/Timer.h"
 #include "../IO/Log.h"
+#include "../IO/PackageFile.h"
+#include "../Resource/ResourceCache.h"
+#include "../Resource/ResourceEvents.h"
+#include "../Resource/XMLElement.h"
 #include "../Scene/Node.h"
 #include "soloud.h"
+#include "soloud_thread.h"
 
 #include <SDL/SDL.h>
 
@@ -52,52 +70,291 @@ static const int MIN_BUFFERLENGTH = 20;
 static const int MIN_MIXRATE = 11025;
 static const int MAX_MIXRATE = 48000;
 static const StringHash SOUND_MASTER_HASH("Master");
+static const float DEFAULT_UPDATE_NEAR_DISTANCE = 25.0f;
+static const float DEFAULT_UPDATE_FAR_DISTANCE = 75.0f;
+static const unsigned DEFAULT_MID_UPDATE_INTERVAL = 4;
+static const unsigned DEFAULT_FAR_UPDATE_BUDGET = 8;
+static const float DEFAULT_CLUSTER_RADIUS = 8.0f;
+static const float DEFAULT_CLUSTER_SPLIT_DISTANCE = 40.0f;
+static const unsigned CLUSTER_UPDATE_INTERVAL = 8;
+static const float EVICTION_CHECK_INTERVAL = 2.0f;
+static const float DEFAULT_AMBIENT_DISTANCE = 0.0f;
+static const float DEFAULT_SPEED_OF_SOUND = 343.0f;
+static const float DEFAULT_DOPPLER_FACTOR = 1.0f;
+/// Smallest change of 3D voice volume or panning that is submitted to the voice.
+static const float VOICE3D_TOLERANCE = 0.0005f;
+/// Smallest change of Doppler speed multiplier that is submitted to the voice.
+static const float DOPPLER_TOLERANCE = 0.001f;
+/// Mix headroom above full scale. SoLoud mixes at 1 / headroom volume so that loud mixes reach the soft clipper instead of its hard clip.
+static const float MIX_HEADROOM = 4.0f;
+static const unsigned DEFAULT_MAX_VOICES = 64;
+static const unsigned MIN_ACTIVE_VOICES = 4;
+static const float DEFAULT_GOVERNOR_HIGH_LOAD = 0.7f;
+static const float DEFAULT_GOVERNOR_LOW_LOAD = 0.35f;
+static const float GOVERNOR_LOAD_SMOOTHING = 0.1f;
+/// Time in seconds the load must stay over the high threshold before stepping down. Short, as crackles are worse than lost voices.
+static const float GOVERNOR_STEP_DOWN_TIME = 0.1f;
+/// Time in seconds the load must stay under the low threshold before stepping up.
+static const float GOVERNOR_STEP_UP_TIME = 2.0f;
+static const float QUALITY_TIER_VOICE_SCALE[] =
+{
+    1.0f,
+    0.75f,
+    0.5f,
+    0.25f
+};
+static const char* qualityTierNames[] =
+{
+    "full",
+    "reduced",
+    "low",
+    "minimal"
+};
 
 static void SDLAudioCallback(void* userdata, Uint8* stream, int len);
 
+/// Background thread opening the audio device, which may take hundreds of milliseconds while the backend probes devices.
+class AudioDeviceThread : public Thread
+{
+public:
+    /// Construct with the desired output format.
+    AudioDeviceThread(const SDL_AudioSpec& desired) :
+        desired_(desired),
+        deviceID_(0),
+        done_(false)
+    {
+    }
+
+    /// Open the device. The device starts paused, so the callback does not run until output begins on the main thread.
+    virtual void ThreadFunction()
+    {
+        deviceID_ = SDL_OpenAudioDevice(0, SDL_FALSE, &desired_, &obtained_, SDL_AUDIO_ALLOW_ANY_CHANGE);
+        done_ = true;
+    }
+
+    /// Desired output format.
+    SDL_AudioSpec desired_;
+    /// Obtained output format.
+    SDL_AudioSpec obtained_;
+    /// Opened device, zero on failure.
+    SDL_AudioDeviceID deviceID_;
+    /// Completion flag.
+    volatile bool done_;
+};
+
+/// Sound to prewarm with its position in the resource packages.
+struct PrewarmSound
+{
+    /// Package index, or the number of packages for loose files.
+    unsigned package_;
+    /// Offset within the package.
+    unsigned offset_;
+    /// Resource name.
+    String name_;
+};
+
+static bool ComparePrewarmSounds(const PrewarmSound& lhs, const PrewarmSound& rhs)
+{
+    if (lhs.package_ != rhs.package_)
+        return lhs.package_ < rhs.package_;
+    if (lhs.offset_ != rhs.offset_)
+        return lhs.offset_ < rhs.offset_;
+    return lhs.name_ < rhs.name_;
+}
+
+static void CollectSoundRefs(const XMLElement& element, Vector<String>& names)
+{
+    for (XMLElement childElem = element.GetChild(); childElem; childElem = childElem.GetNext())
+    {
+        String name = childElem.GetName();
+        if (name == "attribute")
+        {
+            // Resource references are stored as "type;name"
+            String value = childElem.GetAttribute("value");
+            if (value.StartsWith("Sound;"))
+                names.Push(value.Substring(6).Trimmed());
+        }
+        else if (name == "node" || name == "component")
+            CollectSoundRefs(childElem, names);
+    }
+}
+
+static bool CompareClusterCandidates(const EmitterClusterCandidate& lhs, const EmitterClusterCandidate& rhs)
+{
+    if (lhs.sound_ != rhs.sound_)
+        return lhs.sound_ < rhs.sound_;
+    if (lhs.cellX_ != rhs.cellX_)
+        return lhs.cellX_ < rhs.cellX_;
+    if (lhs.cellY_ != rhs.cellY_)
+        return lhs.cellY_ < rhs.cellY_;
+    return lhs.cellZ_ < rhs.cellZ_;
+}
+
+static bool IsSameCluster(const EmitterClusterCandidate& lhs, const EmitterClusterCandidate& rhs)
+{
+    return lhs.sound_ == rhs.sound_ && lhs.cellX_ == rhs.cellX_ && lhs.cellY_ == rhs.cellY_ && lhs.cellZ_ == rhs.cellZ_;
+}
+
 Audio::Audio(Context* context) :
     Object(context),
     deviceID_(0),
+    deviceThread_(0),
+    asyncInterpolation_(true),
+    offline_(false),
     sampleSize_(0),
-    playing_(false)
+    playing_(false),
+    outputGain_(1.0f),
+    headless_(false),
+    headlessTime_(0.0),
+    mixedSamples_(0),
+    maxVoices_(DEFAULT_MAX_VOICES),
+    governorEnabled_(true),
+    governorHighLoad_(DEFAULT_GOVERNOR_HIGH_LOAD),
+    governorLowLoad_(DEFAULT_GOVERNOR_LOW_LOAD),
+    mixLoad_(0.0f),
+    qualityTier_(AUDIO_QUALITY_FULL),
+    reportedTier_(AUDIO_QUALITY_FULL),
+    overloadSamples_(0),
+    headroomSamples_(0),
+    updateNearDistance_(DEFAULT_UPDATE_NEAR_DISTANCE),
+    updateFarDistance_(DEFAULT_UPDATE_FAR_DISTANCE),
+    midUpdateInterval_(DEFAULT_MID_UPDATE_INTERVAL),
+    farUpdateBudget_(DEFAULT_FAR_UPDATE_BUDGET),
+    updateFrameNumber_(0),
+    nextUpdateKey_(0),
+    farUpdateSlots_(1),
+    clusterRadius_(DEFAULT_CLUSTER_RADIUS),
+    clusterSplitDistance_(DEFAULT_CLUSTER_SPLIT_DISTANCE),
+    ambientDistance_(DEFAULT_AMBIENT_DISTANCE),
+    soundIdleTime_(0.0f),
+    evictionTimer_(0.0f),
+    listenerVelocity_(Vector3::ZERO),
+    speedOfSound_(DEFAULT_SPEED_OF_SOUND),
+    dopplerFactor_(DEFAULT_DOPPLER_FACTOR),
+    mixerRealtime_(false),
+    mixerAffinity_(-1),
+    lockMemory_(false),
+    mixerSettingsDirty_(false),
+    mixerPriorityStatus_(REALTIME_DISABLED),
+    mixerAffinityStatus_(REALTIME_DISABLED),
+    memoryLockStatus_(REALTIME_DISABLED),
+    lockedClipSize_(0),
+    lockedScratch_(0),
+    lockedScratchSize_(0),
+    ListenerPos(M_INFINITY, M_INFINITY, M_INFINITY)
 {
 	
     // Set the master to the default value
     masterGain_[SOUND_MASTER_HASH] = 1.0f;
 
+    // Pick the output stage kernels for this CPU
+    SetAudioKernelLevel(GetMaxAudioKernelLevel());
+
     // Register Audio library object factories
    RegisterAudioLibrary(context_);
 
+    // Create the speech cache as a subsystem alongside the audio output
+    context_->RegisterSubsystem(new SpeechCache(context_));
+
    SubscribeToEvent(E_RENDERUPDATE, URHO3D_HANDLER(Audio, HandleRenderUpdate));
+   SubscribeToEvent(E_RESOURCEBACKGROUNDLOADED, URHO3D_HANDLER(Audio, HandleResourceBackgroundLoaded));
 	
 }
 
 Audio::~Audio()
 {
-	//soloud_.deinit();
-
 	Release();
+
+    // Remove the speech cache while the work queue still exists to wait for its renders
+    context_->RemoveSubsystem<SpeechCache>();
 }
 
 bool Audio::SetMode(int bufferLengthMSec, int mixRate, bool stereo, bool interpolation)
 {
+    Release();
 
-	// initialize SoLoud.
-	int rslt = 314159;
+    if (headless_)
+    {
+        URHO3D_LOGERROR("Can not set audio mode in headless mode");
+        return false;
+    }
 
-	soloud_.setMaxActiveVoiceCount(64);
-	rslt = soloud_.init();
-	
-	URHO3D_LOGINFO("SoLoud Init: " + String(rslt));
+    SDL_AudioSpec desired;
+    SDL_AudioSpec obtained;
+    GetDesiredSpec(desired, bufferLengthMSec, mixRate, stereo);
+
+    deviceID_ = SDL_OpenAudioDevice(0, SDL_FALSE, &desired, &obtained, SDL_AUDIO_ALLOW_ANY_CHANGE);
+    return InitializeOutput(obtained, interpolation);
+}
+
+bool Audio::SetModeAsync(int bufferLengthMSec, int mixRate, bool stereo, bool interpolation)
+{
+    Release();
+
+    if (headless_)
+    {
+        URHO3D_LOGERROR("Can not set audio mode in headless mode");
+        return false;
+    }
+
+    SDL_AudioSpec desired;
+    GetDesiredSpec(desired, bufferLengthMSec, mixRate, stereo);
+
+    deviceThread_ = new AudioDeviceThread(desired);
+    asyncInterpolation_ = interpolation;
+    if (!deviceThread_->Run())
+    {
+        delete deviceThread_;
+        deviceThread_ = 0;
+        URHO3D_LOGERROR("Could not start audio device thread");
+        return false;
+    }
+
+    return true;
+}
+
+bool Audio::SetModeOffline(int bufferLengthMSec, int mixRate, bool stereo, bool interpolation)
+{
+    Release();
 
-    return Play();
+    if (headless_)
+    {
+        URHO3D_LOGERROR("Can not set audio mode in headless mode");
+        return false;
+    }
+
+    // The desired format is used as is, since no device negotiates it
+    SDL_AudioSpec desired;
+    GetDesiredSpec(desired, bufferLengthMSec, mixRate, stereo);
+
+    offline_ = true;
+    return InitializeOutput(desired, interpolation);
 }
 
 void Audio::Update(float timeStep)
 {
-    if (!playing_)
+    // Finish an asynchronous mode change once the device thread has opened the device
+    if (deviceThread_ && deviceThread_->done_)
+        FinishAsyncMode();
+
+    // Free locked sample buffers that the mixer released since the last frame
+    SampleBuffer::FreePendingBuffers();
+
+    // Headless mode has no output but still advances playback of sound sources
+    if (headless_)
+        headlessTime_ += timeStep;
+    else if (!playing_)
         return;
 
+    // The mixer thread only steps the tier; its voice limit is applied here, outside the mix
+    AudioQualityTier tier = qualityTier_;
+    if (tier != reportedTier_)
+    {
+        URHO3D_LOGDEBUG("Audio quality tier " + String(qualityTierNames[tier]) + ", mix load " + String(mixLoad_));
+        reportedTier_ = tier;
+        ApplyVoiceLimit();
+    }
+
     UpdateInternal(timeStep);
 }
 
@@ -107,6 +364,15 @@ bool Audio::Play()
 	if (playing_)
         return true;
 
+    if (!IsInitialized())
+    {
+        URHO3D_LOGERROR("No audio mode set, can not start playback");
+        return false;
+    }
+
+    if (deviceID_)
+        SDL_PauseAudioDevice(deviceID_, 0);
+
     // Update sound sources before resuming playback to make sure 3D positions are up to date
     UpdateInternal(0.0f);
 
@@ -122,6 +388,8 @@ void Audio::Stop()
 void Audio::SetMasterGain(const String& type, float gain)
 {
     masterGain_[type] = Clamp(gain, 0.0f, 1.0f);
+    if (StringHash(type) == SOUND_MASTER_HASH)
+        outputGain_ = masterGain_[SOUND_MASTER_HASH].GetFloat();
 
     for (PODVector<SoundSource*>::Iterator i = soundSources_.Begin(); i != soundSources_.End(); ++i)
         (*i)->UpdateMasterGain();
@@ -162,6 +430,211 @@ void Audio::StopSound(Sound* soundClip)
     }
 }
 
+void Audio::SetUpdateTiers(float nearDistance, float farDistance, unsigned midInterval, unsigned farBudget)
+{
+    updateNearDistance_ = Max(nearDistance, 0.0f);
+    updateFarDistance_ = Max(farDistance, updateNearDistance_);
+    midUpdateInterval_ = Max(midInterval, 1U);
+    farUpdateBudget_ = Max(farBudget, 1U);
+    farUpdateSlots_ = 1;
+}
+
+bool Audio::IsSoundPrewarming(const String& name) const
+{
+    if (prewarmingSounds_.Empty())
+        return false;
+
+    // The set holds sanitized names, as the cache reports them when the loads finish
+    return prewarmingSounds_.Contains(GetSubsystem<ResourceCache>()->SanitateResourceName(name));
+}
+
+unsigned Audio::PrewarmSounds(const XMLElement& element)
+{
+    Vector<String> names;
+    CollectSoundRefs(element, names);
+    return PrewarmSounds(names);
+}
+
+unsigned Audio::PrewarmSounds(const Vector<String>& names)
+{
+    URHO3D_PROFILE(PrewarmSounds);
+
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    if (!cache)
+        return 0;
+
+    const Vector<SharedPtr<PackageFile> >& packages = cache->GetPackageFiles();
+    HashSet<String> uniqueNames;
+    Vector<PrewarmSound> sounds;
+
+    for (Vector<String>::ConstIterator i = names.Begin(); i != names.End(); ++i)
+    {
+        String name = cache->SanitateResourceName(*i);
+        if (name.Empty() || uniqueNames.Contains(name) || prewarmingSounds_.Contains(name) ||
+            cache->GetExistingResource<Sound>(name))
+            continue;
+        uniqueNames.Insert(name);
+
+        // Order by package and offset so that the loader reads each package front to back
+        PrewarmSound sound;
+        sound.package_ = packages.Size();
+        sound.offset_ = 0;
+        sound.name_ = name;
+        for (unsigned j = 0; j < packages.Size(); ++j)
+        {
+            const PackageEntry* entry = packages[j]->GetEntry(name);
+            if (entry)
+            {
+                sound.package_ = j;
+                sound.offset_ = entry->offset_;
+                break;
+            }
+        }
+        sounds.Push(sound);
+    }
+
+    Sort(sounds.Begin(), sounds.End(), ComparePrewarmSounds);
+
+    unsigned queued = 0;
+    for (Vector<PrewarmSound>::ConstIterator i = sounds.Begin(); i != sounds.End(); ++i)
+    {
+        if (cache->BackgroundLoadResource<Sound>(i->name_))
+        {
+            prewarmingSounds_.Insert(i->name_);
+            ++queued;
+        }
+    }
+
+    return queued;
+}
+
+void Audio::SetSoundIdleTime(float seconds)
+{
+    soundIdleTime_ = Max(seconds, 0.0f);
+}
+
+void Audio::SetHeadless(bool enable)
+{
+    if (enable == headless_)
+        return;
+
+    if (enable)
+        Release();
+
+    headless_ = enable;
+}
+
+void Audio::SetClusterParameters(float radius, float splitDistance)
+{
+    clusterRadius_ = Max(radius, 0.0f);
+    clusterSplitDistance_ = Max(splitDistance, 0.0f);
+}
+
+void Audio::SetAmbientDistance(float distance)
+{
+    ambientDistance_ = Max(distance, 0.0f);
+}
+
+void Audio::SetMaxVoices(unsigned count)
+{
+    MutexLock lock(audioMutex_);
+
+    // SoLoud rejects a limit equal to its voice count
+    maxVoices_ = Clamp(count, MIN_ACTIVE_VOICES, (unsigned)VOICE_COUNT - 1);
+    if (IsInitialized())
+        ApplyVoiceLimit();
+}
+
+void Audio::SetGovernorEnabled(bool enable)
+{
+    MutexLock lock(audioMutex_);
+
+    governorEnabled_ = enable;
+    if (!enable && qualityTier_ != AUDIO_QUALITY_FULL)
+    {
+        qualityTier_ = AUDIO_QUALITY_FULL;
+        reportedTier_ = AUDIO_QUALITY_FULL;
+        if (IsInitialized())
+            ApplyVoiceLimit();
+    }
+}
+
+void Audio::SetGovernorThresholds(float highLoad, float lowLoad)
+{
+    MutexLock lock(audioMutex_);
+
+    governorHighLoad_ = Max(highLoad, M_EPSILON);
+    governorLowLoad_ = Clamp(lowLoad, 0.0f, governorHighLoad_);
+}
+
+void Audio::SetDopplerParameters(float speedOfSound, float factor)
+{
+    speedOfSound_ = Max(speedOfSound, M_EPSILON);
+    dopplerFactor_ = Max(factor, 0.0f);
+}
+
+void Audio::ResetListenerVelocity()
+{
+    listenerVelocity_ = Vector3::ZERO;
+    ListenerPos = Vector3(M_INFINITY, M_INFINITY, M_INFINITY);
+}
+
+void Audio::SetMixerPriority(bool realtime)
+{
+    mixerRealtime_ = realtime;
+    if (realtime)
+        mixerPriorityStatus_ = REALTIME_PENDING;
+    mixerSettingsDirty_ = true;
+}
+
+void Audio::SetMixerAffinity(int cpu)
+{
+    mixerAffinity_ = Max(cpu, -1);
+    if (mixerAffinity_ >= 0)
+        mixerAffinityStatus_ = REALTIME_PENDING;
+    mixerSettingsDirty_ = true;
+}
+
+void Audio::SetLockMemory(bool enable)
+{
+    if (enable == lockMemory_)
+        return;
+
+    lockMemory_ = enable;
+    SampleBuffer::SetLockMemory(enable);
+
+    MutexLock lock(audioMutex_);
+    if (!IsInitialized())
+        memoryLockStatus_ = enable ? REALTIME_PENDING : REALTIME_DISABLED;
+    else if (enable)
+        LockOutputMemory();
+    else
+        UnlockOutputMemory();
+}
+
+double Audio::GetAudioClock()
+{
+    if (headless_)
+        return headlessTime_;
+    if (!mixRate_)
+        return 0.0;
+
+    MutexLock lock(audioMutex_);
+    return (double)mixedSamples_ / (double)mixRate_;
+}
+
+unsigned Audio::GetActiveVoiceLimit() const
+{
+    return Max((unsigned)(maxVoices_ * QUALITY_TIER_VOICE_SCALE[reportedTier_]), MIN_ACTIVE_VOICES);
+}
+
+RealtimeStatus Audio::GetMemoryLockStatus() const
+{
+    if (memoryLockStatus_ == REALTIME_ENABLED && SampleBuffer::GetNumLockFailures())
+        return REALTIME_PARTIAL;
+    return memoryLockStatus_;
+}
+
 float Audio::GetMasterGain(const String& type) const
 {
     // By definition previously unknown types return full volume
@@ -185,17 +658,200 @@ SoundListener* Audio::GetListener() const
 void Audio::AddSoundSource(SoundSource* channel)
 {
     MutexLock lock(audioMutex_);
+    channel->SetUpdateKey(nextUpdateKey_++);
     soundSources_.Push(channel);
 }
 
 void Audio::RemoveSoundSource(SoundSource* channel)
 {
+    // Search under the lock too, as sources may be added or removed from other threads
+    MutexLock lock(audioMutex_);
     PODVector<SoundSource*>::Iterator i = soundSources_.Find(channel);
     if (i != soundSources_.End())
-    {
-        MutexLock lock(audioMutex_);
         soundSources_.Erase(i);
+}
+
+unsigned Audio::AddVoice3D(SoundSource3D* source, unsigned handle)
+{
+    unsigned slot = voices3D_.handles_.Size();
+    voices3D_.Resize(slot + 1);
+
+    voices3D_.sources_[slot] = source;
+    voices3D_.handles_[slot] = handle;
+    voices3D_.positionX_[slot] = voices3D_.positionY_[slot] = voices3D_.positionZ_[slot] = 0.0f;
+    voices3D_.velocityX_[slot] = voices3D_.velocityY_[slot] = voices3D_.velocityZ_[slot] = 0.0f;
+    voices3D_.nearDistance_[slot] = 0.0f;
+    voices3D_.farDistance_[slot] = 0.0f;
+    voices3D_.rolloff_[slot] = 1.0f;
+    voices3D_.gain_[slot] = 0.0f;
+    voices3D_.pitch_[slot] = 1.0f;
+    // Force the first submission
+    voices3D_.voiceVolume_[slot] = -1.0f;
+    voices3D_.voicePan_[slot] = M_INFINITY;
+    voices3D_.voiceDoppler_[slot] = M_INFINITY;
+    voices3D_.voicePitch_[slot] = M_INFINITY;
+    return slot;
+}
+
+void Audio::RemoveVoice3D(unsigned slot)
+{
+    unsigned last = voices3D_.handles_.Size() - 1;
+    if (slot > last)
+        return;
+
+    if (slot != last)
+    {
+        voices3D_.Move(slot, last);
+        voices3D_.sources_[slot]->SetVoice3DSlot(slot);
     }
+    voices3D_.Resize(last);
+}
+
+void Audio::SetVoice3D(unsigned slot, const Vector3& position, float timeStep, float gain, float pitch, float nearDistance,
+    float farDistance, float rolloffFactor)
+{
+    if (timeStep > 0.0f)
+    {
+        float invTimeStep = 1.0f / timeStep;
+        voices3D_.velocityX_[slot] = (position.x_ - voices3D_.positionX_[slot]) * invTimeStep;
+        voices3D_.velocityY_[slot] = (position.y_ - voices3D_.positionY_[slot]) * invTimeStep;
+        voices3D_.velocityZ_[slot] = (position.z_ - voices3D_.positionZ_[slot]) * invTimeStep;
+
+        // A jump faster than sound is a teleport, not motion
+        Vector3 velocity(voices3D_.velocityX_[slot], voices3D_.velocityY_[slot], voices3D_.velocityZ_[slot]);
+        if (velocity.LengthSquared() > speedOfSound_ * speedOfSound_)
+            ResetVoice3DVelocity(slot);
+    }
+
+    voices3D_.positionX_[slot] = position.x_;
+    voices3D_.positionY_[slot] = position.y_;
+    voices3D_.positionZ_[slot] = position.z_;
+    voices3D_.nearDistance_[slot] = nearDistance;
+    voices3D_.farDistance_[slot] = farDistance;
+    voices3D_.rolloff_[slot] = rolloffFactor;
+    voices3D_.gain_[slot] = gain;
+    voices3D_.pitch_[slot] = pitch;
+}
+
+void Audio::ResetVoice3DVelocity(unsigned slot)
+{
+    voices3D_.velocityX_[slot] = voices3D_.velocityY_[slot] = voices3D_.velocityZ_[slot] = 0.0f;
+}
+
+void Audio::Update3DVoices(unsigned start, unsigned count)
+{
+    if (!count || start + count > voices3D_.handles_.Size())
+        return;
+
+    URHO3D_PROFILE(Update3DVoices);
+
+    Node* listenerNode = listener_ ? listener_->GetNode() : 0;
+    Voice3DListener listener;
+    listener.position_ = listenerNode ? listenerNode->GetWorldPosition() : Vector3::ZERO;
+    listener.right_ = listenerNode ? listenerNode->GetWorldRotation() * Vector3::RIGHT : Vector3::RIGHT;
+    listener.velocity_ = listenerVelocity_;
+    listener.speedOfSound_ = speedOfSound_;
+    listener.dopplerFactor_ = dopplerFactor_;
+
+    Compute3DVoices(voices3D_.GetArrays(start), listener, count);
+
+    // Submit under one lock so that the mixer applies the whole update to the same block
+    MutexLock lock(audioMutex_);
+
+    for (unsigned i = start; i < start + count; ++i)
+    {
+        unsigned handle = voices3D_.handles_[i];
+
+        float volume = voices3D_.gain_[i] * voices3D_.attenuation_[i];
+        if (Abs(volume - voices3D_.voiceVolume_[i]) > VOICE3D_TOLERANCE || (volume == 0.0f && voices3D_.voiceVolume_[i] != 0.0f))
+        {
+            soloud_.setVolume(handle, volume);
+            voices3D_.voiceVolume_[i] = volume;
+        }
+
+        float pan = voices3D_.pan_[i];
+        if (Abs(pan - voices3D_.voicePan_[i]) > VOICE3D_TOLERANCE)
+        {
+            soloud_.setPan(handle, pan);
+            voices3D_.voicePan_[i] = pan;
+        }
+
+        // Pitch reaches the voice only through here, multiplied by Doppler, so that neither overrides the other
+        float doppler = voices3D_.doppler_[i];
+        float pitch = voices3D_.pitch_[i];
+        if (Abs(doppler - voices3D_.voiceDoppler_[i]) > DOPPLER_TOLERANCE || pitch != voices3D_.voicePitch_[i])
+        {
+            soloud_.setRelativePlaySpeed(handle, pitch * doppler);
+            voices3D_.voiceDoppler_[i] = doppler;
+            voices3D_.voicePitch_[i] = pitch;
+        }
+    }
+}
+
+void Voice3DBlock::Resize(unsigned size)
+{
+    sources_.Resize(size);
+    handles_.Resize(size);
+    positionX_.Resize(size);
+    positionY_.Resize(size);
+    positionZ_.Resize(size);
+    velocityX_.Resize(size);
+    velocityY_.Resize(size);
+    velocityZ_.Resize(size);
+    nearDistance_.Resize(size);
+    farDistance_.Resize(size);
+    rolloff_.Resize(size);
+    gain_.Resize(size);
+    pitch_.Resize(size);
+    attenuation_.Resize(size);
+    pan_.Resize(size);
+    doppler_.Resize(size);
+    voiceVolume_.Resize(size);
+    voicePan_.Resize(size);
+    voiceDoppler_.Resize(size);
+    voicePitch_.Resize(size);
+}
+
+void Voice3DBlock::Move(unsigned dest, unsigned src)
+{
+    sources_[dest] = sources_[src];
+    handles_[dest] = handles_[src];
+    positionX_[dest] = positionX_[src];
+    positionY_[dest] = positionY_[src];
+    positionZ_[dest] = positionZ_[src];
+    velocityX_[dest] = velocityX_[src];
+    velocityY_[dest] = velocityY_[src];
+    velocityZ_[dest] = velocityZ_[src];
+    nearDistance_[dest] = nearDistance_[src];
+    farDistance_[dest] = farDistance_[src];
+    rolloff_[dest] = rolloff_[src];
+    gain_[dest] = gain_[src];
+    pitch_[dest] = pitch_[src];
+    attenuation_[dest] = attenuation_[src];
+    pan_[dest] = pan_[src];
+    doppler_[dest] = doppler_[src];
+    voiceVolume_[dest] = voiceVolume_[src];
+    voicePan_[dest] = voicePan_[src];
+    voiceDoppler_[dest] = voiceDoppler_[src];
+    voicePitch_[dest] = voicePitch_[src];
+}
+
+Voice3DArrays Voice3DBlock::GetArrays(unsigned start)
+{
+    Voice3DArrays arrays;
+    arrays.positionX_ = &positionX_[start];
+    arrays.positionY_ = &positionY_[start];
+    arrays.positionZ_ = &positionZ_[start];
+    arrays.velocityX_ = &velocityX_[start];
+    arrays.velocityY_ = &velocityY_[start];
+    arrays.velocityZ_ = &velocityZ_[start];
+    arrays.nearDistance_ = &nearDistance_[start];
+    arrays.farDistance_ = &farDistance_[start];
+    arrays.rolloff_ = &rolloff_[start];
+    arrays.attenuation_ = &attenuation_[start];
+    arrays.pan_ = &pan_[start];
+    arrays.doppler_ = &doppler_[start];
+    return arrays;
 }
 
 float Audio::GetSoundSourceMasterGain(StringHash typeHash) const
@@ -215,12 +871,71 @@ float Audio::GetSoundSourceMasterGain(StringHash typeHash) const
 
 void SDLAudioCallback(void* userdata, Uint8* stream, int len)
 {
-   
+    Audio* audio = static_cast<Audio*>(userdata);
+#if URHO3D_AUDIO_TRACE_LEVEL >= 1
+    AudioTrace::SetThreadName("Mixer");
+#endif
+    // The callback runs on the thread SDL owns, so scheduling changes are applied from here
+    if (audio->GetMixerSettingsDirty())
+        audio->ApplyMixerThreadSettings();
+    {
+        MutexLock Lock(audio->GetMutex());
+        audio->MixOutput(stream, len / audio->GetSampleSize() / Audio::SAMPLE_SIZE_MUL);
+    }
 }
 
 void Audio::MixOutput(void* dest, unsigned samples)
 {
+    if (!playing_ || !clipBuffer_)
+    {
+        memset(dest, 0, samples * sampleSize_ * SAMPLE_SIZE_MUL);
+        return;
+    }
+
+    URHO3D_AUDIO_TRACE_VERBOSE(TRACE_MIX_BEGIN, samples, 0.0f);
+
+    while (samples)
+    {
+        // If sample count exceeds the fragment (clip buffer) size, split the work
+        unsigned workSamples = Min(samples, fragmentSize_);
+        unsigned clipSamples = workSamples;
+        if (stereo_)
+            clipSamples <<= 1;
+
+        HiresTimer mixTimer;
+
+        // Mix voices to the clip buffer, then restore the headroom and apply master gain while soft clipping
+        float* clipPtr = clipBuffer_.Get();
+        soloud_.mix(clipPtr, workSamples);
+        mixedSamples_ += workSamples;
+        SoftClipSamples(clipPtr, outputGain_ * MIX_HEADROOM, clipSamples);
+
+#ifdef __EMSCRIPTEN__
+        memcpy(dest, clipPtr, clipSamples * sizeof(float));
+#else
+        ConvertSamples(static_cast<short*>(dest), clipPtr, clipSamples);
+#endif
+
+        UpdateGovernor(mixTimer.GetUSec(false), workSamples);
+
+        samples -= workSamples;
+        ((unsigned char*&)dest) += sampleSize_ * SAMPLE_SIZE_MUL * workSamples;
+    }
+
+    URHO3D_AUDIO_TRACE_VERBOSE(TRACE_MIX_END, 0, 0.0f);
+}
+
+void Audio::ApplyMixerThreadSettings()
+{
+    mixerSettingsDirty_ = false;
 
+    if (mixerRealtime_ || mixerPriorityStatus_ != REALTIME_DISABLED)
+        mixerPriorityStatus_ = SetAudioThreadPriority(mixerRealtime_);
+    if (mixerAffinity_ >= 0 || mixerAffinityStatus_ != REALTIME_DISABLED)
+    {
+        bool success = SetAudioThreadAffinity(mixerAffinity_);
+        mixerAffinityStatus_ = mixerAffinity_ < 0 ? REALTIME_DISABLED : success ? REALTIME_ENABLED : REALTIME_FAILED;
+    }
 }
 
 void Audio::HandleRenderUpdate(StringHash eventType, VariantMap& eventData)
@@ -230,22 +945,183 @@ void Audio::HandleRenderUpdate(StringHash eventType, VariantMap& eventData)
     Update(eventData[P_TIMESTEP].GetFloat());
 }
 
+void Audio::HandleResourceBackgroundLoaded(StringHash eventType, VariantMap& eventData)
+{
+    using namespace ResourceBackgroundLoaded;
+
+    if (!prewarmingSounds_.Empty())
+        prewarmingSounds_.Erase(eventData[P_RESOURCENAME].GetString());
+}
+
+void Audio::GetDesiredSpec(SDL_AudioSpec& desired, int bufferLengthMSec, int mixRate, bool stereo)
+{
+    bufferLengthMSec = Max(bufferLengthMSec, MIN_BUFFERLENGTH);
+    mixRate = Clamp(mixRate, MIN_MIXRATE, MAX_MIXRATE);
+
+    desired.freq = mixRate;
+#ifdef __EMSCRIPTEN__
+    desired.format = AUDIO_F32LSB;
+#else
+    desired.format = AUDIO_S16;
+#endif
+    desired.channels = stereo ? 2 : 1;
+    desired.callback = SDLAudioCallback;
+    desired.userdata = this;
+
+    // SDL uses power of two audio fragments. Determine the closest match
+    int bufferSamples = mixRate * bufferLengthMSec / 1000;
+    desired.samples = (Uint16)NextPowerOfTwo((unsigned)bufferSamples);
+    if (Abs((int)desired.samples / 2 - bufferSamples) < Abs((int)desired.samples - bufferSamples))
+        desired.samples /= 2;
+}
+
+bool Audio::InitializeOutput(const SDL_AudioSpec& obtained, bool interpolation)
+{
+    if (!IsInitialized())
+    {
+        URHO3D_LOGERROR("Could not initialize audio output");
+        SendReadyEvent(false);
+        return false;
+    }
+
+#ifdef __EMSCRIPTEN__
+    if (obtained.format != AUDIO_F32LSB && obtained.format != AUDIO_F32MSB && obtained.format != AUDIO_F32SYS)
+    {
+        URHO3D_LOGERROR("Could not initialize audio output, 32-bit float buffer format not supported");
+        SDL_CloseAudioDevice(deviceID_);
+        deviceID_ = 0;
+        SendReadyEvent(false);
+        return false;
+    }
+#else
+    if (obtained.format != AUDIO_S16SYS && obtained.format != AUDIO_S16LSB && obtained.format != AUDIO_S16MSB)
+    {
+        URHO3D_LOGERROR("Could not initialize audio output, 16-bit buffer format not supported");
+        SDL_CloseAudioDevice(deviceID_);
+        deviceID_ = 0;
+        SendReadyEvent(false);
+        return false;
+    }
+#endif
+
+    stereo_ = obtained.channels == 2;
+    sampleSize_ = stereo_ ? sizeof(int) : sizeof(short);
+    fragmentSize_ = Min((int)NextPowerOfTwo(obtained.freq >> 6), (int)obtained.samples);
+    mixRate_ = obtained.freq;
+    interpolation_ = interpolation;
+    clipBuffer_ = new float[stereo_ ? fragmentSize_ << 1 : fragmentSize_];
+    mixedSamples_ = 0;
+    mixLoad_ = 0.0f;
+    qualityTier_ = AUDIO_QUALITY_FULL;
+    reportedTier_ = AUDIO_QUALITY_FULL;
+    overloadSamples_ = 0;
+    headroomSamples_ = 0;
+
+    // SoLoud runs without a backend of its own; the SDL callback pulls mixed blocks from it
+    ApplyVoiceLimit();
+    soloud_.mAudioThreadMutex = SoLoud::Thread::createMutex();
+    soloud_.postinit((unsigned)mixRate_, fragmentSize_, 0, stereo_ ? 2 : 1);
+    soloud_.mBackendString = "Urho3D";
+    soloud_.setGlobalVolume(1.0f / MIX_HEADROOM);
+    if (lockMemory_)
+        LockOutputMemory();
+    // A new device may run its callback on a new thread
+    mixerSettingsDirty_ = true;
+
+    // The ambisonic bed decodes straight to the output layout at the mix rate
+    ambientBed_.mChannels = stereo_ ? 2 : 1;
+    ambientBed_.mBaseSamplerate = (float)mixRate_;
+    soloud_.setProtectVoice(soloud_.play(ambientBed_), true);
+
+    URHO3D_LOGINFO("Set audio mode " + String(mixRate_) + " Hz " + (stereo_ ? "stereo" : "mono") + ", " +
+                   GetAudioKernelName(GetAudioKernelLevel()) + " output stage");
+
+    if (!Play())
+    {
+        SendReadyEvent(false);
+        return false;
+    }
+
+    SendReadyEvent(true);
+    return true;
+}
+
+void Audio::FinishAsyncMode()
+{
+    deviceThread_->Stop();
+    deviceID_ = deviceThread_->deviceID_;
+    SDL_AudioSpec obtained = deviceThread_->obtained_;
+    delete deviceThread_;
+    deviceThread_ = 0;
+
+    InitializeOutput(obtained, asyncInterpolation_);
+}
+
+void Audio::SendReadyEvent(bool success)
+{
+    // Plays queued while the device was opening start now, or are dropped if it failed
+    for (unsigned i = soundSources_.Size() - 1; i < soundSources_.Size(); --i)
+        soundSources_[i]->FinishQueuedPlayback(success);
+
+    using namespace AudioReady;
+
+    VariantMap& eventData = GetEventDataMap();
+    eventData[P_SUCCESS] = success;
+    SendEvent(E_AUDIOREADY, eventData);
+}
+
 void Audio::Release()
 {
     Stop();
 
-    if (deviceID_)
+    // Wait for a device that is still being opened and close it
+    if (deviceThread_)
     {
-        SDL_CloseAudioDevice(deviceID_);
+        deviceThread_->Stop();
+        if (deviceThread_->deviceID_)
+            SDL_CloseAudioDevice(deviceThread_->deviceID_);
+        delete deviceThread_;
+        deviceThread_ = 0;
+
+        for (unsigned i = soundSources_.Size() - 1; i < soundSources_.Size(); --i)
+            soundSources_[i]->FinishQueuedPlayback(false);
+    }
+
+    if (IsInitialized())
+    {
+        if (deviceID_)
+            SDL_CloseAudioDevice(deviceID_);
         deviceID_ = 0;
+        offline_ = false;
+        UnlockOutputMemory();
         clipBuffer_.Reset();
+        ambientBed_.stop();
+        soloud_.deinit();
     }
+
+    SampleBuffer::FreePendingBuffers();
 }
 
 void Audio::UpdateInternal(float timeStep)
 {
     URHO3D_PROFILE(UpdateAudio);
 
+    // Amortize updates by listener distance. A zero timestep (e.g. resuming playback) refreshes all sources
+    Node* listenerNode = listener_ ? listener_->GetNode() : 0;
+    bool tiered = timeStep > 0.0f && listenerNode;
+    Vector3 listenerPosition = tiered ? listenerNode->GetWorldPosition() : Vector3::ZERO;
+    float nearDistanceSquared = updateNearDistance_ * updateNearDistance_;
+    float farDistanceSquared = updateFarDistance_ * updateFarDistance_;
+    unsigned farCount = 0;
+    ++updateFrameNumber_;
+
+    if (tiered && !headless_ && updateFrameNumber_ % CLUSTER_UPDATE_INTERVAL == 0)
+    {
+        // Bed emitters are taken out of clustering, so assign them first
+        UpdateAmbientBed(listenerPosition);
+        UpdateClusters(listenerPosition);
+    }
+
     // Update in reverse order, because sound sources might remove themselves
     for (unsigned i = soundSources_.Size() - 1; i < soundSources_.Size(); --i)
     {
@@ -258,31 +1134,395 @@ void Audio::UpdateInternal(float timeStep)
                 continue;
         }
 
-        source->Update(timeStep);
+        if (tiered)
+        {
+            float distanceSquared = source->GetListenerDistanceSquared(listenerPosition);
+            // Tier by distance only: a source fading in from silence must not be held back by its current gain
+            unsigned tier = distanceSquared <= nearDistanceSquared ? 0 : (distanceSquared <= farDistanceSquared ? 1 : 2);
+
+            // Stagger by the source's own key rather than its list index, which shifts when sources remove themselves
+            unsigned key = source->GetUpdateKey();
+            bool update = true;
+            if (tier == 1)
+                update = (updateFrameNumber_ + key) % midUpdateInterval_ == 0;
+            else if (tier == 2)
+            {
+                ++farCount;
+                update = key % farUpdateSlots_ == updateFrameNumber_ % farUpdateSlots_;
+            }
+
+            // Skipped sources keep their last position and gain; the engine ramps gain changes once they arrive
+            if (!update)
+            {
+                source->SkipUpdate(timeStep);
+                continue;
+            }
+        }
+
+        source->Update(timeStep + source->ConsumeSkippedTime());
+    }
+
+    // Size the far tier round-robin cycle so that about the budget of far sources updates each frame
+    farUpdateSlots_ = Max((farCount + farUpdateBudget_ - 1) / farUpdateBudget_, 1U);
+
+    if (soundIdleTime_ > 0.0f && !headless_)
+    {
+        evictionTimer_ += timeStep;
+        if (evictionTimer_ >= EVICTION_CHECK_INTERVAL)
+        {
+            evictionTimer_ = 0.0f;
+            EvictIdleSounds();
+        }
     }
 	
-	if (listener_!=NULL)
+	if (listener_!=NULL && !headless_)
 	{
 
 		Node* LNode = listener_->GetNode();
 		Vector3 p = LNode->GetWorldPosition();
 		Quaternion q = LNode->GetWorldRotation();
-		Matrix3 m = q.RotationMatrix();
-		Vector3 v = p - ListenerPos;
-		soloud_.set3dListenerParameters(p.x_,p.y_,p.z_,m.m00_,m.m01_,m.m02_,m.m10_,m.m11_,m.m12_,v.x_,v.y_,v.z_);
-		
-		soloud_.update3dAudio();
+
+		// Velocity per second, so that Doppler does not depend on frame rate. A zero timestep keeps the last velocity,
+		// and a jump faster than sound is a teleport
+		if (timeStep > 0.0f && ListenerPos.x_ != M_INFINITY)
+		{
+			listenerVelocity_ = (p - ListenerPos) / timeStep;
+			if (listenerVelocity_.LengthSquared() > speedOfSound_ * speedOfSound_)
+				listenerVelocity_ = Vector3::ZERO;
+		}
+
+		{
+			MutexLock lock(audioMutex_);
+			ambientBed_.SetListenerRotation(q);
+		}
 		
 		ListenerPos = p;
 	}
+
+	if (!headless_)
+		Update3DVoices(0, voices3D_.handles_.Size());
+}
+
+void Audio::UpdateClusters(const Vector3& listenerPosition)
+{
+    URHO3D_PROFILE(UpdateAudioClusters);
+
+    float splitDistanceSquared = clusterSplitDistance_ * clusterSplitDistance_;
+    clusterCandidates_.Clear();
+
+    for (PODVector<SoundSource*>::Iterator i = soundSources_.Begin(); i != soundSources_.End(); ++i)
+    {
+        SoundSource3D* source = dynamic_cast<SoundSource3D*>(*i);
+        if (!source)
+            continue;
+
+        if (source->GetAmbientEmitter())
+            continue;
+
+        Node* node = source->GetNode();
+        Sound* sound = source->GetSound();
+        if (clusterRadius_ > 0.0f && node && sound && sound->IsLooped() && source->IsPlaying())
+        {
+            Vector3 position = node->GetWorldPosition();
+            if ((position - listenerPosition).LengthSquared() > splitDistanceSquared)
+            {
+                EmitterClusterCandidate candidate;
+                candidate.source_ = source;
+                candidate.sound_ = sound;
+                candidate.cellX_ = FloorToInt(position.x_ / clusterRadius_);
+                candidate.cellY_ = FloorToInt(position.y_ / clusterRadius_);
+                candidate.cellZ_ = FloorToInt(position.z_ / clusterRadius_);
+                clusterCandidates_.Push(candidate);
+                continue;
+            }
+        }
+
+        // Sources that stopped or that the listener approached play their own voice again
+        source->ClearCluster();
+    }
+
+    Sort(clusterCandidates_.Begin(), clusterCandidates_.End(), CompareClusterCandidates);
+
+    for (unsigned start = 0; start < clusterCandidates_.Size();)
+    {
+        unsigned end = start + 1;
+        while (end < clusterCandidates_.Size() && IsSameCluster(clusterCandidates_[start], clusterCandidates_[end]))
+            ++end;
+
+        if (end - start < 2)
+        {
+            clusterCandidates_[start].source_->ClearCluster();
+            start = end;
+            continue;
+        }
+
+        // Gain-weighted centroid. Copies of a loop are uncorrelated, so their gains add by power
+        SoundSource3D* leader = 0;
+        Vector3 positionSum = Vector3::ZERO;
+        Vector3 weightedSum = Vector3::ZERO;
+        float weight = 0.0f;
+        float power = 0.0f;
+        for (unsigned j = start; j < end; ++j)
+        {
+            SoundSource3D* source = clusterCandidates_[j].source_;
+            Vector3 position = source->GetNode()->GetWorldPosition();
+            float gain = source->GetVoiceGain();
+            positionSum += position;
+            weightedSum += position * gain;
+            weight += gain;
+            power += gain * gain;
+            // Keep the current leader to avoid pausing and resuming voices
+            if (source->IsClusterLeader())
+                leader = source;
+        }
+
+        Vector3 centroid = weight > 0.0f ? weightedSum / weight : positionSum / (float)(end - start);
+        if (!leader)
+            leader = clusterCandidates_[start].source_;
+
+        for (unsigned j = start; j < end; ++j)
+        {
+            SoundSource3D* source = clusterCandidates_[j].source_;
+            if (source == leader)
+                source->SetClusterLeader(centroid, sqrtf(power));
+            else
+                source->SetClusterMember();
+        }
+
+        start = end;
+    }
+}
+
+void Audio::UpdateAmbientBed(const Vector3& listenerPosition)
+{
+    URHO3D_PROFILE(UpdateAmbientBed);
+
+    float ambientDistanceSquared = ambientDistance_ * ambientDistance_;
+    ambientChanges_.Clear();
+
+    // Decide the changes and create new emitters first: seeking and decoding them must not hold up the mixer
+    for (PODVector<SoundSource*>::Iterator i = soundSources_.Begin(); i != soundSources_.End(); ++i)
+    {
+        SoundSource3D* source = dynamic_cast<SoundSource3D*>(*i);
+        if (!source)
+            continue;
+
+        Node* node = source->GetNode();
+        Sound* sound = source->GetSound();
+        AmbientEmitter* emitter = source->GetAmbientEmitter();
+        Vector3 offset = node ? node->GetWorldPosition() - listenerPosition : Vector3::ZERO;
+        float distanceSquared = offset.LengthSquared();
+
+        if (node && sound && sound->IsLooped() && source->IsPlaying() && (source->IsAmbient() ||
+            (ambientDistance_ > 0.0f && distanceSquared > ambientDistanceSquared)))
+        {
+            float distance = sqrtf(distanceSquared);
+            float gain = source->GetVoiceGain() * customAttenuator_.attenuate(distance, source->GetNearDistance(),
+                source->GetFarDistance(), source->RollAngleoffFactor());
+            Vector3 direction = distance > M_EPSILON ? offset / distance : Vector3::FORWARD;
+
+            AmbientBedChange change;
+            change.source_ = source;
+            change.emitter_ = emitter;
+            change.gain_ = gain;
+            change.direction_ = direction;
+            change.position_ = 0.0;
+            change.add_ = false;
+            change.remove_ = false;
+
+            if (!emitter)
+            {
+                if (!sound->PrepareData())
+                    continue;
+
+                // Continue from the voice's position so that the loop does not restart
+                double position = soloud_.getStreamTime(source->GetVoiceHandle());
+                if (sound->GetLength() > 0.0f)
+                    position = fmod(position, (double)sound->GetLength());
+                change.emitter_ = ambientBed_.CreateEmitter(sound->GetAudioSource(), true, position, gain, direction);
+                change.add_ = true;
+            }
+
+            ambientChanges_.Push(change);
+        }
+        else if (emitter)
+        {
+            AmbientBedChange change;
+            change.source_ = source;
+            change.emitter_ = emitter;
+            change.gain_ = 0.0f;
+            change.direction_ = Vector3::FORWARD;
+            change.position_ = 0.0;
+            change.add_ = false;
+            change.remove_ = true;
+            ambientChanges_.Push(change);
+        }
+    }
+
+    if (ambientChanges_.Empty())
+        return;
+
+    {
+        MutexLock lock(audioMutex_);
+
+        for (PODVector<AmbientBedChange>::Iterator i = ambientChanges_.Begin(); i != ambientChanges_.End(); ++i)
+        {
+            if (i->remove_)
+            {
+                i->position_ = i->emitter_->time_;
+                ambientBed_.RemoveEmitter(i->emitter_);
+            }
+            else if (i->add_)
+            {
+                // Pause the voice in the same block in which the emitter starts
+                ambientBed_.AddEmitter(i->emitter_);
+                i->source_->SetAmbientEmitter(i->emitter_);
+            }
+            else
+                ambientBed_.SetEmitter(i->emitter_, i->gain_, i->direction_);
+        }
+    }
+
+    // A voice leaving the bed was paused while the emitter played on; move it to where the emitter left off before resuming
+    for (PODVector<AmbientBedChange>::Iterator i = ambientChanges_.Begin(); i != ambientChanges_.End(); ++i)
+    {
+        if (!i->remove_)
+            continue;
+
+        Sound* sound = i->source_->GetSound();
+        double position = i->position_;
+        if (sound && sound->GetLength() > 0.0f)
+            position = fmod(position, (double)sound->GetLength());
+        soloud_.seek(i->source_->GetVoiceHandle(), position);
+        i->source_->SetAmbientEmitter(0);
+    }
+}
+
+void Audio::EvictIdleSounds()
+{
+    URHO3D_PROFILE(EvictIdleSounds);
+
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    if (!cache)
+        return;
+
+    // Sounds with playing voices keep their data
+    HashSet<Sound*> playingSounds;
+    for (PODVector<SoundSource*>::ConstIterator i = soundSources_.Begin(); i != soundSources_.End(); ++i)
+    {
+        Sound* sound = (*i)->GetSound();
+        if (sound && (*i)->IsPlaying())
+            playingSounds.Insert(sound);
+    }
+
+    PODVector<Resource*> sounds;
+    cache->GetResources(sounds, Sound::GetTypeStatic());
+    unsigned idleMSec = (unsigned)(soundIdleTime_ * 1000.0f);
+    for (PODVector<Resource*>::ConstIterator i = sounds.Begin(); i != sounds.End(); ++i)
+    {
+        Sound* sound = static_cast<Sound*>(*i);
+        if (!playingSounds.Contains(sound))
+            sound->EvictData(idleMSec);
+    }
+}
+
+void Audio::UpdateGovernor(long long mixTime, unsigned samples)
+{
+    // Mix time as a fraction of the time the block lasts at the output
+    float load = (float)((double)mixTime * mixRate_ / (1000000.0 * samples));
+    mixLoad_ += (load - mixLoad_) * GOVERNOR_LOAD_SMOOTHING;
+
+    if (!governorEnabled_)
+        return;
+
+    // Count time spent continuously past a threshold; the gap between the thresholds and the hold times give hysteresis
+    if (mixLoad_ > governorHighLoad_)
+    {
+        headroomSamples_ = 0;
+        overloadSamples_ += samples;
+        if (qualityTier_ < AUDIO_QUALITY_MINIMAL && overloadSamples_ >= (unsigned)(GOVERNOR_STEP_DOWN_TIME * mixRate_))
+        {
+            qualityTier_ = (AudioQualityTier)(qualityTier_ + 1);
+            overloadSamples_ = 0;
+            URHO3D_AUDIO_TRACE(TRACE_QUALITY_TIER, qualityTier_, mixLoad_);
+        }
+    }
+    else if (mixLoad_ < governorLowLoad_)
+    {
+        overloadSamples_ = 0;
+        headroomSamples_ += samples;
+        if (qualityTier_ > AUDIO_QUALITY_FULL && headroomSamples_ >= (unsigned)(GOVERNOR_STEP_UP_TIME * mixRate_))
+        {
+            qualityTier_ = (AudioQualityTier)(qualityTier_ - 1);
+            headroomSamples_ = 0;
+            URHO3D_AUDIO_TRACE(TRACE_QUALITY_TIER, qualityTier_, mixLoad_);
+        }
+    }
+    else
+    {
+        overloadSamples_ = 0;
+        headroomSamples_ = 0;
+    }
+}
+
+void Audio::ApplyVoiceLimit()
+{
+    // SoLoud keeps voices over the limit running as virtual voices, dropping the quietest from the mix
+    soloud_.setMaxActiveVoiceCount(GetActiveVoiceLimit());
+}
+
+void Audio::LockOutputMemory()
+{
+    UnlockOutputMemory();
+
+    // Sample data is locked as it is allocated; the buffers the mixer writes every block are locked here
+    unsigned clipSize = (stereo_ ? fragmentSize_ << 1 : fragmentSize_) * sizeof(float);
+    bool clipLocked = LockAudioMemory(clipBuffer_.Get(), clipSize);
+    if (clipLocked)
+        lockedClipSize_ = clipSize;
+
+    unsigned scratchSize = soloud_.mScratch.mFloats * sizeof(float);
+    bool scratchLocked = LockAudioMemory(soloud_.mScratch.mData, scratchSize);
+    if (scratchLocked)
+    {
+        lockedScratch_ = soloud_.mScratch.mData;
+        lockedScratchSize_ = scratchSize;
+    }
+
+    memoryLockStatus_ = clipLocked && scratchLocked ? REALTIME_ENABLED : clipLocked || scratchLocked ? REALTIME_PARTIAL :
+        REALTIME_FAILED;
+    if (memoryLockStatus_ != REALTIME_ENABLED)
+        URHO3D_LOGWARNING("Could not lock all audio output buffers into memory");
+}
+
+void Audio::UnlockOutputMemory()
+{
+    if (lockedClipSize_)
+    {
+        UnlockAudioMemory(clipBuffer_.Get(), lockedClipSize_);
+        lockedClipSize_ = 0;
+    }
+    if (lockedScratch_)
+    {
+        UnlockAudioMemory(lockedScratch_, lockedScratchSize_);
+        lockedScratch_ = 0;
+        lockedScratchSize_ = 0;
+    }
+
+    memoryLockStatus_ = lockMemory_ ? REALTIME_PENDING : REALTIME_DISABLED;
 }
 
 void RegisterAudioLibrary(Context* context)
 {
     Sound::RegisterObject(context);
+    SoundEvent::RegisterObject(context);
     SoundSource::RegisterObject(context);
     SoundSource3D::RegisterObject(context);
     SoundListener::RegisterObject(context);
+    MusicPlayer::RegisterObject(context);
+    SoundRoom::RegisterObject(context);
+    SoundPortal::RegisterObject(context);
+    SoundPropagation::RegisterObject(context);
 }
 
 SoLoud::Soloud* Audio::GetSoLoud()
@@ -22,20 +22,124 @@
 
 #pragma once
 
+#include "../Audio/AmbisonicBed.h"
 #include "../Audio/AudioDefs.h"
+#include "../Audio/AudioKernels.h"
+#include "../Audio/AudioRealtime.h"
 #include "../Container/ArrayPtr.h"
 #include "../Container/HashSet.h"
 #include "../Core/Mutex.h"
 #include "../Core/Object.h"
 #include "soloud.h"
 
+struct SDL_AudioSpec;
+
 namespace Urho3D
 {
 
+class AudioDeviceThread;
 class AudioImpl;
 class Sound;
 class SoundListener;
 class SoundSource;
+class SoundSource3D;
+class XMLElement;
+
+/// Mixer quality tier chosen by the CPU budget governor. Lower tiers mix fewer voices.
+enum AudioQualityTier
+{
+    AUDIO_QUALITY_FULL = 0,
+    AUDIO_QUALITY_REDUCED,
+    AUDIO_QUALITY_LOW,
+    AUDIO_QUALITY_MINIMAL,
+    MAX_AUDIO_QUALITY_TIERS
+};
+
+/// Emitter clustering candidate: a playing looped sound source and its grid cell. Used internally by Audio.
+struct EmitterClusterCandidate
+{
+    /// Sound source.
+    SoundSource3D* source_;
+    /// Sound being played.
+    Sound* sound_;
+    /// Grid cell X coordinate.
+    int cellX_;
+    /// Grid cell Y coordinate.
+    int cellY_;
+    /// Grid cell Z coordinate.
+    int cellZ_;
+};
+
+/// Change to the ambisonic bed decided without the audio mutex and applied under it. Used internally by Audio.
+struct AmbientBedChange
+{
+    /// Sound source.
+    SoundSource3D* source_;
+    /// Emitter to update, add or remove.
+    AmbientEmitter* emitter_;
+    /// Emitter gain.
+    float gain_;
+    /// Normalized direction from the listener.
+    Vector3 direction_;
+    /// Playback position in seconds of a removed emitter.
+    double position_;
+    /// New emitter flag.
+    bool add_;
+    /// Removed emitter flag.
+    bool remove_;
+};
+
+/// Structure-of-arrays parameters of playing 3D voices, one element per voice in each array. Used internally by Audio.
+struct Voice3DBlock
+{
+    /// Resize all arrays.
+    void Resize(unsigned size);
+    /// Copy a voice to another slot.
+    void Move(unsigned dest, unsigned src);
+    /// Return kernel array pointers starting from a slot.
+    Voice3DArrays GetArrays(unsigned start);
+
+    /// Sound sources owning the voices.
+    PODVector<SoundSource3D*> sources_;
+    /// Voice handles.
+    PODVector<unsigned> handles_;
+    /// Position X coordinates.
+    PODVector<float> positionX_;
+    /// Position Y coordinates.
+    PODVector<float> positionY_;
+    /// Position Z coordinates.
+    PODVector<float> positionZ_;
+    /// Velocity X components in units per second.
+    PODVector<float> velocityX_;
+    /// Velocity Y components in units per second.
+    PODVector<float> velocityY_;
+    /// Velocity Z components in units per second.
+    PODVector<float> velocityZ_;
+    /// Near distances.
+    PODVector<float> nearDistance_;
+    /// Far distances.
+    PODVector<float> farDistance_;
+    /// Rolloff factors.
+    PODVector<float> rolloff_;
+    /// Gains before distance attenuation.
+    PODVector<float> gain_;
+    /// Pitches before Doppler.
+    PODVector<float> pitch_;
+    /// Computed distance attenuations.
+    PODVector<float> attenuation_;
+    /// Computed panning.
+    PODVector<float> pan_;
+    /// Computed Doppler speed multipliers.
+    PODVector<float> doppler_;
+    /// Volumes last submitted to the voices.
+    PODVector<float> voiceVolume_;
+    /// Panning last submitted to the voices.
+    PODVector<float> voicePan_;
+    /// Doppler multipliers last submitted to the voices.
+    PODVector<float> voiceDoppler_;
+    /// Pitches last submitted to the voices.
+    PODVector<float> voicePitch_;
+};
 
 class customAttenuator : public SoLoud::AudioAttenuator
 {
@@ -65,6 +169,10 @@ public:
 
     /// Initialize sound output with specified buffer length and output mode.
     bool SetMode(int bufferLengthMSec, int mixRate, bool stereo, bool interpolation = true);
+    /// Start initializing sound output on a background thread, so that opening the device does not block startup. Output begins on the first update after the device has opened and E_AUDIOREADY is sent; sounds played before are queued. Return true if the thread was started.
+    bool SetModeAsync(int bufferLengthMSec, int mixRate, bool stereo, bool interpolation = true);
+    /// Set up mixing without an audio device. The caller produces output by calling MixOutput with the audio mutex held, for example a stress harness or rendering to a file. Return true if successful.
+    bool SetModeOffline(int bufferLengthMSec, int mixRate, bool stereo, bool interpolation = true);
     /// Run update on sound sources. Not required for continued playback, but frees unused sound sources & sounds and updates 3D positions.
     void Update(float timeStep);
     /// Restart sound output.
@@ -83,6 +191,36 @@ public:
     void SetListener(SoundListener* listener);
     /// Stop any sound source playing a certain sound clip.
     void StopSound(Sound* sound);
+    /// Set listener distance tiers for amortized sound source updates. Sources within near distance update every frame, sources within far distance every midInterval frames, and the rest round-robin with at most farBudget updates per frame.
+    void SetUpdateTiers(float nearDistance, float farDistance, unsigned midInterval, unsigned farBudget);
+    /// Queue background loads for every sound referenced by a scene or node XML element, deduplicated and ordered by file locality. Return number of loads queued. Sound sources applying these references wait for the loads instead of loading synchronously.
+    unsigned PrewarmSounds(const XMLElement& element);
+    /// Queue background loads for sounds by name, deduplicated and ordered by file locality. Return number of loads queued.
+    unsigned PrewarmSounds(const Vector<String>& names);
+    /// Set time in seconds after which decoded data of sounds that are not playing is evicted. It is decoded again synchronously on the next play, which hitches for the decode time. Zero disables eviction.
+    void SetSoundIdleTime(float seconds);
+    /// Set headless mode for dedicated servers. Closes the audio device; sounds loaded afterwards keep only metadata and sound sources track playback from the sound duration. Set before loading sounds.
+    void SetHeadless(bool enable);
+    /// Set emitter clustering parameters. 3D sources playing the same looped sound within the same cluster radius cell are rendered as one voice while farther than split distance from the listener. Zero radius disables clustering.
+    void SetClusterParameters(float radius, float splitDistance);
+    /// Set listener distance beyond which playing looped 3D sources are encoded into the shared ambisonic bed instead of playing their own voices. Sources flagged ambient always are. Zero disables selection by distance.
+    void SetAmbientDistance(float distance);
+    /// Set maximum number of voices mixed at full quality. The CPU budget governor lowers the limit under load; voices over the limit are virtualized, quietest first.
+    void SetMaxVoices(unsigned count);
+    /// Set whether the CPU budget governor adapts the quality tier to mixer load.
+    void SetGovernorEnabled(bool enable);
+    /// Set mixer load thresholds as fractions of the real-time deadline. Quality steps down while load stays above highLoad and back up while it stays below lowLoad.
+    void SetGovernorThresholds(float highLoad, float lowLoad);
+    /// Set speed of sound in world units per second and Doppler effect strength for 3D sound sources. Zero factor disables Doppler.
+    void SetDopplerParameters(float speedOfSound, float factor);
+    /// Forget the listener velocity used for Doppler, for example after teleporting the listener node.
+    void ResetListenerVelocity();
+    /// Set whether the mixer thread requests real-time scheduling. Applied by the mixer thread on its next callback; falls back to high priority when real-time scheduling is not permitted.
+    void SetMixerPriority(bool realtime);
+    /// Set the CPU the mixer thread is bound to, or -1 for any CPU. Applied by the mixer thread on its next callback.
+    void SetMixerAffinity(int cpu);
+    /// Set whether the mix buffers and sample data allocated afterwards are locked into physical memory, so that the mixer never page faults. Set before loading sounds.
+    void SetLockMemory(bool enable);
 
     /// Return byte size of one sample.
     unsigned GetSampleSize() const { return sampleSize_; }
@@ -90,6 +228,9 @@ public:
     /// Return mixing rate.
     int GetMixRate() const { return mixRate_; }
 
+    /// Return size of the blocks the mixer produces at a time, in samples.
+    unsigned GetFragmentSize() const { return fragmentSize_; }
+
     /// Return whether output is interpolated.
     bool GetInterpolation() const { return interpolation_; }
 
@@ -100,7 +241,22 @@ public:
     bool IsPlaying() const { return playing_; }
 
     /// Return whether an audio stream has been reserved.
-    bool IsInitialized() const { return deviceID_ != 0; }
+    bool IsInitialized() const { return deviceID_ != 0 || offline_; }
+
+    /// Return whether mixing without an audio device.
+    bool IsOffline() const { return offline_; }
+
+    /// Return whether the audio device is being opened in the background.
+    bool IsInitializing() const { return deviceThread_ != 0; }
+
+    /// Return whether in headless mode.
+    bool IsHeadless() const { return headless_; }
+
+    /// Return time in seconds accumulated by updates in headless mode.
+    double GetHeadlessTime() const { return headlessTime_; }
+
+    /// Return audio clock in seconds: the time of the next sample to be mixed. Use with SoundSource::PlayAt for sample-accurate scheduling. In headless mode returns the headless time.
+    double GetAudioClock();
 
     /// Return master gain for a specific sound source type. Unknown sound types will return full gain (1).
     float GetMasterGain(const String& type) const;
@@ -111,9 +267,84 @@ public:
     /// Return active sound listener.
     SoundListener* GetListener() const;
 
+    /// Return distance within which sound sources are updated every frame.
+    float GetUpdateNearDistance() const { return updateNearDistance_; }
+
+    /// Return distance beyond which sound sources are updated round-robin.
+    float GetUpdateFarDistance() const { return updateFarDistance_; }
+
+    /// Return update interval in frames for sound sources between the near and far update distances.
+    unsigned GetMidUpdateInterval() const { return midUpdateInterval_; }
+
+    /// Return maximum number of far sound sources updated per frame.
+    unsigned GetFarUpdateBudget() const { return farUpdateBudget_; }
+
+    /// Return time after which decoded data of idle sounds is evicted.
+    float GetSoundIdleTime() const { return soundIdleTime_; }
+
+    /// Return emitter cluster radius.
+    float GetClusterRadius() const { return clusterRadius_; }
+
+    /// Return listener distance within which emitter clusters split into individual voices.
+    float GetClusterSplitDistance() const { return clusterSplitDistance_; }
+
+    /// Return listener distance beyond which looped 3D sources play through the ambisonic bed.
+    float GetAmbientDistance() const { return ambientDistance_; }
+
+    /// Return the ambisonic bed. Emitters may only be changed with the audio mutex held.
+    AmbisonicBed* GetAmbientBed() { return &ambientBed_; }
+
+    /// Return maximum number of voices mixed at full quality.
+    unsigned GetMaxVoices() const { return maxVoices_; }
+
+    /// Return number of voices mixed at the quality tier last applied by Update.
+    unsigned GetActiveVoiceLimit() const;
+
+    /// Return whether the CPU budget governor is enabled.
+    bool GetGovernorEnabled() const { return governorEnabled_; }
+
+    /// Return smoothed mixer load as a fraction of the real-time deadline.
+    float GetMixLoad() const { return mixLoad_; }
+
+    /// Return current quality tier.
+    AudioQualityTier GetQualityTier() const { return qualityTier_; }
+
+    /// Return speed of sound in world units per second.
+    float GetSpeedOfSound() const { return speedOfSound_; }
+
+    /// Return Doppler effect strength.
+    float GetDopplerFactor() const { return dopplerFactor_; }
+
+    /// Return listener velocity in world units per second.
+    const Vector3& GetListenerVelocity() const { return listenerVelocity_; }
+
+    /// Return whether the mixer thread requests real-time scheduling.
+    bool GetMixerPriority() const { return mixerRealtime_; }
+
+    /// Return the CPU the mixer thread is bound to, or -1 for any CPU.
+    int GetMixerAffinity() const { return mixerAffinity_; }
+
+    /// Return whether memory locking is enabled.
+    bool GetLockMemory() const { return lockMemory_; }
+
+    /// Return result of the last mixer thread priority change.
+    RealtimeStatus GetMixerPriorityStatus() const { return mixerPriorityStatus_; }
+
+    /// Return result of the last mixer thread affinity change.
+    RealtimeStatus GetMixerAffinityStatus() const { return mixerAffinityStatus_; }
+
+    /// Return result of memory locking. Partial if some sample data could not be locked.
+    RealtimeStatus GetMemoryLockStatus() const;
+
+    /// Return number of 3D voices in the packed parameter block.
+    unsigned GetNumVoices3D() const { return voices3D_.handles_.Size(); }
+
     /// Return all sound sources.
     const PODVector<SoundSource*>& GetSoundSources() const { return soundSources_; }
 
+    /// Return whether a sound is still being loaded by a prewarm. The name is sanitized like the resource cache does.
+    bool IsSoundPrewarming(const String& name) const;
+
     /// Return whether the specified master gain has been defined.
     bool HasMasterGain(const String& type) const { return masterGain_.Contains(type); }
 
@@ -121,6 +352,16 @@ public:
     void AddSoundSource(SoundSource* soundSource);
     /// Remove a sound source. Called by SoundSource.
     void RemoveSoundSource(SoundSource* soundSource);
+    /// Add a playing 3D voice to the packed parameter block and return its slot. Called by SoundSource3D.
+    unsigned AddVoice3D(SoundSource3D* source, unsigned handle);
+    /// Remove a 3D voice slot. The last slot moves into its place and its source is notified. Called by SoundSource3D.
+    void RemoveVoice3D(unsigned slot);
+    /// Set position, gain, pitch and distance attenuation of a 3D voice slot. Velocity is derived from the previous position over a nonzero timestep; a jump faster than sound is taken as a teleport and resets it. Called by SoundSource3D.
+    void SetVoice3D(unsigned slot, const Vector3& position, float timeStep, float gain, float pitch, float nearDistance, float farDistance, float rolloffFactor);
+    /// Reset the velocity of a 3D voice slot to zero, after its position jumped. Called by SoundSource3D.
+    void ResetVoice3DVelocity(unsigned slot);
+    /// Compute attenuation, panning and Doppler of a range of 3D voice slots and submit changed values to the voices in one batch.
+    void Update3DVoices(unsigned start, unsigned count);
 
     /// Return audio thread mutex.
     Mutex& GetMutex() { return audioMutex_; }
@@ -128,8 +369,13 @@ public:
     /// Return sound type specific gain multiplied by master gain.
     float GetSoundSourceMasterGain(StringHash typeHash) const;
 
-    /// Mix sound sources into the buffer.
+    /// Mix SoLoud voices into the device buffer through the soft clipping output stage. Called with the audio mutex held.
     void MixOutput(void* dest, unsigned samples);
+    /// Apply changed priority and affinity settings to the calling thread. Called by the mixer thread before mixing.
+    void ApplyMixerThreadSettings();
+
+    /// Return whether mixer thread settings have changed since they were last applied.
+    bool GetMixerSettingsDirty() const { return mixerSettingsDirty_; }
 
 	SoLoud::Soloud* GetSoLoud();
 
@@ -145,17 +391,47 @@ public:
 private:
     /// Handle render update event.
     void HandleRenderUpdate(StringHash eventType, VariantMap& eventData);
+    /// Handle background loaded resource event to finish sound prewarming.
+    void HandleResourceBackgroundLoaded(StringHash eventType, VariantMap& eventData);
     /// Stop sound output and release the sound buffer.
     void Release();
+    /// Fill the desired output format for a mode.
+    void GetDesiredSpec(SDL_AudioSpec& desired, int bufferLengthMSec, int mixRate, bool stereo);
+    /// Set up mixing for an opened device and begin output. Return true if successful.
+    bool InitializeOutput(const SDL_AudioSpec& obtained, bool interpolation);
+    /// Take over the device opened by the device thread and begin output.
+    void FinishAsyncMode();
+    /// Start or drop plays queued while the device was opening, and send the audio ready event.
+    void SendReadyEvent(bool success);
     /// Actually update sound sources with the specific timestep. Called internally.
     void UpdateInternal(float timeStep);
-
-    /// Clipping buffer for mixing.
-    SharedArrayPtr<int> clipBuffer_;
+    /// Group looped 3D sound sources into emitter clusters. Called internally.
+    void UpdateClusters(const Vector3& listenerPosition);
+    /// Move looped 3D sound sources into or out of the ambisonic bed and update their emitters. Called internally.
+    void UpdateAmbientBed(const Vector3& listenerPosition);
+    /// Evict decoded data of sounds that have not played for the idle time. Called internally.
+    void EvictIdleSounds();
+    /// Account a mixed block's time against its deadline and step the quality tier. Called with the audio mutex held.
+    void UpdateGovernor(long long mixTime, unsigned samples);
+    /// Apply the voice limit of the quality tier last applied. Called from the main thread only.
+    void ApplyVoiceLimit();
+    /// Lock the clip buffer and SoLoud scratch buffer into physical memory.
+    void LockOutputMemory();
+    /// Unlock the clip buffer and SoLoud scratch buffer.
+    void UnlockOutputMemory();
+
+    /// Floating point mix buffer for the output stage.
+    SharedArrayPtr<float> clipBuffer_;
     /// Audio thread mutex.
     Mutex audioMutex_;
     /// SDL audio device ID.
     unsigned deviceID_;
+    /// Thread opening the device in the background.
+    AudioDeviceThread* deviceThread_;
+    /// Interpolation flag for the device being opened in the background.
+    bool asyncInterpolation_;
+    /// Offline mixing flag.
+    bool offline_;
     /// Sample size.
     unsigned sampleSize_;
     /// Clip buffer size in samples.
@@ -168,6 +444,32 @@ private:
     bool stereo_;
     /// Playing flag.
     bool playing_;
+    /// Master gain applied by the output stage.
+    float outputGain_;
+    /// Headless mode flag.
+    bool headless_;
+    /// Time accumulated in headless mode.
+    double headlessTime_;
+    /// Number of samples mixed since the mode was set. Protected by the audio mutex.
+    unsigned long long mixedSamples_;
+    /// Maximum number of voices at full quality.
+    unsigned maxVoices_;
+    /// CPU budget governor enable flag.
+    bool governorEnabled_;
+    /// Load above which quality steps down.
+    float governorHighLoad_;
+    /// Load below which quality steps up.
+    float governorLowLoad_;
+    /// Smoothed mixer load. Written by the mixer thread.
+    float mixLoad_;
+    /// Current quality tier. Written by the mixer thread.
+    AudioQualityTier qualityTier_;
+    /// Quality tier whose voice limit has been applied by the main thread.
+    AudioQualityTier reportedTier_;
+    /// Samples mixed while continuously over the high load threshold.
+    unsigned overloadSamples_;
+    /// Samples mixed while continuously under the low load threshold.
+    unsigned headroomSamples_;
     /// Master gain by sound source type.
     HashMap<StringHash, Variant> masterGain_;
     /// Paused sound types.
@@ -176,8 +478,68 @@ private:
     PODVector<SoundSource*> soundSources_;
     /// Sound listener.
     WeakPtr<SoundListener> listener_;
+    /// Distance within which sound sources are updated every frame.
+    float updateNearDistance_;
+    /// Distance beyond which sound sources are updated round-robin.
+    float updateFarDistance_;
+    /// Update interval in frames for mid-distance sound sources.
+    unsigned midUpdateInterval_;
+    /// Maximum number of far sound sources updated per frame.
+    unsigned farUpdateBudget_;
+    /// Update frame counter for staggering mid-distance updates.
+    unsigned updateFrameNumber_;
+    /// Update key for the next sound source added.
+    unsigned nextUpdateKey_;
+    /// Length in frames of the far sound source round-robin cycle, sized from the previous frame's far source count.
+    unsigned farUpdateSlots_;
+    /// Emitter cluster radius.
+    float clusterRadius_;
+    /// Listener distance within which emitter clusters split.
+    float clusterSplitDistance_;
+    /// Listener distance beyond which looped 3D sources play through the ambisonic bed.
+    float ambientDistance_;
+    /// Idle time after which decoded sound data is evicted.
+    float soundIdleTime_;
+    /// Time since the last idle sound eviction check.
+    float evictionTimer_;
+    /// Sounds queued for background loading by a prewarm.
+    HashSet<StringHash> prewarmingSounds_;
+    /// Emitter clustering candidates, kept to avoid reallocation.
+    PODVector<EmitterClusterCandidate> clusterCandidates_;
+    /// Ambisonic bed changes of the current update, kept to avoid reallocation.
+    PODVector<AmbientBedChange> ambientChanges_;
+    /// Packed parameters of playing 3D voices.
+    Voice3DBlock voices3D_;
+    /// Listener velocity in units per second.
+    Vector3 listenerVelocity_;
+    /// Speed of sound in world units per second.
+    float speedOfSound_;
+    /// Doppler effect strength.
+    float dopplerFactor_;
+    /// Mixer thread real-time scheduling flag.
+    bool mixerRealtime_;
+    /// Mixer thread CPU, or -1 for any.
+    int mixerAffinity_;
+    /// Memory locking flag.
+    bool lockMemory_;
+    /// Mixer thread settings changed flag. Cleared by the mixer thread.
+    volatile bool mixerSettingsDirty_;
+    /// Mixer thread priority status. Written by the mixer thread.
+    RealtimeStatus mixerPriorityStatus_;
+    /// Mixer thread affinity status. Written by the mixer thread.
+    RealtimeStatus mixerAffinityStatus_;
+    /// Output buffer memory lock status.
+    RealtimeStatus memoryLockStatus_;
+    /// Locked clip buffer size in bytes.
+    unsigned lockedClipSize_;
+    /// Locked SoLoud scratch buffer. SoLoud may reallocate it, so the locked range is remembered for unlocking.
+    float* lockedScratch_;
+    /// Locked SoLoud scratch buffer size in bytes.
+    unsigned lockedScratchSize_;
 
 	SoLoud::Soloud soloud_;  // SoLoud engine core
+    /// Shared ambisonic bed for ambient emitters. Declared after SoLoud so that it stops its voice before SoLoud is destroyed.
+    AmbisonicBed ambientBed_;
 	Vector3 ListenerPos;
 
 };
@@ -0,0 +1,646 @@
+//
+// Copyright (c) 2008-2016 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "../Precompiled.h"
+
+#include "../Audio/AudioKernels.h"
+#include "../Container/Vector.h"
+#include "../Core/Timer.h"
+#include "../Math/MathDefs.h"
+
+#include <SDL/SDL_cpuinfo.h>
+
+#ifdef URHO3D_SSE
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(_MSC_VER)
+#include <immintrin.h>
+#define URHO3D_AUDIO_AVX2
+#endif
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define URHO3D_AUDIO_NEON
+#endif
+
+#if defined(__GNUC__) && !defined(_MSC_VER)
+#define AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define AVX2_TARGET
+#endif
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+/// Amplitude below which samples pass through the soft clipper unchanged.
+static const float SOFT_CLIP_KNEE = 0.7f;
+/// Saturation input range above the knee, in units of the remaining headroom.
+static const float SOFT_CLIP_RANGE = 3.0f;
+/// Lowest Doppler speed multiplier. Also keeps the divisor away from zero when a source jumps.
+static const float MIN_DOPPLER = 0.5f;
+/// Highest Doppler speed multiplier.
+static const float MAX_DOPPLER = 2.0f;
+
+static const char* kernelNames[] =
+{
+    "Scalar",
+    "SSE2",
+    "AVX2",
+    "NEON",
+    0
+};
+
+typedef void (*AccumulateFunc)(float* dest, const float* src, float gain, unsigned count);
+typedef void (*SoftClipFunc)(float* samples, float gain, unsigned count);
+typedef void (*ConvertFunc)(short* dest, const float* src, unsigned count);
+typedef void (*Compute3DFunc)(const Voice3DArrays& voices, const Voice3DListener& listener, unsigned start, unsigned end);
+
+static void AccumulateScalar(float* dest, const float* src, float gain, unsigned count)
+{
+    for (unsigned i = 0; i < count; ++i)
+        dest[i] += src[i] * gain;
+}
+
+static void SoftClipScalar(float* samples, float gain, unsigned count)
+{
+    const float invRange = 1.0f / (1.0f - SOFT_CLIP_KNEE);
+    const float scale = 1.0f - SOFT_CLIP_KNEE;
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+        float x = samples[i] * gain;
+        float a = Abs(x);
+        // Pade approximation of tanh, which reaches exactly 1 at the end of the range, so that the output reaches full
+        // scale. Operations are ordered as in the vector kernels so that all produce identical results
+        float t = Min(Max(a - SOFT_CLIP_KNEE, 0.0f) * invRange, SOFT_CLIP_RANGE);
+        float t2 = t * t;
+        float y = Min(a, SOFT_CLIP_KNEE) + scale * (t * (27.0f + t2) / (27.0f + 9.0f * t2));
+        samples[i] = x < 0.0f ? -y : y;
+    }
+}
+
+static void ConvertScalar(short* dest, const float* src, unsigned count)
+{
+    for (unsigned i = 0; i < count; ++i)
+    {
+        float x = Clamp(src[i], -1.0f, 1.0f) * 32767.0f;
+        dest[i] = (short)(x < 0.0f ? x - 0.5f : x + 0.5f);
+    }
+}
+
+static void Compute3DScalar(const Voice3DArrays& voices, const Voice3DListener& listener, unsigned start, unsigned end)
+{
+    const Vector3& position = listener.position_;
+    const Vector3& right = listener.right_;
+    const Vector3& velocity = listener.velocity_;
+    const float factor = listener.dopplerFactor_ / listener.speedOfSound_;
+
+    for (unsigned i = start; i < end; ++i)
+    {
+        float dx = voices.positionX_[i] - position.x_;
+        float dy = voices.positionY_[i] - position.y_;
+        float dz = voices.positionZ_[i] - position.z_;
+        float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+        float invDistance = distance > M_EPSILON ? 1.0f / distance : 0.0f;
+
+        float range = Max(voices.farDistance_[i] - voices.nearDistance_[i], M_EPSILON);
+        voices.attenuation_[i] = Clamp((voices.farDistance_[i] - distance) / range, 0.0f, 1.0f);
+        voices.pan_[i] = (dx * right.x_ + dy * right.y_ + dz * right.z_) * invDistance;
+
+        // Speeds along the line of sight away from the listener, relative to the speed of sound
+        float scale = invDistance * factor;
+        float listenerSpeed = (dx * velocity.x_ + dy * velocity.y_ + dz * velocity.z_) * scale;
+        float sourceSpeed = (dx * voices.velocityX_[i] + dy * voices.velocityY_[i] + dz * voices.velocityZ_[i]) * scale;
+        voices.doppler_[i] = Clamp((1.0f + listenerSpeed) / Max(1.0f + sourceSpeed, MIN_DOPPLER), MIN_DOPPLER, MAX_DOPPLER);
+    }
+}
+
+#ifdef URHO3D_SSE
+static void AccumulateSSE2(float* dest, const float* src, float gain, unsigned count)
+{
+    __m128 g = _mm_set1_ps(gain);
+    unsigned i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm_storeu_ps(dest + i, _mm_add_ps(_mm_loadu_ps(dest + i), _mm_mul_ps(_mm_loadu_ps(src + i), g)));
+    AccumulateScalar(dest + i, src + i, gain, count - i);
+}
+
+static void SoftClipSSE2(float* samples, float gain, unsigned count)
+{
+    const __m128 g = _mm_set1_ps(gain);
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 knee = _mm_set1_ps(SOFT_CLIP_KNEE);
+    const __m128 invRange = _mm_set1_ps(1.0f / (1.0f - SOFT_CLIP_KNEE));
+    const __m128 range = _mm_set1_ps(SOFT_CLIP_RANGE);
+    const __m128 scale = _mm_set1_ps(1.0f - SOFT_CLIP_KNEE);
+    const __m128 c27 = _mm_set1_ps(27.0f);
+    const __m128 c9 = _mm_set1_ps(9.0f);
+    const __m128 zero = _mm_setzero_ps();
+
+    unsigned i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 x = _mm_mul_ps(_mm_loadu_ps(samples + i), g);
+        __m128 sign = _mm_and_ps(x, signMask);
+        __m128 a = _mm_andnot_ps(signMask, x);
+        __m128 t = _mm_min_ps(_mm_mul_ps(_mm_max_ps(_mm_sub_ps(a, knee), zero), invRange), range);
+        __m128 t2 = _mm_mul_ps(t, t);
+        __m128 pade = _mm_div_ps(_mm_mul_ps(t, _mm_add_ps(c27, t2)), _mm_add_ps(c27, _mm_mul_ps(c9, t2)));
+        __m128 y = _mm_add_ps(_mm_min_ps(a, knee), _mm_mul_ps(scale, pade));
+        _mm_storeu_ps(samples + i, _mm_or_ps(y, sign));
+    }
+    SoftClipScalar(samples + i, gain, count - i);
+}
+
+static void ConvertSSE2(short* dest, const float* src, unsigned count)
+{
+    const __m128 minValue = _mm_set1_ps(-1.0f);
+    const __m128 maxValue = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set1_ps(32767.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+
+    unsigned i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128 lo = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i), minValue), maxValue), scale);
+        __m128 hi = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i + 4), minValue), maxValue), scale);
+        // Add half away from zero and truncate, rounding like the scalar path instead of to nearest even
+        lo = _mm_add_ps(lo, _mm_or_ps(half, _mm_and_ps(lo, signMask)));
+        hi = _mm_add_ps(hi, _mm_or_ps(half, _mm_and_ps(hi, signMask)));
+        _mm_storeu_si128((__m128i*)(dest + i), _mm_packs_epi32(_mm_cvttps_epi32(lo), _mm_cvttps_epi32(hi)));
+    }
+    ConvertScalar(dest + i, src + i, count - i);
+}
+
+static inline __m128 Dot3SSE2(__m128 x, __m128 y, __m128 z, __m128 ax, __m128 ay, __m128 az)
+{
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, ax), _mm_mul_ps(y, ay)), _mm_mul_ps(z, az));
+}
+
+static void Compute3DSSE2(const Voice3DArrays& voices, const Voice3DListener& listener, unsigned start, unsigned end)
+{
+    const __m128 positionX = _mm_set1_ps(listener.position_.x_);
+    const __m128 positionY = _mm_set1_ps(listener.position_.y_);
+    const __m128 positionZ = _mm_set1_ps(listener.position_.z_);
+    const __m128 rightX = _mm_set1_ps(listener.right_.x_);
+    const __m128 rightY = _mm_set1_ps(listener.right_.y_);
+    const __m128 rightZ = _mm_set1_ps(listener.right_.z_);
+    const __m128 velocityX = _mm_set1_ps(listener.velocity_.x_);
+    const __m128 velocityY = _mm_set1_ps(listener.velocity_.y_);
+    const __m128 velocityZ = _mm_set1_ps(listener.velocity_.z_);
+    const __m128 factor = _mm_set1_ps(listener.dopplerFactor_ / listener.speedOfSound_);
+    const __m128 epsilon = _mm_set1_ps(M_EPSILON);
+    const __m128 minDoppler = _mm_set1_ps(MIN_DOPPLER);
+    const __m128 maxDoppler = _mm_set1_ps(MAX_DOPPLER);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 zero = _mm_setzero_ps();
+
+    unsigned i = start;
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(voices.positionX_ + i), positionX);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(voices.positionY_ + i), positionY);
+        __m128 dz = _mm_sub_ps(_mm_loadu_ps(voices.positionZ_ + i), positionZ);
+        __m128 distance = _mm_sqrt_ps(Dot3SSE2(dx, dy, dz, dx, dy, dz));
+        __m128 invDistance = _mm_and_ps(_mm_cmpgt_ps(distance, epsilon), _mm_div_ps(one, _mm_max_ps(distance, epsilon)));
+
+        __m128 farDistance = _mm_loadu_ps(voices.farDistance_ + i);
+        __m128 range = _mm_max_ps(_mm_sub_ps(farDistance, _mm_loadu_ps(voices.nearDistance_ + i)), epsilon);
+        __m128 attenuation = _mm_div_ps(_mm_sub_ps(farDistance, distance), range);
+        _mm_storeu_ps(voices.attenuation_ + i, _mm_min_ps(_mm_max_ps(attenuation, zero), one));
+        _mm_storeu_ps(voices.pan_ + i, _mm_mul_ps(Dot3SSE2(dx, dy, dz, rightX, rightY, rightZ), invDistance));
+
+        __m128 scale = _mm_mul_ps(invDistance, factor);
+        __m128 listenerSpeed = _mm_mul_ps(Dot3SSE2(dx, dy, dz, velocityX, velocityY, velocityZ), scale);
+        __m128 sourceSpeed = _mm_mul_ps(Dot3SSE2(dx, dy, dz, _mm_loadu_ps(voices.velocityX_ + i), _mm_loadu_ps(voices.velocityY_ + i),
+            _mm_loadu_ps(voices.velocityZ_ + i)), scale);
+        __m128 doppler = _mm_div_ps(_mm_add_ps(one, listenerSpeed), _mm_max_ps(_mm_add_ps(one, sourceSpeed), minDoppler));
+        _mm_storeu_ps(voices.doppler_ + i, _mm_min_ps(_mm_max_ps(doppler, minDoppler), maxDoppler));
+    }
+    Compute3DScalar(voices, listener, i, end);
+}
+#endif
+
+#ifdef URHO3D_AUDIO_AVX2
+AVX2_TARGET static void AccumulateAVX2(float* dest, const float* src, float gain, unsigned count)
+{
+    __m256 g = _mm256_set1_ps(gain);
+    unsigned i = 0;
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(dest + i, _mm256_add_ps(_mm256_loadu_ps(dest + i), _mm256_mul_ps(_mm256_loadu_ps(src + i), g)));
+    AccumulateScalar(dest + i, src + i, gain, count - i);
+}
+
+AVX2_TARGET static void SoftClipAVX2(float* samples, float gain, unsigned count)
+{
+    const __m256 g = _mm256_set1_ps(gain);
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+    const __m256 knee = _mm256_set1_ps(SOFT_CLIP_KNEE);
+    const __m256 invRange = _mm256_set1_ps(1.0f / (1.0f - SOFT_CLIP_KNEE));
+    const __m256 range = _mm256_set1_ps(SOFT_CLIP_RANGE);
+    const __m256 scale = _mm256_set1_ps(1.0f - SOFT_CLIP_KNEE);
+    const __m256 c27 = _mm256_set1_ps(27.0f);
+    const __m256 c9 = _mm256_set1_ps(9.0f);
+    const __m256 zero = _mm256_setzero_ps();
+
+    unsigned i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 x = _mm256_mul_ps(_mm256_loadu_ps(samples + i), g);
+        __m256 sign = _mm256_and_ps(x, signMask);
+        __m256 a = _mm256_andnot_ps(signMask, x);
+        __m256 t = _mm256_min_ps(_mm256_mul_ps(_mm256_max_ps(_mm256_sub_ps(a, knee), zero), invRange), range);
+        __m256 t2 = _mm256_mul_ps(t, t);
+        __m256 pade = _mm256_div_ps(_mm256_mul_ps(t, _mm256_add_ps(c27, t2)), _mm256_add_ps(c27, _mm256_mul_ps(c9, t2)));
+        __m256 y = _mm256_add_ps(_mm256_min_ps(a, knee), _mm256_mul_ps(scale, pade));
+        _mm256_storeu_ps(samples + i, _mm256_or_ps(y, sign));
+    }
+    SoftClipScalar(samples + i, gain, count - i);
+}
+
+AVX2_TARGET static void ConvertAVX2(short* dest, const float* src, unsigned count)
+{
+    const __m256 minValue = _mm256_set1_ps(-1.0f);
+    const __m256 maxValue = _mm256_set1_ps(1.0f);
+    const __m256 scale = _mm256_set1_ps(32767.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+
+    unsigned i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m256 lo = _mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i), minValue), maxValue), scale);
+        __m256 hi = _mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i + 8), minValue), maxValue), scale);
+        lo = _mm256_add_ps(lo, _mm256_or_ps(half, _mm256_and_ps(lo, signMask)));
+        hi = _mm256_add_ps(hi, _mm256_or_ps(half, _mm256_and_ps(hi, signMask)));
+        // Packing works within 128-bit lanes, so restore sample order afterwards
+        __m256i packed = _mm256_packs_epi32(_mm256_cvttps_epi32(lo), _mm256_cvttps_epi32(hi));
+        _mm256_storeu_si256((__m256i*)(dest + i), _mm256_permute4x64_epi64(packed, 0xd8));
+    }
+    ConvertScalar(dest + i, src + i, count - i);
+}
+
+AVX2_TARGET static inline __m256 Dot3AVX2(__m256 x, __m256 y, __m256 z, __m256 ax, __m256 ay, __m256 az)
+{
+    return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, ax), _mm256_mul_ps(y, ay)), _mm256_mul_ps(z, az));
+}
+
+AVX2_TARGET static void Compute3DAVX2(const Voice3DArrays& voices, const Voice3DListener& listener, unsigned start, unsigned end)
+{
+    const __m256 positionX = _mm256_set1_ps(listener.position_.x_);
+    const __m256 positionY = _mm256_set1_ps(listener.position_.y_);
+    const __m256 positionZ = _mm256_set1_ps(listener.position_.z_);
+    const __m256 rightX = _mm256_set1_ps(listener.right_.x_);
+    const __m256 rightY = _mm256_set1_ps(listener.right_.y_);
+    const __m256 rightZ = _mm256_set1_ps(listener.right_.z_);
+    const __m256 velocityX = _mm256_set1_ps(listener.velocity_.x_);
+    const __m256 velocityY = _mm256_set1_ps(listener.velocity_.y_);
+    const __m256 velocityZ = _mm256_set1_ps(listener.velocity_.z_);
+    const __m256 factor = _mm256_set1_ps(listener.dopplerFactor_ / listener.speedOfSound_);
+    const __m256 epsilon = _mm256_set1_ps(M_EPSILON);
+    const __m256 minDoppler = _mm256_set1_ps(MIN_DOPPLER);
+    const __m256 maxDoppler = _mm256_set1_ps(MAX_DOPPLER);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 zero = _mm256_setzero_ps();
+
+    unsigned i = start;
+    for (; i + 8 <= end; i += 8)
+    {
+        __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(voices.positionX_ + i), positionX);
+        __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(voices.positionY_ + i), positionY);
+        __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(voices.positionZ_ + i), positionZ);
+        __m256 distance = _mm256_sqrt_ps(Dot3AVX2(dx, dy, dz, dx, dy, dz));
+        __m256 invDistance = _mm256_and_ps(_mm256_cmp_ps(distance, epsilon, _CMP_GT_OQ), _mm256_div_ps(one, _mm256_max_ps(distance, epsilon)));
+
+        __m256 farDistance = _mm256_loadu_ps(voices.farDistance_ + i);
+        __m256 range = _mm256_max_ps(_mm256_sub_ps(farDistance, _mm256_loadu_ps(voices.nearDistance_ + i)), epsilon);
+        __m256 attenuation = _mm256_div_ps(_mm256_sub_ps(farDistance, distance), range);
+        _mm256_storeu_ps(voices.attenuation_ + i, _mm256_min_ps(_mm256_max_ps(attenuation, zero), one));
+        _mm256_storeu_ps(voices.pan_ + i, _mm256_mul_ps(Dot3AVX2(dx, dy, dz, rightX, rightY, rightZ), invDistance));
+
+        __m256 scale = _mm256_mul_ps(invDistance, factor);
+        __m256 listenerSpeed = _mm256_mul_ps(Dot3AVX2(dx, dy, dz, velocityX, velocityY, velocityZ), scale);
+        __m256 sourceSpeed = _mm256_mul_ps(Dot3AVX2(dx, dy, dz, _mm256_loadu_ps(voices.velocityX_ + i),
+            _mm256_loadu_ps(voices.velocityY_ + i), _mm256_loadu_ps(voices.velocityZ_ + i)), scale);
+        __m256 doppler = _mm256_div_ps(_mm256_add_ps(one, listenerSpeed), _mm256_max_ps(_mm256_add_ps(one, sourceSpeed), minDoppler));
+        _mm256_storeu_ps(voices.doppler_ + i, _mm256_min_ps(_mm256_max_ps(doppler, minDoppler), maxDoppler));
+    }
+    Compute3DScalar(voices, listener, i, end);
+}
+#endif
+
+#ifdef URHO3D_AUDIO_NEON
+static void AccumulateNEON(float* dest, const float* src, float gain, unsigned count)
+{
+    unsigned i = 0;
+    for (; i + 4 <= count; i += 4)
+        vst1q_f32(dest + i, vmlaq_n_f32(vld1q_f32(dest + i), vld1q_f32(src + i), gain));
+    AccumulateScalar(dest + i, src + i, gain, count - i);
+}
+
+static void SoftClipNEON(float* samples, float gain, unsigned count)
+{
+    const float32x4_t knee = vdupq_n_f32(SOFT_CLIP_KNEE);
+    const float32x4_t range = vdupq_n_f32(SOFT_CLIP_RANGE);
+    const float32x4_t c27 = vdupq_n_f32(27.0f);
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float invRange = 1.0f / (1.0f - SOFT_CLIP_KNEE);
+    const float scale = 1.0f - SOFT_CLIP_KNEE;
+
+    unsigned i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        float32x4_t x = vmulq_n_f32(vld1q_f32(samples + i), gain);
+        float32x4_t a = vabsq_f32(x);
+        float32x4_t t = vminq_f32(vmulq_n_f32(vmaxq_f32(vsubq_f32(a, knee), zero), invRange), range);
+        float32x4_t t2 = vmulq_f32(t, t);
+        float32x4_t num = vmulq_f32(t, vaddq_f32(c27, t2));
+        float32x4_t den = vaddq_f32(c27, vmulq_n_f32(t2, 9.0f));
+#ifdef __aarch64__
+        float32x4_t pade = vdivq_f32(num, den);
+#else
+        // No vector division before AArch64; reciprocal estimate refined by two Newton-Raphson steps
+        float32x4_t recip = vrecpeq_f32(den);
+        recip = vmulq_f32(vrecpsq_f32(den, recip), recip);
+        recip = vmulq_f32(vrecpsq_f32(den, recip), recip);
+        float32x4_t pade = vmulq_f32(num, recip);
+#endif
+        float32x4_t y = vaddq_f32(vminq_f32(a, knee), vmulq_n_f32(pade, scale));
+        uint32x4_t sign = vandq_u32(vreinterpretq_u32_f32(x), vdupq_n_u32(0x80000000));
+        vst1q_f32(samples + i, vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(y), sign)));
+    }
+    SoftClipScalar(samples + i, gain, count - i);
+}
+
+static void ConvertNEON(short* dest, const float* src, unsigned count)
+{
+    const float32x4_t minValue = vdupq_n_f32(-1.0f);
+    const float32x4_t maxValue = vdupq_n_f32(1.0f);
+    const float32x4_t half = vdupq_n_f32(0.5f);
+    const uint32x4_t signMask = vdupq_n_u32(0x80000000);
+
+    unsigned i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        float32x4_t lo = vmulq_n_f32(vminq_f32(vmaxq_f32(vld1q_f32(src + i), minValue), maxValue), 32767.0f);
+        float32x4_t hi = vmulq_n_f32(vminq_f32(vmaxq_f32(vld1q_f32(src + i + 4), minValue), maxValue), 32767.0f);
+        // Conversion truncates, so add half away from zero to round like the scalar path
+        lo = vaddq_f32(lo, vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(half), vandq_u32(vreinterpretq_u32_f32(lo), signMask))));
+        hi = vaddq_f32(hi, vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(half), vandq_u32(vreinterpretq_u32_f32(hi), signMask))));
+        vst1q_s16(dest + i, vcombine_s16(vqmovn_s32(vcvtq_s32_f32(lo)), vqmovn_s32(vcvtq_s32_f32(hi))));
+    }
+    ConvertScalar(dest + i, src + i, count - i);
+}
+
+static inline float32x4_t Dot3NEON(float32x4_t x, float32x4_t y, float32x4_t z, float32x4_t ax, float32x4_t ay, float32x4_t az)
+{
+    return vmlaq_f32(vmlaq_f32(vmulq_f32(x, ax), y, ay), z, az);
+}
+
+static inline float32x4_t ReciprocalNEON(float32x4_t x)
+{
+    // Reciprocal estimate refined by two Newton-Raphson steps
+    float32x4_t recip = vrecpeq_f32(x);
+    recip = vmulq_f32(vrecpsq_f32(x, recip), recip);
+    return vmulq_f32(vrecpsq_f32(x, recip), recip);
+}
+
+static void Compute3DNEON(const Voice3DArrays& voices, const Voice3DListener& listener, unsigned start, unsigned end)
+{
+    const float32x4_t positionX = vdupq_n_f32(listener.position_.x_);
+    const float32x4_t positionY = vdupq_n_f32(listener.position_.y_);
+    const float32x4_t positionZ = vdupq_n_f32(listener.position_.z_);
+    const float32x4_t rightX = vdupq_n_f32(listener.right_.x_);
+    const float32x4_t rightY = vdupq_n_f32(listener.right_.y_);
+    const float32x4_t rightZ = vdupq_n_f32(listener.right_.z_);
+    const float32x4_t velocityX = vdupq_n_f32(listener.velocity_.x_);
+    const float32x4_t velocityY = vdupq_n_f32(listener.velocity_.y_);
+    const float32x4_t velocityZ = vdupq_n_f32(listener.velocity_.z_);
+    const float factor = listener.dopplerFactor_ / listener.speedOfSound_;
+    const float32x4_t epsilon = vdupq_n_f32(M_EPSILON);
+    const float32x4_t epsilonSquared = vdupq_n_f32(M_EPSILON * M_EPSILON);
+    const float32x4_t minDoppler = vdupq_n_f32(MIN_DOPPLER);
+    const float32x4_t maxDoppler = vdupq_n_f32(MAX_DOPPLER);
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+
+    unsigned i = start;
+    for (; i + 4 <= end; i += 4)
+    {
+        float32x4_t dx = vsubq_f32(vld1q_f32(voices.positionX_ + i), positionX);
+        float32x4_t dy = vsubq_f32(vld1q_f32(voices.positionY_ + i), positionY);
+        float32x4_t dz = vsubq_f32(vld1q_f32(voices.positionZ_ + i), positionZ);
+        float32x4_t distanceSquared = vmaxq_f32(Dot3NEON(dx, dy, dz, dx, dy, dz), epsilonSquared);
+        // Reciprocal square root estimate refined by two Newton-Raphson steps
+        float32x4_t rsqrt = vrsqrteq_f32(distanceSquared);
+        rsqrt = vmulq_f32(vrsqrtsq_f32(vmulq_f32(distanceSquared, rsqrt), rsqrt), rsqrt);
+        rsqrt = vmulq_f32(vrsqrtsq_f32(vmulq_f32(distanceSquared, rsqrt), rsqrt), rsqrt);
+        float32x4_t distance = vmulq_f32(distanceSquared, rsqrt);
+        float32x4_t invDistance = vreinterpretq_f32_u32(vandq_u32(vcgtq_f32(distanceSquared, epsilonSquared),
+            vreinterpretq_u32_f32(rsqrt)));
+
+        float32x4_t farDistance = vld1q_f32(voices.farDistance_ + i);
+        float32x4_t range = vmaxq_f32(vsubq_f32(farDistance, vld1q_f32(voices.nearDistance_ + i)), epsilon);
+        float32x4_t attenuation = vmulq_f32(vsubq_f32(farDistance, distance), ReciprocalNEON(range));
+        vst1q_f32(voices.attenuation_ + i, vminq_f32(vmaxq_f32(attenuation, zero), one));
+        vst1q_f32(voices.pan_ + i, vmulq_f32(Dot3NEON(dx, dy, dz, rightX, rightY, rightZ), invDistance));
+
+        float32x4_t scale = vmulq_n_f32(invDistance, factor);
+        float32x4_t listenerSpeed = vmulq_f32(Dot3NEON(dx, dy, dz, velocityX, velocityY, velocityZ), scale);
+        float32x4_t sourceSpeed = vmulq_f32(Dot3NEON(dx, dy, dz, vld1q_f32(voices.velocityX_ + i), vld1q_f32(voices.velocityY_ + i),
+            vld1q_f32(voices.velocityZ_ + i)), scale);
+        float32x4_t doppler = vmulq_f32(vaddq_f32(one, listenerSpeed), ReciprocalNEON(vmaxq_f32(vaddq_f32(one, sourceSpeed), minDoppler)));
+        vst1q_f32(voices.doppler_ + i, vminq_f32(vmaxq_f32(doppler, minDoppler), maxDoppler));
+    }
+    Compute3DScalar(voices, listener, i, end);
+}
+#endif
+
+static AudioKernelLevel kernelLevel = AUDIO_KERNEL_SCALAR;
+static AccumulateFunc accumulateFunc = AccumulateScalar;
+static SoftClipFunc softClipFunc = SoftClipScalar;
+static ConvertFunc convertFunc = ConvertScalar;
+static Compute3DFunc compute3DFunc = Compute3DScalar;
+
+void AccumulateSamples(float* dest, const float* src, float gain, unsigned count)
+{
+    accumulateFunc(dest, src, gain, count);
+}
+
+void SoftClipSamples(float* samples, float gain, unsigned count)
+{
+    softClipFunc(samples, gain, count);
+}
+
+void ConvertSamples(short* dest, const float* src, unsigned count)
+{
+    convertFunc(dest, src, count);
+}
+
+void Compute3DVoices(const Voice3DArrays& voices, const Voice3DListener& listener, unsigned count)
+{
+    compute3DFunc(voices, listener, 0, count);
+
+    // Rolloff power has no vector instruction; the default square and linear rolloffs avoid pow
+    for (unsigned i = 0; i < count; ++i)
+    {
+        float rolloff = voices.rolloff_[i];
+        float& attenuation = voices.attenuation_[i];
+        if (rolloff == 2.0f)
+            attenuation *= attenuation;
+        else if (rolloff != 1.0f && attenuation > 0.0f)
+            attenuation = powf(attenuation, rolloff);
+    }
+}
+
+static bool IsKernelLevelSupported(AudioKernelLevel level)
+{
+    switch (level)
+    {
+    case AUDIO_KERNEL_SCALAR:
+        return true;
+
+#ifdef URHO3D_SSE
+    case AUDIO_KERNEL_SSE2:
+        return SDL_HasSSE2() == SDL_TRUE;
+#endif
+
+#ifdef URHO3D_AUDIO_AVX2
+    case AUDIO_KERNEL_AVX2:
+        return SDL_HasAVX2() == SDL_TRUE;
+#endif
+
+#ifdef URHO3D_AUDIO_NEON
+    case AUDIO_KERNEL_NEON:
+        return true;
+#endif
+
+    default:
+        return false;
+    }
+}
+
+AudioKernelLevel SetAudioKernelLevel(AudioKernelLevel level)
+{
+    // Fall back through the x86 levels; NEON is exclusive with them
+    if (level >= MAX_AUDIO_KERNEL_LEVELS)
+        level = GetMaxAudioKernelLevel();
+    if (level == AUDIO_KERNEL_NEON && !IsKernelLevelSupported(level))
+        level = AUDIO_KERNEL_SCALAR;
+    while (level > AUDIO_KERNEL_SCALAR && !IsKernelLevelSupported(level))
+        level = (AudioKernelLevel)(level - 1);
+
+    switch (level)
+    {
+#ifdef URHO3D_SSE
+    case AUDIO_KERNEL_SSE2:
+        accumulateFunc = AccumulateSSE2;
+        softClipFunc = SoftClipSSE2;
+        convertFunc = ConvertSSE2;
+        compute3DFunc = Compute3DSSE2;
+        break;
+#endif
+
+#ifdef URHO3D_AUDIO_AVX2
+    case AUDIO_KERNEL_AVX2:
+        accumulateFunc = AccumulateAVX2;
+        softClipFunc = SoftClipAVX2;
+        convertFunc = ConvertAVX2;
+        compute3DFunc = Compute3DAVX2;
+        break;
+#endif
+
+#ifdef URHO3D_AUDIO_NEON
+    case AUDIO_KERNEL_NEON:
+        accumulateFunc = AccumulateNEON;
+        softClipFunc = SoftClipNEON;
+        convertFunc = ConvertNEON;
+        compute3DFunc = Compute3DNEON;
+        break;
+#endif
+
+    default:
+        accumulateFunc = AccumulateScalar;
+        softClipFunc = SoftClipScalar;
+        convertFunc = ConvertScalar;
+        compute3DFunc = Compute3DScalar;
+        break;
+    }
+
+    kernelLevel = level;
+    return level;
+}
+
+AudioKernelLevel GetAudioKernelLevel()
+{
+    return kernelLevel;
+}
+
+AudioKernelLevel GetMaxAudioKernelLevel()
+{
+    if (IsKernelLevelSupported(AUDIO_KERNEL_NEON))
+        return AUDIO_KERNEL_NEON;
+    if (IsKernelLevelSupported(AUDIO_KERNEL_AVX2))
+        return AUDIO_KERNEL_AVX2;
+    if (IsKernelLevelSupported(AUDIO_KERNEL_SSE2))
+        return AUDIO_KERNEL_SSE2;
+    return AUDIO_KERNEL_SCALAR;
+}
+
+const char* GetAudioKernelName(AudioKernelLevel level)
+{
+    return level < MAX_AUDIO_KERNEL_LEVELS ? kernelNames[level] : "";
+}
+
+float BenchmarkAudioKernels(AudioKernelLevel level, unsigned samples, unsigned iterations)
+{
+    if (!samples || !iterations)
+        return 0.0f;
+
+    // Overdriven test signal so that every sample takes the saturation path
+    PODVector<float> source(samples);
+    PODVector<float> work(samples);
+    PODVector<short> output(samples);
+    for (unsigned i = 0; i < samples; ++i)
+        source[i] = 2.0f * sinf((float)i * 0.05f);
+
+    AudioKernelLevel oldLevel = kernelLevel;
+    SetAudioKernelLevel(level);
+
+    HiresTimer timer;
+    for (unsigned i = 0; i < iterations; ++i)
+    {
+        memcpy(&work[0], &source[0], samples * sizeof(float));
+        SoftClipSamples(&work[0], 0.8f, samples);
+        ConvertSamples(&output[0], &work[0], samples);
+    }
+    float usec = (float)timer.GetUSec(false) / (float)iterations;
+
+    SetAudioKernelLevel(oldLevel);
+    return usec;
+}
+
+}
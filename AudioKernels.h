@@ -0,0 +1,106 @@
+//
+// Copyright (c) 2008-2016 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../Math/Vector3.h"
+
+namespace Urho3D
+{
+
+/// Instruction set used by the audio output stage kernels.
+enum AudioKernelLevel
+{
+    AUDIO_KERNEL_SCALAR = 0,
+    AUDIO_KERNEL_SSE2,
+    AUDIO_KERNEL_AVX2,
+    AUDIO_KERNEL_NEON,
+    MAX_AUDIO_KERNEL_LEVELS
+};
+
+/// Pointers to structure-of-arrays parameters of 3D voices, one element per voice in each array. Positions are in world space and velocities in world units per second. Input arrays are read and output arrays written.
+struct Voice3DArrays
+{
+    /// Position X coordinates.
+    const float* positionX_;
+    /// Position Y coordinates.
+    const float* positionY_;
+    /// Position Z coordinates.
+    const float* positionZ_;
+    /// Velocity X components.
+    const float* velocityX_;
+    /// Velocity Y components.
+    const float* velocityY_;
+    /// Velocity Z components.
+    const float* velocityZ_;
+    /// Distances within which voices are not attenuated.
+    const float* nearDistance_;
+    /// Distances beyond which voices are silent.
+    const float* farDistance_;
+    /// Rolloff power factors.
+    const float* rolloff_;
+    /// Output distance attenuation.
+    float* attenuation_;
+    /// Output stereo panning from -1 (left) to 1 (right).
+    float* pan_;
+    /// Output Doppler playback speed multipliers.
+    float* doppler_;
+};
+
+/// Listener state for 3D voice parameter computation.
+struct Voice3DListener
+{
+    /// World position.
+    Vector3 position_;
+    /// World space right direction.
+    Vector3 right_;
+    /// Velocity in world units per second.
+    Vector3 velocity_;
+    /// Speed of sound in world units per second.
+    float speedOfSound_;
+    /// Doppler effect strength. Zero disables Doppler.
+    float dopplerFactor_;
+};
+
+/// Add source samples multiplied by gain to the destination.
+URHO3D_API void AccumulateSamples(float* dest, const float* src, float gain, unsigned count);
+/// Apply gain and soft clip samples in place. Samples below the knee pass through unchanged, louder samples saturate smoothly towards full scale.
+URHO3D_API void SoftClipSamples(float* samples, float gain, unsigned count);
+/// Convert samples in the range -1 to 1 to 16-bit integers, saturating values outside it.
+URHO3D_API void ConvertSamples(short* dest, const float* src, unsigned count);
+
+/// Compute distance attenuation, panning and Doppler speed of 3D voices relative to the listener. Attenuation follows the distance attenuator used by 3D sound sources.
+URHO3D_API void Compute3DVoices(const Voice3DArrays& voices, const Voice3DListener& listener, unsigned count);
+
+/// Select the kernel instruction set. Levels the CPU or build does not support fall back to the best supported one. Return the level in use.
+URHO3D_API AudioKernelLevel SetAudioKernelLevel(AudioKernelLevel level);
+/// Return the kernel instruction set in use.
+URHO3D_API AudioKernelLevel GetAudioKernelLevel();
+/// Return the best kernel instruction set supported by the build and CPU.
+URHO3D_API AudioKernelLevel GetMaxAudioKernelLevel();
+/// Return kernel instruction set name.
+URHO3D_API const char* GetAudioKernelName(AudioKernelLevel level);
+/// Time the output stage (soft clip and conversion) on a block of samples with the specified instruction set. Return average microseconds per block.
+URHO3D_API float BenchmarkAudioKernels(AudioKernelLevel level, unsigned samples, unsigned iterations);
+
+}
@@ -0,0 +1,190 @@
+//
+// Copyright (c) 2008-2016 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "../Precompiled.h"
+
+#include "../Audio/AudioRealtime.h"
+#include "../Math/MathDefs.h"
+
+#include <SDL/SDL_thread.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif !defined(__EMSCRIPTEN__)
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+/// FIFO priority above the minimum. Stays below the priorities audio servers and the kernel use for their own threads.
+static const int REALTIME_PRIORITY_OFFSET = 10;
+
+unsigned GetAudioPageSize()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#elif !defined(__EMSCRIPTEN__)
+    long size = sysconf(_SC_PAGESIZE);
+    return size > 0 ? (unsigned)size : 4096;
+#else
+    return 4096;
+#endif
+}
+
+bool LockAudioMemory(const void* data, unsigned size)
+{
+    if (!data || !size)
+        return false;
+
+#ifdef _WIN32
+    return VirtualLock(const_cast<void*>(data), size) != 0;
+#elif !defined(__EMSCRIPTEN__)
+    return mlock(data, size) == 0;
+#else
+    return false;
+#endif
+}
+
+void UnlockAudioMemory(const void* data, unsigned size)
+{
+    if (!data || !size)
+        return;
+
+#ifdef _WIN32
+    VirtualUnlock(const_cast<void*>(data), size);
+#elif !defined(__EMSCRIPTEN__)
+    munlock(data, size);
+#endif
+}
+
+void* AllocateLockedAudioMemory(unsigned size)
+{
+#ifdef _WIN32
+    void* data = VirtualAlloc(0, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (data && !LockAudioMemory(data, size))
+    {
+        VirtualFree(data, 0, MEM_RELEASE);
+        data = 0;
+    }
+    return data;
+#elif !defined(__EMSCRIPTEN__)
+    unsigned pageSize = GetAudioPageSize();
+    void* data = 0;
+    if (posix_memalign(&data, pageSize, (size + pageSize - 1) & ~(pageSize - 1)))
+        return 0;
+    if (!LockAudioMemory(data, size))
+    {
+        free(data);
+        data = 0;
+    }
+    return data;
+#else
+    return 0;
+#endif
+}
+
+void FreeLockedAudioMemory(void* data, unsigned size)
+{
+    if (!data)
+        return;
+
+    UnlockAudioMemory(data, size);
+#ifdef _WIN32
+    VirtualFree(data, 0, MEM_RELEASE);
+#elif !defined(__EMSCRIPTEN__)
+    free(data);
+#endif
+}
+
+RealtimeStatus SetAudioThreadPriority(bool realtime)
+{
+#ifdef _WIN32
+    HANDLE thread = GetCurrentThread();
+    if (!realtime)
+        return SetThreadPriority(thread, THREAD_PRIORITY_NORMAL) ? REALTIME_DISABLED : REALTIME_FAILED;
+
+    if (!SetThreadPriority(thread, THREAD_PRIORITY_TIME_CRITICAL) && !SetThreadPriority(thread, THREAD_PRIORITY_HIGHEST))
+        return REALTIME_FAILED;
+    // A time-critical thread only reaches the real-time range when the process runs in the real-time priority class
+    return GetThreadPriority(thread) == THREAD_PRIORITY_TIME_CRITICAL && GetPriorityClass(GetCurrentProcess()) == REALTIME_PRIORITY_CLASS ?
+        REALTIME_ENABLED : REALTIME_PARTIAL;
+#elif !defined(__EMSCRIPTEN__)
+    sched_param param;
+    if (!realtime)
+    {
+        param.sched_priority = 0;
+        return pthread_setschedparam(pthread_self(), SCHED_OTHER, &param) == 0 ? REALTIME_DISABLED : REALTIME_FAILED;
+    }
+
+    // Real-time scheduling needs a privilege or an rtprio limit; without either, ask for the highest normal priority instead
+    param.sched_priority = Min(sched_get_priority_min(SCHED_FIFO) + REALTIME_PRIORITY_OFFSET, sched_get_priority_max(SCHED_FIFO));
+    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0)
+        return REALTIME_ENABLED;
+    return SDL_SetThreadPriority(SDL_THREAD_PRIORITY_HIGH) == 0 ? REALTIME_PARTIAL : REALTIME_FAILED;
+#else
+    return REALTIME_FAILED;
+#endif
+}
+
+bool SetAudioThreadAffinity(int cpu)
+{
+#ifdef _WIN32
+    DWORD_PTR mask = cpu >= 0 ? (DWORD_PTR)1 << cpu : ~(DWORD_PTR)0;
+    if (cpu < 0)
+    {
+        DWORD_PTR systemMask;
+        GetProcessAffinityMask(GetCurrentProcess(), &mask, &systemMask);
+    }
+    return cpu < (int)(sizeof(DWORD_PTR) * 8) && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (cpu >= 0)
+    {
+        if (cpu >= CPU_SETSIZE)
+            return false;
+        CPU_SET(cpu, &set);
+    }
+    else
+    {
+        for (int i = 0; i < CPU_SETSIZE; ++i)
+            CPU_SET(i, &set);
+    }
+    // A zero thread ID is the calling thread
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    // Other platforms only offer affinity hints
+    return cpu < 0;
+#endif
+}
+
+}
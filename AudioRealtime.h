@@ -0,0 +1,59 @@
+//
+// Copyright (c) 2008-2016 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+namespace Urho3D
+{
+
+/// Result of a real-time configuration step.
+enum RealtimeStatus
+{
+    /// Not requested.
+    REALTIME_DISABLED = 0,
+    /// Requested and waiting to be applied.
+    REALTIME_PENDING,
+    /// Applied.
+    REALTIME_ENABLED,
+    /// Applied in part, e.g. raised priority without real-time scheduling or some sample data not locked.
+    REALTIME_PARTIAL,
+    /// Not permitted or not supported.
+    REALTIME_FAILED
+};
+
+/// Return the memory page size in bytes.
+URHO3D_API unsigned GetAudioPageSize();
+/// Lock memory pages into physical memory so that touching them never faults. Return true if successful.
+URHO3D_API bool LockAudioMemory(const void* data, unsigned size);
+/// Unlock memory pages. Pages shared with other locked memory are unlocked too, see AllocateLockedAudioMemory.
+URHO3D_API void UnlockAudioMemory(const void* data, unsigned size);
+/// Allocate whole memory pages and lock them, so that unlocking never affects other allocations. Return null if allocation or locking failed.
+URHO3D_API void* AllocateLockedAudioMemory(unsigned size);
+/// Unlock and free memory allocated with AllocateLockedAudioMemory.
+URHO3D_API void FreeLockedAudioMemory(void* data, unsigned size);
+/// Raise the calling thread to real-time FIFO scheduling where permitted, falling back to high priority, or restore normal scheduling. Return the result.
+URHO3D_API RealtimeStatus SetAudioThreadPriority(bool realtime);
+/// Bind the calling thread to a CPU, or allow all CPUs with a negative index. Return true if successful.
+URHO3D_API bool SetAudioThreadAffinity(int cpu);
+
+}
@@ -0,0 +1,252 @@
+//
+// Copyright (c) 2008-2016 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "../Precompiled.h"
+
+#include "../Audio/AudioKernels.h"
+#include "../Audio/AudioSelfTest.h"
+#include "../Audio/OggVorbisSource.h"
+#include "../Audio/SampleBuffer.h"
+#include "../Audio/SampleSource.h"
+#include "../Audio/Sound.h"
+#include "../Container/Vector.h"
+#include "../Core/Context.h"
+#include "../Core/WorkQueue.h"
+#include "../IO/File.h"
+#include "../IO/Log.h"
+#include "../Resource/ResourceCache.h"
+
+#include <cmath>
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+/// Samples run through the kernels. Not a multiple of the vector widths, so that the scalar tails run too.
+static const unsigned KERNEL_TEST_LENGTH = 4099;
+/// Samples per channel compared after each seek.
+static const unsigned SEEK_TEST_LENGTH = 4096;
+
+/// Advance a xorshift generator and return the new state.
+static unsigned NextRandom(unsigned& state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+/// Return index of the first differing sample of two non-interleaved ranges, or count if they match.
+static unsigned FindMismatch(const float* lhs, unsigned long long lhsStride, const float* rhs, unsigned long long rhsStride,
+    unsigned channels, unsigned count)
+{
+    for (unsigned i = 0; i < count; ++i)
+    {
+        for (unsigned j = 0; j < channels; ++j)
+        {
+            if (lhs[j * lhsStride + i] != rhs[j * rhsStride + i])
+                return i;
+        }
+    }
+    return count;
+}
+
+/// Output of the kernels for the test signal.
+struct KernelTestOutput
+{
+    /// Soft clipped samples.
+    PODVector<float> clipped_;
+    /// Converted samples.
+    PODVector<short> converted_;
+    /// Accumulated samples.
+    PODVector<float> accumulated_;
+};
+
+/// Run the kernels of the current instruction set on the test signal.
+static void RunKernels(const PODVector<float>& signal, KernelTestOutput& output)
+{
+    unsigned count = signal.Size();
+    output.clipped_ = signal;
+    SoftClipSamples(&output.clipped_[0], 1.25f, count);
+    output.converted_.Resize(count);
+    ConvertSamples(&output.converted_[0], &signal[0], count);
+    output.accumulated_ = output.clipped_;
+    AccumulateSamples(&output.accumulated_[0], &signal[0], 0.3f, count);
+}
+
+bool TestAudioKernels()
+{
+    // Sweep past the saturation range, and include values that convert exactly halfway between integers
+    PODVector<float> signal(KERNEL_TEST_LENGTH);
+    for (unsigned i = 0; i < KERNEL_TEST_LENGTH; ++i)
+        signal[i] = (i & 7) == 7 ? ((float)(int)(i - KERNEL_TEST_LENGTH / 2) + 0.5f) / 32767.0f :
+            2.5f * sinf((float)i * 0.013f);
+
+    AudioKernelLevel oldLevel = GetAudioKernelLevel();
+    SetAudioKernelLevel(AUDIO_KERNEL_SCALAR);
+    KernelTestOutput reference;
+    RunKernels(signal, reference);
+
+    bool success = true;
+
+    // Full scale must be reachable
+    float peak = 0.0f;
+    for (unsigned i = 0; i < KERNEL_TEST_LENGTH; ++i)
+        peak = Max(peak, Abs(reference.clipped_[i]));
+    if (peak < 0.999f)
+    {
+        URHO3D_LOGERROR("Audio kernel test: soft clip peaks at " + String(peak));
+        success = false;
+    }
+
+    for (unsigned level = AUDIO_KERNEL_SCALAR + 1; level < MAX_AUDIO_KERNEL_LEVELS; ++level)
+    {
+        if (SetAudioKernelLevel((AudioKernelLevel)level) != level)
+            continue;
+
+        KernelTestOutput output;
+        RunKernels(signal, output);
+
+        for (unsigned i = 0; i < KERNEL_TEST_LENGTH; ++i)
+        {
+            if (output.clipped_[i] != reference.clipped_[i] || output.converted_[i] != reference.converted_[i] ||
+                output.accumulated_[i] != reference.accumulated_[i])
+            {
+                URHO3D_LOGERROR("Audio kernel test: " + String(GetAudioKernelName((AudioKernelLevel)level)) +
+                    " differs from scalar at sample " + String(i));
+                success = false;
+                break;
+            }
+        }
+    }
+
+    SetAudioKernelLevel(oldLevel);
+    return success;
+}
+
+bool TestOggSeeking(OggVorbisSource& source, unsigned seeks, unsigned seed)
+{
+    unsigned total = (unsigned)source.GetTotalSamples();
+    unsigned channels = source.mChannels;
+    if (!total || !channels)
+        return false;
+
+    PODVector<float> linear(total * channels);
+    if (source.DecodeRange(0, total, &linear[0], total) != total)
+    {
+        URHO3D_LOGERROR("Ogg seek test: linear decode failed");
+        return false;
+    }
+
+    PODVector<float> sought(SEEK_TEST_LENGTH * channels);
+    unsigned random = seed ? seed : 1;
+    bool success = true;
+
+    for (unsigned i = 0; i < seeks; ++i)
+    {
+        unsigned target = NextRandom(random) % total;
+        unsigned count = Min(SEEK_TEST_LENGTH, total - target);
+        if (source.DecodeRange(target, count, &sought[0], SEEK_TEST_LENGTH) != count)
+        {
+            URHO3D_LOGERROR("Ogg seek test: decode after seeking to sample " + String(target) + " failed");
+            success = false;
+            continue;
+        }
+
+        unsigned mismatch = FindMismatch(&linear[target], total, &sought[0], SEEK_TEST_LENGTH, channels, count);
+        if (mismatch < count)
+        {
+            URHO3D_LOGERROR("Ogg seek test: seek to sample " + String(target) + " differs from linear decode at offset " +
+                String(mismatch));
+            success = false;
+        }
+    }
+
+    return success;
+}
+
+bool TestParallelDecode(Context* context, const String& resourceName)
+{
+    ResourceCache* cache = context->GetSubsystem<ResourceCache>();
+    SharedPtr<File> file = cache ? cache->GetFile(resourceName) : SharedPtr<File>();
+    if (!file)
+    {
+        URHO3D_LOGERROR("Parallel decode test: could not open " + resourceName);
+        return false;
+    }
+
+    WorkQueue* queue = context->GetSubsystem<WorkQueue>();
+    if (!queue || !queue->GetNumThreads())
+        URHO3D_LOGWARNING("Parallel decode test: no worker threads, " + resourceName + " is decoded serially");
+
+    // Serial reference from the same data
+    SampleBuffer* data = new SampleBuffer(file->GetSize());
+    if (file->Read(data->GetData(), data->GetSize()) != data->GetSize())
+    {
+        data->ReleaseRef();
+        return false;
+    }
+    OggVorbisSource serial;
+    if (!serial.LoadMemory(data))
+    {
+        URHO3D_LOGERROR("Parallel decode test: " + resourceName + " is not Ogg Vorbis data");
+        return false;
+    }
+
+    unsigned total = (unsigned)serial.GetTotalSamples();
+    unsigned channels = serial.mChannels;
+    PODVector<float> reference(total * channels);
+    if (serial.DecodeRange(0, total, &reference[0], total) != total)
+    {
+        URHO3D_LOGERROR("Parallel decode test: serial decode failed");
+        return false;
+    }
+
+    file->Seek(0);
+    SharedPtr<Sound> sound(new Sound(context));
+    sound->SetStorage(SOUND_DECODED);
+    if (!sound->Load(*file))
+    {
+        URHO3D_LOGERROR("Parallel decode test: could not load " + resourceName);
+        return false;
+    }
+
+    SampleSource* decoded = static_cast<SampleSource*>(sound->GetAudioSource());
+    if (!decoded || !decoded->GetBuffer() || decoded->GetSampleCount() != total || decoded->mChannels != channels)
+    {
+        URHO3D_LOGERROR("Parallel decode test: decoded length or format differs from serial decode");
+        return false;
+    }
+
+    unsigned mismatch = FindMismatch(decoded->GetBuffer()->GetSamples(), total, &reference[0], total, channels, total);
+    if (mismatch < total)
+    {
+        URHO3D_LOGERROR("Parallel decode test: " + resourceName + " differs from serial decode at sample " + String(mismatch));
+        return false;
+    }
+
+    return true;
+}
+
+}
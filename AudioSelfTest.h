@@ -0,0 +1,40 @@
+//
+// Copyright (c) 2008-2016 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+namespace Urho3D
+{
+
+class Context;
+class OggVorbisSource;
+class String;
+
+/// Run the soft clip, conversion and accumulation kernels of every instruction set supported by the build and CPU on the same input and compare with the scalar kernels. Return true if all outputs are identical.
+URHO3D_API bool TestAudioKernels();
+/// Seek an Ogg Vorbis source to pseudo-random samples and compare the decoded output with a linear decode of the whole stream. Return true if all seeks are sample exact.
+URHO3D_API bool TestOggSeeking(OggVorbisSource& source, unsigned seeks, unsigned seed = 1);
+/// Load an Ogg Vorbis sound resource decoded, which splits long files across the work queue, and compare the samples with a serial decode. Call from the main thread. Return true if identical.
+URHO3D_API bool TestParallelDecode(Context* context, const String& resourceName);
+
+}
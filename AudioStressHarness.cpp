@@ -0,0 +1,393 @@
+//
+// Copyright (c) 2008-2016 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "../Precompiled.h"
+
+#include "../Audio/Audio.h"
+#include "../Audio/AudioStressHarness.h"
+#include "../Audio/SampleBuffer.h"
+#include "../Audio/Sound.h"
+#include "../Audio/SoundSource.h"
+#include "../Core/Context.h"
+#include "../Core/Thread.h"
+#include "../Core/Timer.h"
+#include "../IO/File.h"
+#include "../IO/Log.h"
+#include "../Resource/ResourceCache.h"
+
+#include <cmath>
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+/// Histogram buckets: tenths of the deadline up to twice the deadline, and one for longer blocks.
+static const unsigned HISTOGRAM_BUCKETS = 21;
+/// Length of generated tones in seconds.
+static const float TONE_LENGTH = 0.25f;
+
+static const char* operationNames[] =
+{
+    "create source",
+    "destroy source",
+    "play",
+    "stop",
+    "set gain",
+    "is playing",
+    "load sound",
+    "unload sound"
+};
+
+/// Advance a xorshift generator and return the new state.
+static unsigned NextRandom(unsigned& state)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+/// Mixer thread of the harness. Pumps MixOutput at the real-time rate, as the device callback would, and records block durations.
+class StressMixerThread : public Thread
+{
+public:
+    /// Construct.
+    StressMixerThread(Audio* audio, AudioStressResult& result) :
+        audio_(audio),
+        result_(result),
+        totalUSec_(0)
+    {
+    }
+
+    /// Mix blocks until stopped.
+    virtual void ThreadFunction()
+    {
+        // Run with the scheduling the device callback thread would have
+        audio_->ApplyMixerThreadSettings();
+
+        unsigned blockSamples = audio_->GetFragmentSize();
+        long long deadlineUSec = (long long)blockSamples * 1000000 / audio_->GetMixRate();
+        PODVector<unsigned char> buffer(blockSamples * audio_->GetSampleSize() * Audio::SAMPLE_SIZE_MUL);
+
+        HiresTimer clock;
+        long long nextBlockUSec = 0;
+
+        while (shouldRun_)
+        {
+            HiresTimer blockTimer;
+            long long waitUSec;
+            {
+                MutexLock lock(audio_->GetMutex());
+                waitUSec = blockTimer.GetUSec(false);
+                audio_->MixOutput(&buffer[0], blockSamples);
+            }
+            long long blockUSec = blockTimer.GetUSec(false);
+
+            ++result_.blocks_;
+            if (blockUSec > deadlineUSec)
+                ++result_.lateBlocks_;
+            result_.maxBlockMSec_ = Max(result_.maxBlockMSec_, blockUSec / 1000.0f);
+            result_.maxLockWaitMSec_ = Max(result_.maxLockWaitMSec_, waitUSec / 1000.0f);
+            ++result_.histogram_[Min((unsigned)(blockUSec * 10 / deadlineUSec), HISTOGRAM_BUCKETS - 1)];
+            totalUSec_ += blockUSec;
+
+            // The next block is due one deadline after this one. After falling behind, resume from now instead of bursting to catch up
+            nextBlockUSec += deadlineUSec;
+            long long aheadUSec = nextBlockUSec - clock.GetUSec(false);
+            if (aheadUSec >= 1000)
+                Time::Sleep((unsigned)(aheadUSec / 1000));
+            else if (aheadUSec < -deadlineUSec)
+                nextBlockUSec = clock.GetUSec(false);
+        }
+    }
+
+    /// Return total mixing time in microseconds.
+    long long GetTotalUSec() const { return totalUSec_; }
+
+private:
+    /// Audio subsystem.
+    Audio* audio_;
+    /// Result to record into.
+    AudioStressResult& result_;
+    /// Total mixing time in microseconds.
+    long long totalUSec_;
+};
+
+/// Worker thread of the harness. Performs random operations on sound sources and sounds it owns until stopped.
+class StressWorkerThread : public Thread
+{
+public:
+    /// Construct.
+    StressWorkerThread(Context* context, const Vector<String>& sounds, unsigned maxObjects, unsigned seed) :
+        context_(context),
+        sounds_(sounds),
+        maxObjects_(maxObjects),
+        random_(seed ? seed : 1)
+    {
+        for (unsigned i = 0; i < MAX_STRESS_OPERATIONS; ++i)
+            operations_[i] = 0;
+    }
+
+    /// Perform operations until stopped, then destroy the remaining objects on this thread.
+    virtual void ThreadFunction()
+    {
+        Vector<SharedPtr<SoundSource> > sources;
+        Vector<SharedPtr<Sound> > sounds;
+
+        while (shouldRun_)
+        {
+            AudioStressOperation operation = (AudioStressOperation)(NextRandom(random_) % MAX_STRESS_OPERATIONS);
+            unsigned sourceIndex = sources.Size() ? NextRandom(random_) % sources.Size() : 0;
+            bool done = false;
+
+            switch (operation)
+            {
+            case STRESS_CREATE_SOURCE:
+                if (sources.Size() < maxObjects_)
+                {
+                    sources.Push(SharedPtr<SoundSource>(new SoundSource(context_)));
+                    done = true;
+                }
+                break;
+
+            case STRESS_DESTROY_SOURCE:
+                if (sources.Size())
+                {
+                    sources.Erase(sourceIndex);
+                    done = true;
+                }
+                break;
+
+            case STRESS_PLAY:
+                if (sources.Size() && sounds.Size())
+                {
+                    sources[sourceIndex]->Play(sounds[NextRandom(random_) % sounds.Size()]);
+                    done = true;
+                }
+                break;
+
+            case STRESS_STOP:
+                if (sources.Size())
+                {
+                    sources[sourceIndex]->Stop();
+                    done = true;
+                }
+                break;
+
+            case STRESS_SET_GAIN:
+                if (sources.Size())
+                {
+                    sources[sourceIndex]->SetGain((NextRandom(random_) & 0xff) / 255.0f);
+                    done = true;
+                }
+                break;
+
+            case STRESS_IS_PLAYING:
+                if (sources.Size())
+                {
+                    sources[sourceIndex]->IsPlaying();
+                    done = true;
+                }
+                break;
+
+            case STRESS_LOAD_SOUND:
+                if (sounds.Size() < maxObjects_)
+                {
+                    SharedPtr<Sound> sound = LoadSound();
+                    if (sound)
+                    {
+                        sounds.Push(sound);
+                        done = true;
+                    }
+                }
+                break;
+
+            case STRESS_UNLOAD_SOUND:
+                // Sources still playing the sound keep it alive until they stop or are destroyed
+                if (sounds.Size())
+                {
+                    sounds.Erase(NextRandom(random_) % sounds.Size());
+                    done = true;
+                }
+                break;
+
+            default:
+                break;
+            }
+
+            if (done)
+                ++operations_[operation];
+        }
+
+        sources.Clear();
+        sounds.Clear();
+    }
+
+    /// Return number of operations performed by type.
+    unsigned GetOperations(unsigned type) const { return operations_[type]; }
+
+private:
+    /// Load a named sound, or generate a tone if there are none. Return null on failure.
+    SharedPtr<Sound> LoadSound()
+    {
+        SharedPtr<Sound> sound(new Sound(context_));
+
+        if (sounds_.Size())
+        {
+            const String& name = sounds_[NextRandom(random_) % sounds_.Size()];
+            SharedPtr<File> file = context_->GetSubsystem<ResourceCache>()->GetFile(name, false);
+            sound->SetName(name);
+            if (!file || !sound->BeginLoad(*file))
+                return SharedPtr<Sound>();
+            return sound;
+        }
+
+        int mixRate = context_->GetSubsystem<Audio>()->GetMixRate();
+        unsigned count = (unsigned)(mixRate * TONE_LENGTH);
+        float step = M_PI * 2.0f * (200.0f + (NextRandom(random_) % 800)) / mixRate;
+
+        SampleBuffer* buffer = new SampleBuffer(count * sizeof(float));
+        float* samples = buffer->GetSamples();
+        for (unsigned i = 0; i < count; ++i)
+            samples[i] = 0.5f * sinf(step * i);
+        sound->SetData(buffer, count, 1, (float)mixRate);
+        return sound;
+    }
+
+    /// Execution context.
+    Context* context_;
+    /// Sound resource names.
+    const Vector<String>& sounds_;
+    /// Maximum number of sound sources and sounds.
+    unsigned maxObjects_;
+    /// Random generator state.
+    unsigned random_;
+    /// Number of operations performed by type.
+    unsigned operations_[MAX_STRESS_OPERATIONS];
+};
+
+AudioStressHarness::AudioStressHarness(Context* context) :
+    Object(context),
+    threads_(4),
+    duration_(10.0f),
+    maxObjects_(32),
+    seed_(1)
+{
+}
+
+AudioStressHarness::~AudioStressHarness()
+{
+}
+
+void AudioStressHarness::SetThreads(unsigned threads)
+{
+    threads_ = Max(threads, 1U);
+}
+
+void AudioStressHarness::SetDuration(float seconds)
+{
+    duration_ = Max(seconds, 0.0f);
+}
+
+void AudioStressHarness::SetMaxObjects(unsigned count)
+{
+    maxObjects_ = Max(count, 1U);
+}
+
+void AudioStressHarness::SetSeed(unsigned seed)
+{
+    seed_ = seed;
+}
+
+void AudioStressHarness::AddSound(const String& name)
+{
+    sounds_.Push(name);
+}
+
+bool AudioStressHarness::Run()
+{
+    Audio* audio = GetSubsystem<Audio>();
+    if (!audio || !audio->IsOffline())
+    {
+        URHO3D_LOGERROR("Audio stress harness requires an offline audio mode");
+        return false;
+    }
+    if (!audio->IsPlaying() && !audio->Play())
+        return false;
+
+    result_ = AudioStressResult();
+    result_.histogram_.Resize(HISTOGRAM_BUCKETS);
+    for (unsigned i = 0; i < HISTOGRAM_BUCKETS; ++i)
+        result_.histogram_[i] = 0;
+    result_.deadlineMSec_ = audio->GetFragmentSize() * 1000.0f / audio->GetMixRate();
+
+    StressMixerThread mixer(audio, result_);
+    mixer.Run();
+
+    PODVector<StressWorkerThread*> workers;
+    for (unsigned i = 0; i < threads_; ++i)
+    {
+        // Derive distinct nonzero seeds so that workers do not run in lockstep
+        StressWorkerThread* worker = new StressWorkerThread(context_, sounds_, maxObjects_, seed_ * 2654435761U + i + 1);
+        worker->Run();
+        workers.Push(worker);
+    }
+
+    Time::Sleep((unsigned)(duration_ * 1000.0f));
+
+    // Workers destroy their objects while the mixer still runs, so teardown is measured too
+    for (unsigned i = 0; i < workers.Size(); ++i)
+    {
+        workers[i]->Stop();
+        for (unsigned j = 0; j < MAX_STRESS_OPERATIONS; ++j)
+            result_.operations_[j] += workers[i]->GetOperations(j);
+        delete workers[i];
+    }
+    mixer.Stop();
+
+    if (result_.blocks_)
+        result_.meanBlockMSec_ = mixer.GetTotalUSec() / 1000.0f / result_.blocks_;
+
+    return true;
+}
+
+void AudioStressHarness::LogResult() const
+{
+    URHO3D_LOGINFO(ToString("Audio stress: %u threads, %.1f s, %u blocks, %u late, deadline %.3f ms, mean %.3f ms, max %.3f ms, "
+        "max lock wait %.3f ms", threads_, duration_, result_.blocks_, result_.lateBlocks_, result_.deadlineMSec_,
+        result_.meanBlockMSec_, result_.maxBlockMSec_, result_.maxLockWaitMSec_));
+
+    for (unsigned i = 0; i < MAX_STRESS_OPERATIONS; ++i)
+        URHO3D_LOGINFO(ToString("  %-15s %u", operationNames[i], result_.operations_[i]));
+
+    for (unsigned i = 0; i < result_.histogram_.Size(); ++i)
+    {
+        if (i + 1 < result_.histogram_.Size())
+            URHO3D_LOGINFO(ToString("  %3u-%3u%% %u", i * 10, (i + 1) * 10, result_.histogram_[i]));
+        else
+            URHO3D_LOGINFO(ToString("  >%u%%    %u", i * 10, result_.histogram_[i]));
+    }
+}
+
+}
@@ -0,0 +1,138 @@
+//
+// Copyright (c) 2008-2016 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../Core/Object.h"
+
+namespace Urho3D
+{
+
+/// Operation performed by an audio stress harness worker.
+enum AudioStressOperation
+{
+    STRESS_CREATE_SOURCE = 0,
+    STRESS_DESTROY_SOURCE,
+    STRESS_PLAY,
+    STRESS_STOP,
+    STRESS_SET_GAIN,
+    STRESS_IS_PLAYING,
+    STRESS_LOAD_SOUND,
+    STRESS_UNLOAD_SOUND,
+    MAX_STRESS_OPERATIONS
+};
+
+/// Result of an audio stress harness run.
+struct URHO3D_API AudioStressResult
+{
+    /// Construct with zero measurements.
+    AudioStressResult() :
+        blocks_(0),
+        lateBlocks_(0),
+        deadlineMSec_(0.0f),
+        meanBlockMSec_(0.0f),
+        maxBlockMSec_(0.0f),
+        maxLockWaitMSec_(0.0f)
+    {
+        for (unsigned i = 0; i < MAX_STRESS_OPERATIONS; ++i)
+            operations_[i] = 0;
+    }
+
+    /// Number of mixed blocks.
+    unsigned blocks_;
+    /// Number of blocks that took longer than their real-time deadline.
+    unsigned lateBlocks_;
+    /// Real-time deadline of one block in milliseconds.
+    float deadlineMSec_;
+    /// Mean block duration in milliseconds, including the wait for the audio mutex.
+    float meanBlockMSec_;
+    /// Longest block duration in milliseconds.
+    float maxBlockMSec_;
+    /// Longest wait for the audio mutex in milliseconds.
+    float maxLockWaitMSec_;
+    /// Block duration histogram. Bucket i counts blocks taking between i and i + 1 tenths of the deadline; the last bucket counts the rest.
+    PODVector<unsigned> histogram_;
+    /// Number of operations performed by the workers, by type.
+    unsigned operations_[MAX_STRESS_OPERATIONS];
+};
+
+/// Mixer deadline stress harness. Worker threads create and destroy sound sources, play, stop and change gain, load and unload sounds and query playback state, while a mixer thread pumps MixOutput in real time and records how long each block takes against its deadline. Requires an offline audio mode; sound source updates are main thread work and are not run. Runs are reproducible for a given seed and thread count up to thread scheduling.
+class URHO3D_API AudioStressHarness : public Object
+{
+    URHO3D_OBJECT(AudioStressHarness, Object);
+
+public:
+    /// Construct.
+    AudioStressHarness(Context* context);
+    /// Destruct.
+    virtual ~AudioStressHarness();
+
+    /// Set number of worker threads.
+    void SetThreads(unsigned threads);
+    /// Set run duration in seconds.
+    void SetDuration(float seconds);
+    /// Set maximum number of sound sources and sounds each worker keeps alive.
+    void SetMaxObjects(unsigned count);
+    /// Set random seed. Each worker derives its own sequence from it.
+    void SetSeed(unsigned seed);
+    /// Add a sound resource for the workers to load. Without any, workers generate short tones instead.
+    void AddSound(const String& name);
+    /// Run the harness, blocking until done. Return false if audio is not in offline mode.
+    bool Run();
+    /// Log the result of the last run.
+    void LogResult() const;
+
+    /// Return number of worker threads.
+    unsigned GetThreads() const { return threads_; }
+
+    /// Return run duration in seconds.
+    float GetDuration() const { return duration_; }
+
+    /// Return maximum number of objects per worker.
+    unsigned GetMaxObjects() const { return maxObjects_; }
+
+    /// Return random seed.
+    unsigned GetSeed() const { return seed_; }
+
+    /// Return sound resource names.
+    const Vector<String>& GetSounds() const { return sounds_; }
+
+    /// Return result of the last run.
+    const AudioStressResult& GetResult() const { return result_; }
+
+private:
+    /// Number of worker threads.
+    unsigned threads_;
+    /// Run duration in seconds.
+    float duration_;
+    /// Maximum number of objects per worker.
+    unsigned maxObjects_;
+    /// Random seed.
+    unsigned seed_;
+    /// Sound resource names.
+    Vector<String> sounds_;
+    /// Result of the last run.
+    AudioStressResult result_;
+};
+
+}
@@ -0,0 +1,201 @@
+//
+// Copyright (c) 2008-2016 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "../Precompiled.h"
+
+#include "../Audio/AudioTrace.h"
+#include "../Core/Thread.h"
+#include "../IO/Serializer.h"
+
+#include <SDL/SDL_atomic.h>
+#include <SDL/SDL_thread.h>
+#include <SDL/SDL_timer.h>
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+/// Events per thread ring. Must be a power of two.
+static const unsigned TRACE_RING_SIZE = 8192;
+/// Maximum number of traced threads.
+static const unsigned MAX_TRACE_THREADS = 16;
+
+static const char* traceEventNames[] =
+{
+    "Play",
+    "Stop",
+    "VoiceEnd",
+    "Steal",
+    "Virtualize",
+    "Mix",
+    "Mix",
+    "Load",
+    "Load",
+    "QualityTier",
+    0
+};
+
+static const char* traceEventPhases[] =
+{
+    "i",
+    "i",
+    "i",
+    "i",
+    "i",
+    "B",
+    "E",
+    "B",
+    "E",
+    "i",
+    0
+};
+
+/// Single producer event ring owned by one thread.
+struct AudioTraceRing
+{
+    /// Events.
+    AudioTraceEvent events_[TRACE_RING_SIZE];
+    /// Number of events written. Published after each write.
+    SDL_atomic_t head_;
+    /// Owning thread ID.
+    unsigned long threadID_;
+    /// Thread name for the trace viewer.
+    const char* name_;
+};
+
+static AudioTraceRing traceRings[MAX_TRACE_THREADS];
+static SDL_atomic_t numTraceRings;
+static SDL_TLSID traceRingTLS = 0;
+static SDL_SpinLock traceInitLock = 0;
+
+static AudioTraceRing* GetThreadRing()
+{
+    if (!traceRingTLS)
+    {
+        SDL_AtomicLock(&traceInitLock);
+        if (!traceRingTLS)
+            traceRingTLS = SDL_TLSCreate();
+        SDL_AtomicUnlock(&traceInitLock);
+    }
+
+    AudioTraceRing* ring = static_cast<AudioTraceRing*>(SDL_TLSGet(traceRingTLS));
+    if (!ring)
+    {
+        // Claim a ring on first use from this thread; when all are taken the thread is not traced
+        int index = SDL_AtomicAdd(&numTraceRings, 1);
+        if (index >= (int)MAX_TRACE_THREADS)
+            return 0;
+
+        ring = &traceRings[index];
+        ring->threadID_ = SDL_ThreadID();
+        ring->name_ = Thread::IsMainThread() ? "Game" : 0;
+        SDL_TLSSet(traceRingTLS, ring, 0);
+    }
+
+    return ring;
+}
+
+void AudioTrace::Write(AudioTraceEventType type, unsigned arg, float value)
+{
+    AudioTraceRing* ring = GetThreadRing();
+    if (!ring)
+        return;
+
+    int head = SDL_AtomicGet(&ring->head_);
+    AudioTraceEvent& event = ring->events_[head & (TRACE_RING_SIZE - 1)];
+    event.time_ = SDL_GetPerformanceCounter();
+    event.arg_ = arg;
+    event.value_ = value;
+    event.type_ = type;
+    SDL_AtomicSet(&ring->head_, head + 1);
+}
+
+void AudioTrace::SetThreadName(const char* name)
+{
+    AudioTraceRing* ring = GetThreadRing();
+    if (ring)
+        ring->name_ = name;
+}
+
+bool AudioTrace::SaveChromeTrace(Serializer& dest)
+{
+    unsigned numRings = Min((unsigned)SDL_AtomicGet(&numTraceRings), MAX_TRACE_THREADS);
+    double usecPerTick = 1000000.0 / (double)SDL_GetPerformanceFrequency();
+
+    // Timestamps are made relative to the oldest retained event
+    unsigned long long startTime = 0;
+    for (unsigned i = 0; i < numRings; ++i)
+    {
+        int head = SDL_AtomicGet(&traceRings[i].head_);
+        int first = Max(head - (int)TRACE_RING_SIZE, 0);
+        if (head > first)
+        {
+            unsigned long long time = traceRings[i].events_[first & (TRACE_RING_SIZE - 1)].time_;
+            if (!startTime || time < startTime)
+                startTime = time;
+        }
+    }
+
+    String json("{\"traceEvents\":[\n");
+    bool firstEvent = true;
+
+    for (unsigned i = 0; i < numRings; ++i)
+    {
+        const AudioTraceRing& ring = traceRings[i];
+        String threadName = ring.name_ ? String(ring.name_) : "Thread " + String((unsigned)ring.threadID_);
+
+        if (!firstEvent)
+            json += ",\n";
+        json += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" + String(i) + ",\"args\":{\"name\":\"" +
+            threadName + "\"}}";
+        firstEvent = false;
+
+        // Skip the oldest part of the ring, which the writer may be overwriting
+        int head = SDL_AtomicGet(&ring.head_);
+        int first = Max(head - (int)TRACE_RING_SIZE + 64, 0);
+        for (int j = first; j < head; ++j)
+        {
+            const AudioTraceEvent& event = ring.events_[j & (TRACE_RING_SIZE - 1)];
+            if (event.type_ >= MAX_AUDIO_TRACE_EVENT_TYPES || event.time_ < startTime)
+                continue;
+
+            double timestamp = (double)(event.time_ - startTime) * usecPerTick;
+            json += ",\n{\"name\":\"" + String(traceEventNames[event.type_]) + "\",\"cat\":\"audio\",\"ph\":\"" +
+                String(traceEventPhases[event.type_]) + "\",\"s\":\"t\",\"ts\":" + ToString("%.3f", timestamp) + ",\"pid\":0,\"tid\":" +
+                String(i) + ",\"args\":{\"arg\":" + String(event.arg_) + ",\"value\":" + String(event.value_) + "}}";
+        }
+    }
+
+    json += "\n]}\n";
+    return dest.Write(json.CString(), json.Length()) == json.Length();
+}
+
+void AudioTrace::Clear()
+{
+    unsigned numRings = Min((unsigned)SDL_AtomicGet(&numTraceRings), MAX_TRACE_THREADS);
+    for (unsigned i = 0; i < numRings; ++i)
+        SDL_AtomicSet(&traceRings[i].head_, 0);
+}
+
+}
@@ -0,0 +1,95 @@
+//
+// Copyright (c) 2008-2016 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../Container/Str.h"
+
+/// Audio trace level. 0 disables tracing, 1 records voice and load events, 2 also records mixer blocks.
+#ifndef URHO3D_AUDIO_TRACE_LEVEL
+#define URHO3D_AUDIO_TRACE_LEVEL 1
+#endif
+
+namespace Urho3D
+{
+
+class Serializer;
+
+/// Audio trace event type.
+enum AudioTraceEventType
+{
+    TRACE_PLAY = 0,
+    TRACE_STOP,
+    /// Voice ended on the mixer thread. The argument is the SoLoud play index rather than the full handle.
+    TRACE_VOICE_END,
+    TRACE_STEAL,
+    TRACE_VIRTUALIZE,
+    TRACE_MIX_BEGIN,
+    TRACE_MIX_END,
+    TRACE_LOAD_BEGIN,
+    TRACE_LOAD_END,
+    /// Mixer quality tier changed by the CPU budget governor. The argument is the new tier and the value the mix load.
+    TRACE_QUALITY_TIER,
+    MAX_AUDIO_TRACE_EVENT_TYPES
+};
+
+/// Fixed-size binary audio trace event.
+struct AudioTraceEvent
+{
+    /// High resolution timestamp in performance counter ticks.
+    unsigned long long time_;
+    /// Event argument, e.g. voice handle or resource name hash.
+    unsigned arg_;
+    /// Event value, e.g. gain or number of samples.
+    float value_;
+    /// Event type.
+    unsigned type_;
+};
+
+/// Low-overhead audio event tracing. Each thread writes to its own lock-free ring buffer; the rings can be saved as Chrome trace JSON.
+class URHO3D_API AudioTrace
+{
+public:
+    /// Record an event on the calling thread's ring buffer.
+    static void Write(AudioTraceEventType type, unsigned arg = 0, float value = 0.0f);
+    /// Name the calling thread in saved traces.
+    static void SetThreadName(const char* name);
+    /// Save all rings as Chrome trace event JSON. Events being written concurrently may be skipped. Return true if successful.
+    static bool SaveChromeTrace(Serializer& dest);
+    /// Discard recorded events.
+    static void Clear();
+};
+
+}
+
+#if URHO3D_AUDIO_TRACE_LEVEL >= 1
+#define URHO3D_AUDIO_TRACE(type, arg, value) Urho3D::AudioTrace::Write(type, arg, value)
+#else
+#define URHO3D_AUDIO_TRACE(type, arg, value)
+#endif
+
+#if URHO3D_AUDIO_TRACE_LEVEL >= 2
+#define URHO3D_AUDIO_TRACE_VERBOSE(type, arg, value) Urho3D::AudioTrace::Write(type, arg, value)
+#else
+#define URHO3D_AUDIO_TRACE_VERBOSE(type, arg, value)
+#endif
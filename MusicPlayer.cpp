@@ -0,0 +1,720 @@
+//
+// Copyright (c) 2008-2016 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "../Precompiled.h"
+
+#include "../Audio/Audio.h"
+#include "../Audio/AudioTrace.h"
+#include "../Audio/MusicPlayer.h"
+#include "../Audio/Sound.h"
+#include "../Core/Context.h"
+#include "../Core/Timer.h"
+#include "../Core/WorkQueue.h"
+#include "../IO/Log.h"
+#include "../Resource/ResourceCache.h"
+#include "../Resource/ResourceEvents.h"
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+static const float DEFAULT_PREFETCH_TIME = 2.0f;
+
+extern const char* AUDIO_CATEGORY;
+
+/// Track preparation job, shared between the main thread and a worker thread.
+struct MusicTrackJob
+{
+    /// Sound being prepared. Only referenced on the main thread.
+    SharedPtr<Sound> sound_;
+    /// Audio source of the sound.
+    SoLoud::AudioSource* source_;
+    /// Track being prepared.
+    MusicTrack* track_;
+    /// Length to pre-decode in seconds.
+    float prefetchTime_;
+    /// Looped playback flag.
+    bool looped_;
+    /// Work item.
+    SharedPtr<WorkItem> item_;
+};
+
+static void PrepareMusicTrackWork(const WorkItem* item, unsigned threadIndex)
+{
+    MusicTrackJob* job = static_cast<MusicTrackJob*>(item->aux_);
+    MusicTrack* track = job->track_;
+    SoLoud::AudioSource* source = job->source_;
+
+    URHO3D_AUDIO_TRACE(TRACE_LOAD_BEGIN, track->index_, job->prefetchTime_);
+
+    track->instance_ = source->createInstance();
+    track->instance_->init(*source, 0);
+    if (job->looped_)
+        track->instance_->mFlags |= SoLoud::AudioSourceInstance::LOOPING;
+
+    track->channels_ = Max((int)source->mChannels, 1);
+    track->frequency_ = source->mBaseSamplerate;
+    track->headSamples_ = (unsigned)(job->prefetchTime_ * track->frequency_);
+    if (track->headSamples_)
+    {
+        track->head_.Resize(track->headSamples_ * track->channels_);
+        memset(&track->head_[0], 0, track->head_.Size() * sizeof(float));
+        track->instance_->getAudio(&track->head_[0], track->headSamples_);
+    }
+    track->ended_ = track->instance_->hasEnded();
+
+    URHO3D_AUDIO_TRACE(TRACE_LOAD_END, track->index_, job->prefetchTime_);
+}
+
+MusicTrack::MusicTrack() :
+    instance_(0),
+    headSamples_(0),
+    headPosition_(0),
+    channels_(1),
+    length_(0),
+    position_(0),
+    frequency_(0.0f),
+    gain_(1.0f),
+    index_(0),
+    ended_(false)
+{
+}
+
+MusicTrack::~MusicTrack()
+{
+    delete instance_;
+}
+
+MusicStreamInstance::MusicStreamInstance(MusicStream* parent) :
+    parent_(parent),
+    current_(0),
+    next_(0),
+    fadeLength_(0),
+    fadePosition_(0),
+    fading_(false),
+    skip_(false)
+{
+}
+
+MusicStreamInstance::~MusicStreamInstance()
+{
+    delete current_;
+    delete next_;
+
+    if (parent_->instance_ == this)
+        parent_->instance_ = 0;
+}
+
+void MusicStreamInstance::getAudio(float* aBuffer, unsigned int aSamples)
+{
+    memset(aBuffer, 0, aSamples * mChannels * sizeof(float));
+
+    unsigned written = 0;
+
+    while (written < aSamples)
+    {
+        if (!current_)
+        {
+            if (!next_)
+                break;
+            SwitchTrack();
+        }
+
+        bool finished = current_->ended_ && current_->headPosition_ >= current_->headSamples_;
+        unsigned long long remaining = current_->length_ > current_->position_ ? current_->length_ - current_->position_ : 0;
+
+        // Start the switch when reaching the crossfade point, on a skip, or immediately if the next track arrived late
+        if (!fading_ && next_ && (skip_ || finished || (current_->length_ && remaining <= parent_->crossfadeSamples_)))
+        {
+            skip_ = false;
+            fadeLength_ = finished ? 0 : parent_->crossfadeSamples_;
+            if (current_->length_)
+                fadeLength_ = (unsigned)Min((unsigned long long)fadeLength_, remaining);
+
+            if (!fadeLength_)
+            {
+                SwitchTrack();
+                continue;
+            }
+
+            fading_ = true;
+            fadePosition_ = 0;
+        }
+
+        unsigned count = aSamples - written;
+
+        if (fading_)
+        {
+            count = Min(count, fadeLength_ - fadePosition_);
+
+            // Equal-power gains keep the summed loudness constant through the crossfade of uncorrelated tracks
+            fadeOutGains_.Resize(count);
+            fadeInGains_.Resize(count);
+            float angleStep = 0.5f * M_PI / fadeLength_;
+            for (unsigned i = 0; i < count; ++i)
+            {
+                float angle = (fadePosition_ + i) * angleStep;
+                fadeOutGains_[i] = cosf(angle);
+                fadeInGains_[i] = sinf(angle);
+            }
+
+            ReadTrack(current_, count);
+            MixScratch(current_, aBuffer + written, aSamples, count, &fadeOutGains_[0]);
+            ReadTrack(next_, count);
+            MixScratch(next_, aBuffer + written, aSamples, count, &fadeInGains_[0]);
+
+            fadePosition_ += count;
+            if (fadePosition_ >= fadeLength_)
+                SwitchTrack();
+        }
+        else
+        {
+            // Stop exactly at the crossfade point so that the switch lands on the right sample
+            if (next_ && current_->length_ && remaining > parent_->crossfadeSamples_)
+                count = (unsigned)Min((unsigned long long)count, remaining - parent_->crossfadeSamples_);
+
+            ReadTrack(current_, count);
+            MixScratch(current_, aBuffer + written, aSamples, count, 0);
+        }
+
+        written += count;
+    }
+}
+
+bool MusicStreamInstance::hasEnded()
+{
+    if (!parent_->endOfPlaylist_ || next_)
+        return false;
+
+    return !current_ || (current_->ended_ && current_->headPosition_ >= current_->headSamples_);
+}
+
+void MusicStreamInstance::SetNextTrack(MusicTrack* track)
+{
+    if (!current_)
+    {
+        current_ = track;
+        return;
+    }
+
+    if (fading_)
+    {
+        // The track fading in can not be replaced; finish the crossfade first
+        delete track;
+        return;
+    }
+
+    delete next_;
+    next_ = track;
+}
+
+void MusicStreamInstance::SkipTrack()
+{
+    skip_ = true;
+}
+
+void MusicStreamInstance::ReadTrack(MusicTrack* track, unsigned samples)
+{
+    scratch_.Resize(samples * track->channels_);
+    unsigned done = 0;
+
+    if (track->headPosition_ < track->headSamples_)
+    {
+        done = Min(samples, track->headSamples_ - track->headPosition_);
+        for (unsigned i = 0; i < track->channels_; ++i)
+            memcpy(&scratch_[i * samples], &track->head_[i * track->headSamples_ + track->headPosition_], done * sizeof(float));
+        track->headPosition_ += done;
+    }
+
+    if (done < samples && !track->ended_)
+    {
+        unsigned count = samples - done;
+        decodeBuffer_.Resize(count * track->channels_);
+        memset(&decodeBuffer_[0], 0, decodeBuffer_.Size() * sizeof(float));
+        track->instance_->getAudio(&decodeBuffer_[0], count);
+        for (unsigned i = 0; i < track->channels_; ++i)
+            memcpy(&scratch_[i * samples + done], &decodeBuffer_[i * count], count * sizeof(float));
+        track->ended_ = track->instance_->hasEnded();
+        done = samples;
+    }
+
+    if (done < samples)
+    {
+        for (unsigned i = 0; i < track->channels_; ++i)
+            memset(&scratch_[i * samples + done], 0, (samples - done) * sizeof(float));
+    }
+
+    track->position_ += samples;
+}
+
+void MusicStreamInstance::MixScratch(MusicTrack* track, float* dest, unsigned stride, unsigned samples, const float* gains)
+{
+    for (unsigned i = 0; i < mChannels; ++i)
+    {
+        // Mono tracks play on all channels
+        const float* src = &scratch_[Min(i, track->channels_ - 1) * samples];
+        float* out = dest + i * stride;
+        float gain = track->gain_;
+        if (gains)
+        {
+            for (unsigned j = 0; j < samples; ++j)
+                out[j] += src[j] * gains[j] * gain;
+        }
+        else
+        {
+            for (unsigned j = 0; j < samples; ++j)
+                out[j] += src[j] * gain;
+        }
+    }
+}
+
+void MusicStreamInstance::SwitchTrack()
+{
+    delete current_;
+    current_ = next_;
+    next_ = 0;
+    fading_ = false;
+    fadePosition_ = 0;
+}
+
+MusicStream::MusicStream() :
+    instance_(0),
+    crossfadeSamples_(0),
+    endOfPlaylist_(false)
+{
+    mChannels = 2;
+}
+
+MusicStream::~MusicStream()
+{
+    // Stop here, as the instance refers back to this source when deleted
+    stop();
+}
+
+SoLoud::AudioSourceInstance* MusicStream::createInstance()
+{
+    instance_ = new MusicStreamInstance(this);
+    return instance_;
+}
+
+MusicPlayer::MusicPlayer(Context* context) :
+    SoundSource(context),
+    crossfadeTime_(0.0f),
+    prefetchTime_(DEFAULT_PREFETCH_TIME),
+    sampleRate_(0.0f),
+    currentTrack_(M_MAX_UNSIGNED),
+    queuedTrack_(M_MAX_UNSIGNED),
+    pendingTrack_(M_MAX_UNSIGNED),
+    job_(0),
+    waitingTrack_(0),
+    loopPlaylist_(false),
+    playlistActive_(false)
+{
+    soundType_ = SOUND_MUSIC;
+    soundTypeHash_ = StringHash(SOUND_MUSIC);
+    UpdateMasterGain();
+
+    SubscribeToEvent(E_WORKITEMCOMPLETED, URHO3D_HANDLER(MusicPlayer, HandleWorkItemCompleted));
+}
+
+MusicPlayer::~MusicPlayer()
+{
+    CancelTrackJob();
+    delete waitingTrack_;
+}
+
+void MusicPlayer::RegisterObject(Context* context)
+{
+    context->RegisterFactory<MusicPlayer>(AUDIO_CATEGORY);
+
+    URHO3D_COPY_BASE_ATTRIBUTES(SoundSource);
+    // Playback is controlled through the playlist instead of a single sound
+    URHO3D_REMOVE_ATTRIBUTE("Sound");
+    URHO3D_REMOVE_ATTRIBUTE("Is Playing");
+    URHO3D_REMOVE_ATTRIBUTE("Play Position");
+    URHO3D_REMOVE_ATTRIBUTE("Play Event");
+    URHO3D_MIXED_ACCESSOR_ATTRIBUTE("Tracks", GetTracksAttr, SetTracksAttr, StringVector, Variant::emptyStringVector, AM_DEFAULT);
+    URHO3D_ACCESSOR_ATTRIBUTE("Crossfade Time", GetCrossfadeTime, SetCrossfadeTime, float, 0.0f, AM_DEFAULT);
+    URHO3D_ACCESSOR_ATTRIBUTE("Prefetch Time", GetPrefetchTime, SetPrefetchTime, float, DEFAULT_PREFETCH_TIME, AM_DEFAULT);
+    URHO3D_ACCESSOR_ATTRIBUTE("Loop Playlist", GetLoopPlaylist, SetLoopPlaylist, bool, false, AM_DEFAULT);
+    URHO3D_ACCESSOR_ATTRIBUTE("Is Playing", IsPlaying, SetPlaylistPlayingAttr, bool, false, AM_FILE);
+}
+
+void MusicPlayer::AddTrack(const String& name)
+{
+    tracks_.Push(name);
+
+    // A playlist that was about to end continues: keep the voice alive and let Update prepare the new track when it is due
+    if (playlistActive_ && audio_)
+    {
+        MutexLock lock(audio_->GetMutex());
+        stream_.SetEndOfPlaylist(false);
+    }
+}
+
+void MusicPlayer::RemoveAllTracks()
+{
+    StopPlaylist();
+    tracks_.Clear();
+}
+
+void MusicPlayer::PlayPlaylist(unsigned index)
+{
+    StopPlaylist();
+
+    if (!audio_ || audio_->IsHeadless() || index >= tracks_.Size())
+        return;
+
+    playlistActive_ = true;
+    // The voice starts once the first track has been prepared, taking its sample rate
+    PrepareTrack(index);
+}
+
+void MusicPlayer::NextTrack()
+{
+    if (!playlistActive_ || !audio_)
+        return;
+
+    if (GetNextIndex(currentTrack_) == M_MAX_UNSIGNED)
+    {
+        FadeOutAndStop(crossfadeTime_);
+        playlistActive_ = false;
+        return;
+    }
+
+    MutexLock lock(audio_->GetMutex());
+    MusicStreamInstance* instance = stream_.GetInstance();
+    if (instance)
+        instance->SkipTrack();
+}
+
+void MusicPlayer::StopPlaylist()
+{
+    CancelTrackJob();
+    UnsubscribeFromEvent(E_RESOURCEBACKGROUNDLOADED);
+    delete waitingTrack_;
+    waitingTrack_ = 0;
+
+    if (audio_ && IsPlaying())
+        Stop();
+
+    playlistActive_ = false;
+    currentTrack_ = M_MAX_UNSIGNED;
+    queuedTrack_ = M_MAX_UNSIGNED;
+    pendingTrack_ = M_MAX_UNSIGNED;
+}
+
+void MusicPlayer::SetCrossfadeTime(float time)
+{
+    crossfadeTime_ = Max(time, 0.0f);
+
+    if (audio_ && sampleRate_ > 0.0f)
+    {
+        MutexLock lock(audio_->GetMutex());
+        stream_.SetCrossfadeSamples((unsigned)(crossfadeTime_ * sampleRate_));
+    }
+}
+
+void MusicPlayer::SetPrefetchTime(float time)
+{
+    prefetchTime_ = Max(time, 0.0f);
+}
+
+void MusicPlayer::SetLoopPlaylist(bool enable)
+{
+    loopPlaylist_ = enable;
+}
+
+void MusicPlayer::Update(float timeStep)
+{
+    // Make a weak pointer to self to check for destruction during the finished event
+    WeakPtr<MusicPlayer> self(this);
+    SoundSource::Update(timeStep);
+    if (self.Expired() || !audio_ || !playlistActive_)
+        return;
+
+    bool playing = IsPlaying();
+    if (!playing && currentTrack_ != M_MAX_UNSIGNED)
+    {
+        // The voice ended after the last track
+        playlistActive_ = false;
+        currentTrack_ = M_MAX_UNSIGNED;
+        queuedTrack_ = M_MAX_UNSIGNED;
+        return;
+    }
+
+    if (!playing || pendingTrack_ != M_MAX_UNSIGNED)
+        return;
+
+    bool needNext;
+    {
+        MutexLock lock(audio_->GetMutex());
+        MusicStreamInstance* instance = stream_.GetInstance();
+        if (!instance)
+            return;
+        currentTrack_ = instance->GetCurrentIndex();
+        // Prepare the following track as soon as the queued one has become current
+        needNext = !instance->HasNextTrack() && currentTrack_ == queuedTrack_;
+    }
+
+    if (needNext)
+    {
+        unsigned next = GetNextIndex(queuedTrack_);
+        if (next != M_MAX_UNSIGNED)
+            PrepareTrack(next);
+    }
+}
+
+void MusicPlayer::SetTracksAttr(const StringVector& value)
+{
+    StopPlaylist();
+    tracks_ = value;
+}
+
+StringVector MusicPlayer::GetTracksAttr() const
+{
+    return tracks_;
+}
+
+void MusicPlayer::SetPlaylistPlayingAttr(bool value)
+{
+    if (value)
+    {
+        if (!playlistActive_)
+            PlayPlaylist();
+    }
+    else
+        StopPlaylist();
+}
+
+void MusicPlayer::PrepareTrack(unsigned index)
+{
+    pendingTrack_ = index;
+
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    Sound* sound = cache->GetExistingResource<Sound>(tracks_[index]);
+    if (sound)
+    {
+        QueueTrackJob(sound);
+        return;
+    }
+
+    // Load in the background so that the main thread does not stall on large files
+    if (cache->BackgroundLoadResource<Sound>(tracks_[index]))
+        SubscribeToEvent(E_RESOURCEBACKGROUNDLOADED, URHO3D_HANDLER(MusicPlayer, HandleResourceBackgroundLoaded));
+    else
+        QueueTrackJob(cache->GetResource<Sound>(tracks_[index]));
+}
+
+void MusicPlayer::QueueTrackJob(Sound* sound)
+{
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+
+    if (!sound || !sound->PrepareData() || !queue)
+    {
+        URHO3D_LOGERROR("Could not prepare music track " + tracks_[pendingTrack_]);
+
+        // Skip the track while playing; a playlist that can not start its first track stops
+        unsigned failed = pendingTrack_;
+        pendingTrack_ = M_MAX_UNSIGNED;
+        if (currentTrack_ == M_MAX_UNSIGNED)
+        {
+            playlistActive_ = false;
+            return;
+        }
+
+        queuedTrack_ = failed;
+        unsigned next = GetNextIndex(failed);
+        if (next != M_MAX_UNSIGNED && next != currentTrack_)
+            PrepareTrack(next);
+        else if (audio_)
+        {
+            MutexLock lock(audio_->GetMutex());
+            stream_.SetEndOfPlaylist(true);
+        }
+        return;
+    }
+
+    MusicTrack* track = new MusicTrack();
+    track->index_ = pendingTrack_;
+    track->length_ = sound->IsLooped() ? 0 : sound->GetSampleCount();
+    track->gain_ = sound->GetLoudnessGain();
+
+    job_ = new MusicTrackJob();
+    job_->sound_ = sound;
+    job_->source_ = sound->GetAudioSource();
+    job_->track_ = track;
+    job_->prefetchTime_ = prefetchTime_;
+    job_->looped_ = sound->IsLooped();
+
+    job_->item_ = queue->GetFreeItem();
+    job_->item_->workFunction_ = PrepareMusicTrackWork;
+    job_->item_->aux_ = job_;
+    job_->item_->priority_ = 0;
+    job_->item_->sendEvent_ = true;
+    queue->AddWorkItem(job_->item_);
+}
+
+void MusicPlayer::FinishTrackJob()
+{
+    MusicTrack* track = job_->track_;
+    delete job_;
+    job_ = 0;
+
+    pendingTrack_ = M_MAX_UNSIGNED;
+
+    if (!playlistActive_ || !audio_)
+    {
+        delete track;
+        return;
+    }
+
+    // Like plays of other sound sources, the voice waits until the device is ready
+    if (audio_->IsInitializing())
+    {
+        delete waitingTrack_;
+        waitingTrack_ = track;
+        return;
+    }
+
+    HandOverTrack(track);
+}
+
+void MusicPlayer::FinishQueuedPlayback(bool start)
+{
+    SoundSource::FinishQueuedPlayback(start);
+
+    if (!waitingTrack_)
+        return;
+
+    MusicTrack* track = waitingTrack_;
+    waitingTrack_ = 0;
+    if (start && playlistActive_ && audio_)
+        HandOverTrack(track);
+    else
+    {
+        delete track;
+        playlistActive_ = false;
+    }
+}
+
+void MusicPlayer::HandOverTrack(MusicTrack* track)
+{
+    unsigned index = track->index_;
+
+    MutexLock lock(audio_->GetMutex());
+    SoLoud::Soloud* soloud = audio_->GetSoLoud();
+    MusicStreamInstance* instance = stream_.GetInstance();
+
+    if (!instance)
+    {
+        // First track: start the voice at its sample rate
+        sampleRate_ = track->frequency_;
+        stream_.mBaseSamplerate = sampleRate_;
+        stream_.SetCrossfadeSamples((unsigned)(crossfadeTime_ * sampleRate_));
+        stream_.SetEndOfPlaylist(false);
+        handle_ = soloud->play(stream_, gain_, panning_);
+        voiceGain_ = gain_;
+        voicePanning_ = panning_;
+        if (pitch_ != 1.0f)
+            FadeVoicePitch(pitch_, 0.0f);
+        // Keep music audible when the CPU budget governor lowers the voice limit
+        soloud->setProtectVoice(handle_, true);
+        sendFinishedEvent_ = true;
+        URHO3D_AUDIO_TRACE(TRACE_PLAY, handle_, gain_);
+
+        instance = stream_.GetInstance();
+        if (!instance)
+        {
+            delete track;
+            playlistActive_ = false;
+            return;
+        }
+        currentTrack_ = index;
+        instance->SetNextTrack(track);
+    }
+    else if (track->frequency_ != sampleRate_)
+    {
+        // Tracks are mixed into one voice, so they must share its sample rate
+        URHO3D_LOGWARNING("Skipping music track " + tracks_[index] + " with sample rate " + String(track->frequency_) +
+            ", playlist plays at " + String(sampleRate_));
+        delete track;
+    }
+    else
+        instance->SetNextTrack(track);
+
+    queuedTrack_ = index;
+    stream_.SetEndOfPlaylist(GetNextIndex(index) == M_MAX_UNSIGNED);
+}
+
+void MusicPlayer::CancelTrackJob()
+{
+    if (!job_)
+        return;
+
+    // A job already running must finish before it can be freed
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    if (!queue || !queue->RemoveWorkItem(job_->item_))
+    {
+        while (!job_->item_->completed_)
+            Time::Sleep(1);
+    }
+
+    delete job_->track_;
+    delete job_;
+    job_ = 0;
+    pendingTrack_ = M_MAX_UNSIGNED;
+}
+
+unsigned MusicPlayer::GetNextIndex(unsigned index) const
+{
+    if (index + 1 < tracks_.Size())
+        return index + 1;
+
+    return loopPlaylist_ && !tracks_.Empty() ? 0 : M_MAX_UNSIGNED;
+}
+
+void MusicPlayer::HandleResourceBackgroundLoaded(StringHash eventType, VariantMap& eventData)
+{
+    using namespace ResourceBackgroundLoaded;
+
+    if (pendingTrack_ == M_MAX_UNSIGNED || eventData[P_RESOURCENAME].GetString() != tracks_[pendingTrack_])
+        return;
+
+    UnsubscribeFromEvent(E_RESOURCEBACKGROUNDLOADED);
+    QueueTrackJob(eventData[P_SUCCESS].GetBool() ? static_cast<Sound*>(eventData[P_RESOURCE].GetPtr()) : 0);
+}
+
+void MusicPlayer::HandleWorkItemCompleted(StringHash eventType, VariantMap& eventData)
+{
+    using namespace WorkItemCompleted;
+
+    WorkItem* item = static_cast<WorkItem*>(eventData[P_ITEM].GetPtr());
+    if (!job_ || item != job_->item_)
+        return;
+
+    FinishTrackJob();
+}
+
+}
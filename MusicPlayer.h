@@ -0,0 +1,257 @@
+//
+// Copyright (c) 2008-2016 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../Audio/SoundSource.h"
+
+namespace Urho3D
+{
+
+class MusicStream;
+struct MusicTrackJob;
+
+/// Playlist track prepared for playback: a source instance without a voice, with its first seconds already decoded. Owned by the music stream instance once handed over.
+struct MusicTrack
+{
+    /// Construct.
+    MusicTrack();
+    /// Destruct. Delete the source instance.
+    ~MusicTrack();
+
+    /// Source instance continuing after the pre-decoded samples.
+    SoLoud::AudioSourceInstance* instance_;
+    /// Pre-decoded samples, non-interleaved.
+    PODVector<float> head_;
+    /// Number of pre-decoded samples per channel.
+    unsigned headSamples_;
+    /// Read position in the pre-decoded samples.
+    unsigned headPosition_;
+    /// Number of channels.
+    unsigned channels_;
+    /// Length in samples, zero for looped tracks that only end when skipped.
+    unsigned long long length_;
+    /// Read position in samples.
+    unsigned long long position_;
+    /// Sample rate.
+    float frequency_;
+    /// Loudness normalization gain of the sound.
+    float gain_;
+    /// Playlist index.
+    unsigned index_;
+    /// End of data flag.
+    bool ended_;
+};
+
+/// Playing instance of a music stream. Plays the current playlist track and switches to the next one on an exact sample, either gaplessly or with a crossfade.
+class MusicStreamInstance : public SoLoud::AudioSourceInstance
+{
+public:
+    /// Construct.
+    MusicStreamInstance(MusicStream* parent);
+    /// Destruct. Delete the tracks.
+    virtual ~MusicStreamInstance();
+
+    /// Mix the tracks into a non-interleaved buffer.
+    virtual void getAudio(float* aBuffer, unsigned int aSamples);
+    /// Return whether the playlist has ended.
+    virtual bool hasEnded();
+
+    /// Hand over the next track, replacing a waiting one. Called with the audio mutex held.
+    void SetNextTrack(MusicTrack* track);
+    /// Switch to the next track now, or as soon as it is ready. Without a next track at the end of the playlist, fade out. Called with the audio mutex held.
+    void SkipTrack();
+
+    /// Return playlist index of the current track, or M_MAX_UNSIGNED if none. Called with the audio mutex held.
+    unsigned GetCurrentIndex() const { return current_ ? current_->index_ : M_MAX_UNSIGNED; }
+
+    /// Return whether a next track is waiting. Called with the audio mutex held.
+    bool HasNextTrack() const { return next_ != 0; }
+
+private:
+    /// Read samples of a track into the scratch buffer, padding with silence after its end.
+    void ReadTrack(MusicTrack* track, unsigned samples);
+    /// Add the scratch buffer of a track to the output at the track's gain, multiplied by per-sample gains if not null.
+    void MixScratch(MusicTrack* track, float* dest, unsigned stride, unsigned samples, const float* gains);
+    /// Make the next track current.
+    void SwitchTrack();
+
+    /// Parent source.
+    MusicStream* parent_;
+    /// Current track.
+    MusicTrack* current_;
+    /// Next track.
+    MusicTrack* next_;
+    /// Track samples being mixed.
+    PODVector<float> scratch_;
+    /// Samples decoded by a track instance.
+    PODVector<float> decodeBuffer_;
+    /// Crossfade gains of the track fading out.
+    PODVector<float> fadeOutGains_;
+    /// Crossfade gains of the track fading in.
+    PODVector<float> fadeInGains_;
+    /// Crossfade length in samples.
+    unsigned fadeLength_;
+    /// Crossfade position in samples.
+    unsigned fadePosition_;
+    /// Crossfade in progress flag.
+    bool fading_;
+    /// Skip requested flag.
+    bool skip_;
+};
+
+/// Audio source for the voice of a music player.
+class URHO3D_API MusicStream : public SoLoud::AudioSource
+{
+    friend class MusicStreamInstance;
+
+public:
+    /// Construct.
+    MusicStream();
+    /// Destruct. Stop the voice.
+    virtual ~MusicStream();
+
+    /// Create the playing instance.
+    virtual SoLoud::AudioSourceInstance* createInstance();
+    /// Set crossfade length in samples. Zero switches gaplessly. Called with the audio mutex held.
+    void SetCrossfadeSamples(unsigned samples) { crossfadeSamples_ = samples; }
+    /// Set whether no more tracks will follow, so that the voice ends after the current one. Called with the audio mutex held.
+    void SetEndOfPlaylist(bool enable) { endOfPlaylist_ = enable; }
+
+    /// Return the playing instance, or null. Called with the audio mutex held.
+    MusicStreamInstance* GetInstance() const { return instance_; }
+
+private:
+    /// Playing instance.
+    MusicStreamInstance* instance_;
+    /// Crossfade length in samples.
+    unsigned crossfadeSamples_;
+    /// End of playlist flag.
+    bool endOfPlaylist_;
+};
+
+/// %Music player component. Plays a playlist of tracks through one voice, preparing each next track on a worker thread ahead of time and switching gaplessly or with a sample-accurate crossfade.
+class URHO3D_API MusicPlayer : public SoundSource
+{
+    URHO3D_OBJECT(MusicPlayer, SoundSource);
+
+public:
+    /// Construct.
+    MusicPlayer(Context* context);
+    /// Destruct.
+    virtual ~MusicPlayer();
+    /// Register object factory.
+    static void RegisterObject(Context* context);
+
+    /// Add a track to the end of the playlist by sound resource name.
+    void AddTrack(const String& name);
+    /// Remove all tracks and stop playback.
+    void RemoveAllTracks();
+    /// Start playing the playlist from a track.
+    void PlayPlaylist(unsigned index = 0);
+    /// Switch to the next track, crossfading if a crossfade time is set.
+    void NextTrack();
+    /// Stop playing the playlist.
+    void StopPlaylist();
+    /// Set crossfade time in seconds between tracks. Zero switches gaplessly.
+    void SetCrossfadeTime(float time);
+    /// Set length in seconds decoded on a worker thread at the start of each track before it plays.
+    void SetPrefetchTime(float time);
+    /// Set whether the playlist restarts after the last track.
+    void SetLoopPlaylist(bool enable);
+
+    /// Return playlist track names.
+    const Vector<String>& GetTracks() const { return tracks_; }
+
+    /// Return number of tracks.
+    unsigned GetNumTracks() const { return tracks_.Size(); }
+
+    /// Return playlist index of the track being played.
+    unsigned GetCurrentTrack() const { return currentTrack_; }
+
+    /// Return crossfade time in seconds.
+    float GetCrossfadeTime() const { return crossfadeTime_; }
+
+    /// Return pre-decoded length in seconds.
+    float GetPrefetchTime() const { return prefetchTime_; }
+
+    /// Return whether the playlist restarts after the last track.
+    bool GetLoopPlaylist() const { return loopPlaylist_; }
+
+    /// Update the playlist. Called by Audio.
+    virtual void Update(float timeStep);
+    /// Start the first track if it was prepared while the audio device was opening, or drop it. Called by Audio.
+    virtual void FinishQueuedPlayback(bool start);
+
+    /// Set tracks attribute.
+    void SetTracksAttr(const StringVector& value);
+    /// Return tracks attribute.
+    StringVector GetTracksAttr() const;
+    /// Set playlist playing attribute.
+    void SetPlaylistPlayingAttr(bool value);
+
+private:
+    /// Load a track in the background and prepare it for playback.
+    void PrepareTrack(unsigned index);
+    /// Queue pre-decoding of a loaded track on a worker thread.
+    void QueueTrackJob(Sound* sound);
+    /// Finish the track job and hand its track over, or keep it waiting while the audio device is opening.
+    void FinishTrackJob();
+    /// Hand a prepared track over to the music stream, starting the voice with the first track.
+    void HandOverTrack(MusicTrack* track);
+    /// Cancel or wait for the track job.
+    void CancelTrackJob();
+    /// Return playlist index following a track, or M_MAX_UNSIGNED at the end.
+    unsigned GetNextIndex(unsigned index) const;
+    /// Handle background loaded resource event for the track being prepared.
+    void HandleResourceBackgroundLoaded(StringHash eventType, VariantMap& eventData);
+    /// Handle work item completed event for the track job.
+    void HandleWorkItemCompleted(StringHash eventType, VariantMap& eventData);
+
+    /// Music stream for the voice.
+    MusicStream stream_;
+    /// Playlist track names.
+    Vector<String> tracks_;
+    /// Crossfade time.
+    float crossfadeTime_;
+    /// Pre-decoded length.
+    float prefetchTime_;
+    /// Sample rate of the stream, set by the first track.
+    float sampleRate_;
+    /// Playlist index of the track being played.
+    unsigned currentTrack_;
+    /// Playlist index of the track last handed to the stream.
+    unsigned queuedTrack_;
+    /// Playlist index of the track being prepared, or M_MAX_UNSIGNED if none.
+    unsigned pendingTrack_;
+    /// Track job in progress.
+    MusicTrackJob* job_;
+    /// First track prepared while the audio device was opening, started once it is ready.
+    MusicTrack* waitingTrack_;
+    /// Playlist loop flag.
+    bool loopPlaylist_;
+    /// Playlist active flag.
+    bool playlistActive_;
+};
+
+}
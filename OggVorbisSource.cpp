@@ -0,0 +1,581 @@
+//
+// Copyright (c) 2008-2016 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "../Precompiled.h"
+
+#include "../Audio/AudioTrace.h"
+#include "../Audio/OggVorbisSource.h"
+#include "../Audio/SampleBuffer.h"
+#include "../Container/Vector.h"
+#include "../IO/Deserializer.h"
+#include "../IO/Log.h"
+#include "../IO/MemoryBuffer.h"
+#include "../Math/MathDefs.h"
+
+#include <STB/stb_vorbis.h>
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+/// Stream read buffer size. Must hold at least one maximum size Ogg page plus headers.
+static const unsigned STREAM_BUFFER_SIZE = 128 * 1024;
+/// Refill the stream buffer when fewer bytes than one maximum size Ogg page remain.
+static const unsigned STREAM_REFILL_THRESHOLD = 65307;
+/// Ogg page header size without the segment table.
+static const unsigned OGG_PAGE_HEADER_SIZE = 27;
+/// Vorbis identification header size.
+static const unsigned VORBIS_ID_HEADER_SIZE = 16;
+/// Samples per channel decoded at a time by DecodeRange.
+static const unsigned DECODE_BLOCK_SIZE = 1024;
+
+OggVorbisSourceInstance::OggVorbisSourceInstance(OggVorbisSource* parent) :
+    data_(parent->data_),
+    seekTable_(parent->seekTable_),
+    sampleRate_(parent->mBaseSamplerate),
+    vorbis_(0),
+    file_(0),
+    bufferOffset_(0),
+    bufferSize_(0),
+    readOffset_(0),
+    frameOutput_(0),
+    frameChannels_(0),
+    frameSamples_(0),
+    framePosition_(0),
+    discard_(0),
+    seekTarget_(0),
+    position_(0),
+    loopStart_(parent->loopStart_),
+    loopEnd_(parent->loopEnd_),
+    ended_(false),
+    seeking_(false)
+{
+    if (data_)
+        data_->AddRef();
+    if (seekTable_)
+        seekTable_->AddRef();
+
+    if (!data_ && !parent->fileName_.Empty())
+    {
+        file_ = fopen(parent->fileName_.CString(), "rb");
+        if (!file_)
+        {
+            ended_ = true;
+            return;
+        }
+        streamBuffer_ = new unsigned char[STREAM_BUFFER_SIZE];
+    }
+
+    Restart();
+}
+
+OggVorbisSourceInstance::~OggVorbisSourceInstance()
+{
+    URHO3D_AUDIO_TRACE(TRACE_VOICE_END, mPlayIndex, 0.0f);
+    if (vorbis_)
+        stb_vorbis_close(vorbis_);
+    if (file_)
+        fclose(file_);
+
+    // The last voice of a destroyed source frees the data here, on the mixer thread
+    if (data_)
+        data_->ReleaseRef();
+    if (seekTable_)
+        seekTable_->ReleaseRef();
+}
+
+void OggVorbisSourceInstance::getAudio(float* aBuffer, unsigned int aSamples)
+{
+    unsigned written = 0;
+    bool restarted = false;
+
+    bool looping = (mFlags & AudioSourceInstance::LOOPING) != 0;
+
+    while (written < aSamples)
+    {
+        // Jump back at the loop end point, unless the loop yields nothing even after jumping
+        if (looping && loopEnd_ && position_ >= loopEnd_)
+        {
+            if (restarted || !SeekSample(loopStart_))
+                break;
+            restarted = true;
+            ++mLoopCount;
+            continue;
+        }
+
+        if (framePosition_ >= frameSamples_)
+        {
+            if (!ended_ && DecodeFrame())
+                continue;
+
+            if (!looping || restarted || !SeekSample(loopStart_))
+                break;
+            restarted = true;
+            ++mLoopCount;
+            continue;
+        }
+
+        unsigned count = Min(aSamples - written, frameSamples_ - framePosition_);
+        if (looping && loopEnd_)
+            count = (unsigned)Min((unsigned long long)count, loopEnd_ - position_);
+        for (unsigned i = 0; i < mChannels; ++i)
+        {
+            const float* src = frameOutput_[Min((int)i, frameChannels_ - 1)] + framePosition_;
+            memcpy(aBuffer + i * aSamples + written, src, count * sizeof(float));
+        }
+        written += count;
+        framePosition_ += count;
+        position_ += count;
+        restarted = false;
+    }
+
+    // Pad with silence after the end of data
+    if (written < aSamples)
+    {
+        for (unsigned i = 0; i < mChannels; ++i)
+            memset(aBuffer + i * aSamples + written, 0, (aSamples - written) * sizeof(float));
+    }
+}
+
+bool OggVorbisSourceInstance::hasEnded()
+{
+    return !(mFlags & AudioSourceInstance::LOOPING) && ended_ && framePosition_ >= frameSamples_;
+}
+
+SoLoud::result OggVorbisSourceInstance::rewind()
+{
+    return Restart() ? SoLoud::SO_NO_ERROR : SoLoud::UNKNOWN_ERROR;
+}
+
+SoLoud::result OggVorbisSourceInstance::seek(double aSeconds, float* mScratch, unsigned int mScratchSize)
+{
+    if (!SeekSample((unsigned long long)(Max(aSeconds, 0.0) * sampleRate_)))
+        return SoLoud::UNKNOWN_ERROR;
+
+    mStreamTime = aSeconds;
+    return SoLoud::SO_NO_ERROR;
+}
+
+bool OggVorbisSourceInstance::SeekSample(unsigned long long target)
+{
+    // Start one page before the page holding the target. The decoder discards a packet continued from an earlier
+    // page and primes on the next one, so samples only come out some way into the data
+    const OggSeekPoint* point = OggVorbisSource::FindSeekPoint(seekTable_, target);
+    if (point && point != reinterpret_cast<const OggSeekPoint*>(seekTable_->GetData()))
+        --point;
+    else
+        point = 0;
+
+    if (!point || !vorbis_)
+    {
+        // Near the beginning decode from the start, which also restores the exact sample position
+        if (!Restart())
+            return false;
+        discard_ = target;
+    }
+    else
+    {
+        // Jump to the page and resynchronize. How many samples to discard is only known once the decoder reports
+        // the position of the first frame it outputs, which it derives from page granule positions
+        stb_vorbis_flush_pushdata(vorbis_);
+        SetReadOffset(point->offset_);
+        frameSamples_ = 0;
+        framePosition_ = 0;
+        ended_ = false;
+        discard_ = 0;
+        seekTarget_ = target;
+        seeking_ = true;
+    }
+
+    position_ = target;
+    return true;
+}
+
+bool OggVorbisSourceInstance::Restart()
+{
+    if (vorbis_)
+    {
+        stb_vorbis_close(vorbis_);
+        vorbis_ = 0;
+    }
+
+    frameSamples_ = 0;
+    framePosition_ = 0;
+    discard_ = 0;
+    position_ = 0;
+    ended_ = true;
+    seeking_ = false;
+
+    if (!data_ && !file_)
+        return false;
+
+    SetReadOffset(0);
+    unsigned available;
+    const unsigned char* data = GetData(available);
+    int used = 0;
+    int error = 0;
+    vorbis_ = stb_vorbis_open_pushdata(data, (int)available, &used, &error, 0);
+    if (!vorbis_)
+        return false;
+
+    readOffset_ += used;
+    ended_ = false;
+    return true;
+}
+
+bool OggVorbisSourceInstance::DecodeFrame()
+{
+    if (!vorbis_)
+    {
+        ended_ = true;
+        return false;
+    }
+
+    for (;;)
+    {
+        unsigned available;
+        const unsigned char* data = GetData(available);
+        int channels = 0;
+        float** output = 0;
+        int samples = 0;
+        int used = available ? stb_vorbis_decode_frame_pushdata(vorbis_, data, (int)available, &channels, &output, &samples) : 0;
+
+        // Buffer holds at least one full page, so no progress means end of data
+        if (!used)
+        {
+            ended_ = true;
+            return false;
+        }
+
+        readOffset_ += used;
+        if (samples <= 0)
+            continue;
+
+        frameOutput_ = output;
+        frameChannels_ = channels;
+        frameSamples_ = (unsigned)samples;
+        framePosition_ = 0;
+
+        if (seeking_)
+        {
+            // The decoder reports the position of the sample after this frame once a page granule has been seen
+            int next = stb_vorbis_get_sample_offset(vorbis_);
+            if (next < 0)
+                continue;
+
+            seeking_ = false;
+            unsigned long long first = (unsigned long long)Max(next - samples, 0);
+            if (first > seekTarget_)
+            {
+                // Resynchronized past the target; decode from the start instead, keeping the output position
+                unsigned long long position = position_;
+                if (!Restart())
+                {
+                    ended_ = true;
+                    return false;
+                }
+                position_ = position;
+                discard_ = seekTarget_;
+                continue;
+            }
+            discard_ = seekTarget_ - first;
+        }
+
+        // Skip over decoded samples that precede a seek target
+        if (discard_)
+        {
+            unsigned skip = (unsigned)Min(discard_, (unsigned long long)frameSamples_);
+            framePosition_ = skip;
+            discard_ -= skip;
+            if (framePosition_ >= frameSamples_)
+                continue;
+        }
+
+        return true;
+    }
+}
+
+const unsigned char* OggVorbisSourceInstance::GetData(unsigned& available)
+{
+    if (!file_)
+    {
+        available = readOffset_ < data_->GetSize() ? data_->GetSize() - readOffset_ : 0;
+        return data_->GetData() + readOffset_;
+    }
+
+    unsigned char* buffer = streamBuffer_.Get();
+    unsigned bufferPosition = readOffset_ - bufferOffset_;
+
+    if (bufferSize_ - bufferPosition < STREAM_REFILL_THRESHOLD)
+    {
+        unsigned remaining = bufferSize_ - bufferPosition;
+        memmove(buffer, buffer + bufferPosition, remaining);
+        bufferOffset_ = readOffset_;
+        bufferSize_ = remaining + (unsigned)fread(buffer + remaining, 1, STREAM_BUFFER_SIZE - remaining, file_);
+        bufferPosition = 0;
+    }
+
+    available = bufferSize_ - bufferPosition;
+    return buffer + bufferPosition;
+}
+
+void OggVorbisSourceInstance::SetReadOffset(unsigned offset)
+{
+    readOffset_ = offset;
+
+    // Keep buffered data if the offset falls inside it, otherwise seek the file
+    if (file_ && (offset < bufferOffset_ || offset > bufferOffset_ + bufferSize_))
+    {
+        fseek(file_, (long)offset, SEEK_SET);
+        bufferOffset_ = offset;
+        bufferSize_ = 0;
+    }
+}
+
+OggVorbisSource::OggVorbisSource() :
+    data_(0),
+    seekTable_(0),
+    totalSamples_(0),
+    loopStart_(0),
+    loopEnd_(0)
+{
+}
+
+OggVorbisSource::~OggVorbisSource()
+{
+    // Detach from the engine so that the base class does not stop the voices; they keep their own data references
+    mSoloud = 0;
+    Release();
+}
+
+bool OggVorbisSource::LoadMemory(SampleBuffer* data)
+{
+    Release();
+
+    MemoryBuffer buffer(data->GetData(), data->GetSize());
+    if (!BuildSeekTable(buffer))
+    {
+        data->ReleaseRef();
+        return false;
+    }
+
+    data_ = data;
+    return true;
+}
+
+bool OggVorbisSource::LoadFile(const String& fileName, Deserializer& source)
+{
+    Release();
+
+    if (!BuildSeekTable(source))
+        return false;
+
+    fileName_ = fileName;
+    return true;
+}
+
+void OggVorbisSource::SetLoopPoints(unsigned long long start, unsigned long long end)
+{
+    loopStart_ = start;
+    loopEnd_ = end;
+}
+
+bool OggVorbisSource::ReadInfo(Deserializer& source)
+{
+    Release();
+
+    if (!BuildSeekTable(source))
+        return false;
+
+    if (seekTable_)
+    {
+        seekTable_->ReleaseRef();
+        seekTable_ = 0;
+    }
+    return true;
+}
+
+SoLoud::AudioSourceInstance* OggVorbisSource::createInstance()
+{
+    return new OggVorbisSourceInstance(this);
+}
+
+unsigned OggVorbisSource::DecodeRange(unsigned long long start, unsigned count, float* dest, unsigned long long stride)
+{
+    OggVorbisSourceInstance instance(this);
+    instance.init(*this, 0);
+    if (!instance.SeekSample(start))
+        return 0;
+
+    float block[DECODE_BLOCK_SIZE * MAX_CHANNELS];
+    unsigned decoded = 0;
+
+    while (decoded < count && !instance.hasEnded())
+    {
+        unsigned samples = Min(count - decoded, DECODE_BLOCK_SIZE);
+        memset(block, 0, samples * mChannels * sizeof(float));
+        instance.getAudio(block, samples);
+        for (unsigned i = 0; i < mChannels; ++i)
+            memcpy(dest + i * stride + decoded, block + i * samples, samples * sizeof(float));
+        decoded += samples;
+    }
+
+    // The final block may be padded past the end of data
+    unsigned long long available = totalSamples_ > start ? totalSamples_ - start : 0;
+    return (unsigned)Min((unsigned long long)decoded, available);
+}
+
+unsigned long long OggVorbisSource::GetPageStart(unsigned long long sample) const
+{
+    const OggSeekPoint* point = FindSeekPoint(seekTable_, sample);
+    return point ? point->startSample_ : 0;
+}
+
+unsigned OggVorbisSource::GetNumSeekPoints() const
+{
+    return seekTable_ ? seekTable_->GetSize() / sizeof(OggSeekPoint) : 0;
+}
+
+unsigned OggVorbisSource::GetDataSize() const
+{
+    return data_ ? data_->GetSize() : 0;
+}
+
+const OggSeekPoint* OggVorbisSource::FindSeekPoint(const SampleBuffer* seekTable, unsigned long long sample)
+{
+    if (!seekTable)
+        return 0;
+
+    const OggSeekPoint* points = reinterpret_cast<const OggSeekPoint*>(seekTable->GetData());
+
+    // Binary search for the last page starting at or before the sample
+    unsigned low = 0;
+    unsigned high = seekTable->GetSize() / sizeof(OggSeekPoint);
+    while (low < high)
+    {
+        unsigned mid = (low + high) >> 1;
+        if (points[mid].startSample_ <= sample)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return low ? &points[low - 1] : 0;
+}
+
+bool OggVorbisSource::BuildSeekTable(Deserializer& source)
+{
+    PODVector<OggSeekPoint> points;
+    totalSamples_ = 0;
+
+    unsigned char header[OGG_PAGE_HEADER_SIZE + 255];
+    unsigned long long lastGranule = 0;
+    bool identified = false;
+
+    source.Seek(0);
+    while (!source.IsEof())
+    {
+        unsigned pageOffset = source.GetPosition();
+        if (source.Read(header, OGG_PAGE_HEADER_SIZE) != OGG_PAGE_HEADER_SIZE)
+            break;
+        if (memcmp(header, "OggS", 4))
+        {
+            URHO3D_LOGERROR("Corrupt Ogg page in " + source.GetName());
+            return false;
+        }
+
+        unsigned segments = header[26];
+        if (source.Read(header + OGG_PAGE_HEADER_SIZE, segments) != segments)
+            break;
+
+        unsigned bodySize = 0;
+        for (unsigned i = 0; i < segments; ++i)
+            bodySize += header[OGG_PAGE_HEADER_SIZE + i];
+
+        long long granule = 0;
+        for (unsigned i = 0; i < 8; ++i)
+            granule |= (long long)header[6 + i] << (i * 8);
+
+        if (!identified)
+        {
+            // The first page holds only the identification header with channel count and sample rate
+            unsigned char id[VORBIS_ID_HEADER_SIZE];
+            if (bodySize < VORBIS_ID_HEADER_SIZE || source.Read(id, VORBIS_ID_HEADER_SIZE) != VORBIS_ID_HEADER_SIZE ||
+                id[0] != 1 || memcmp(id + 1, "vorbis", 6))
+            {
+                URHO3D_LOGERROR("Not an Ogg Vorbis stream: " + source.GetName());
+                return false;
+            }
+
+            mChannels = Clamp((unsigned)id[11], 1U, (unsigned)MAX_CHANNELS);
+            mBaseSamplerate = (float)(id[12] | (id[13] << 8) | (id[14] << 16) | (id[15] << 24));
+            identified = true;
+        }
+        else if (granule > 0)
+        {
+            // Pages without a completed packet carry granule -1 and header pages granule 0; neither is seekable
+            if (lastGranule > 0)
+            {
+                OggSeekPoint point;
+                point.startSample_ = lastGranule;
+                point.offset_ = pageOffset;
+                points.Push(point);
+            }
+            lastGranule = (unsigned long long)granule;
+        }
+
+        source.Seek(pageOffset + OGG_PAGE_HEADER_SIZE + segments + bodySize);
+    }
+
+    if (!identified || !mBaseSamplerate)
+    {
+        URHO3D_LOGERROR("Could not read Ogg Vorbis header from " + source.GetName());
+        return false;
+    }
+
+    totalSamples_ = lastGranule;
+    if (!points.Empty())
+    {
+        seekTable_ = new SampleBuffer(points.Size() * sizeof(OggSeekPoint));
+        memcpy(seekTable_->GetData(), &points[0], seekTable_->GetSize());
+    }
+    return true;
+}
+
+void OggVorbisSource::Release()
+{
+    if (data_)
+    {
+        data_->ReleaseRef();
+        data_ = 0;
+    }
+    if (seekTable_)
+    {
+        seekTable_->ReleaseRef();
+        seekTable_ = 0;
+    }
+    fileName_.Clear();
+    totalSamples_ = 0;
+}
+
+}
@@ -0,0 +1,184 @@
+//
+// Copyright (c) 2008-2016 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#pragma once
+
+#include "../Container/Str.h"
+#include "soloud.h"
+
+#include <cstdio>
+
+struct stb_vorbis;
+
+namespace Urho3D
+{
+
+class Deserializer;
+class OggVorbisSource;
+class SampleBuffer;
+
+/// Ogg page entry in a seek table.
+struct OggSeekPoint
+{
+    /// First sample decoded from this page, i.e. the granule position of the previous page.
+    unsigned long long startSample_;
+    /// Byte offset of the page in the file.
+    unsigned offset_;
+};
+
+/// Playing instance of an Ogg Vorbis source. Decodes on the mixer thread and seeks through the seek table. Holds references to the compressed data and seek table until the voice ends.
+class OggVorbisSourceInstance : public SoLoud::AudioSourceInstance
+{
+    friend class OggVorbisSource;
+
+public:
+    /// Construct.
+    OggVorbisSourceInstance(OggVorbisSource* parent);
+    /// Destruct.
+    virtual ~OggVorbisSourceInstance();
+
+    /// Decode samples into a non-interleaved buffer.
+    virtual void getAudio(float* aBuffer, unsigned int aSamples);
+    /// Return whether the end of data has been reached.
+    virtual bool hasEnded();
+    /// Restart from the beginning.
+    virtual SoLoud::result rewind();
+    /// Seek to a time position with a seek table lookup and a short decode. Sample accurate.
+    virtual SoLoud::result seek(double aSeconds, float* mScratch, unsigned int mScratchSize);
+
+private:
+    /// Open the decoder from the beginning of the data.
+    bool Restart();
+    /// Position the decoder at a sample through the seek table. Return true if successful.
+    bool SeekSample(unsigned long long target);
+    /// Decode the next frame into the output pointers. Return false at end of data.
+    bool DecodeFrame();
+    /// Return pointer to unread data and number of bytes available, refilling the stream buffer as needed.
+    const unsigned char* GetData(unsigned& available);
+    /// Move the read position to an absolute byte offset.
+    void SetReadOffset(unsigned offset);
+
+    /// Compressed data when memory resident.
+    SampleBuffer* data_;
+    /// Seek table.
+    SampleBuffer* seekTable_;
+    /// Sample rate of the stream.
+    float sampleRate_;
+    /// Vorbis decoder.
+    stb_vorbis* vorbis_;
+    /// Streamed file handle, null when decoding from memory.
+    FILE* file_;
+    /// Stream read buffer.
+    SharedArrayPtr<unsigned char> streamBuffer_;
+    /// File offset of the first byte in the stream buffer.
+    unsigned bufferOffset_;
+    /// Number of valid bytes in the stream buffer.
+    unsigned bufferSize_;
+    /// Absolute read position.
+    unsigned readOffset_;
+    /// Decoded frame channel pointers.
+    float** frameOutput_;
+    /// Decoded frame channel count.
+    int frameChannels_;
+    /// Decoded frame length in samples.
+    unsigned frameSamples_;
+    /// Read position within the decoded frame.
+    unsigned framePosition_;
+    /// Samples still to discard after a seek.
+    unsigned long long discard_;
+    /// Sample position being sought while waiting for the decoder to report its position.
+    unsigned long long seekTarget_;
+    /// Output position in samples.
+    unsigned long long position_;
+    /// Loop start in samples.
+    unsigned long long loopStart_;
+    /// Loop end in samples, zero for end of data.
+    unsigned long long loopEnd_;
+    /// End of data flag.
+    bool ended_;
+    /// Waiting for the decoder position after a seek flag.
+    bool seeking_;
+};
+
+/// Ogg Vorbis audio source kept compressed in memory or streamed from disk, with a page seek table built at load time. Data is reference counted, so the source can be destroyed while voices still play it.
+class URHO3D_API OggVorbisSource : public SoLoud::AudioSource
+{
+    friend class OggVorbisSourceInstance;
+
+public:
+    /// Construct.
+    OggVorbisSource();
+    /// Destruct. Does not stop playing voices.
+    virtual ~OggVorbisSource();
+
+    /// Keep compressed data in memory, taking over a reference to the buffer. Return true if successful.
+    bool LoadMemory(SampleBuffer* data);
+    /// Stream from a file, scanning it for the seek table. Return true if successful.
+    bool LoadFile(const String& fileName, Deserializer& source);
+    /// Set loop start and end in samples for looped playback. Zero end loops at the end of data. Applies to voices started afterwards.
+    void SetLoopPoints(unsigned long long start, unsigned long long end);
+    /// Read stream format and length only, keeping no data or seek table. The source can not be played. Return true if successful.
+    bool ReadInfo(Deserializer& source);
+    /// Create a playing instance.
+    virtual SoLoud::AudioSourceInstance* createInstance();
+    /// Decode a range of samples into non-interleaved data with the given channel stride. Seeks through the seek table with preroll, so ranges may be decoded concurrently from several threads. Return number of samples decoded.
+    unsigned DecodeRange(unsigned long long start, unsigned count, float* dest, unsigned long long stride);
+
+    /// Return length in seconds.
+    double GetLength() const { return mBaseSamplerate > 0.0f ? (double)totalSamples_ / mBaseSamplerate : 0.0; }
+
+    /// Return total length in samples.
+    unsigned long long GetTotalSamples() const { return totalSamples_; }
+
+    /// Return first sample of the page containing a sample, i.e. the nearest preceding granule boundary.
+    unsigned long long GetPageStart(unsigned long long sample) const;
+
+    /// Return number of seek table entries.
+    unsigned GetNumSeekPoints() const;
+
+    /// Return compressed data size in bytes, or zero when streaming.
+    unsigned GetDataSize() const;
+
+    /// Return the seek point to start decoding from to reach a sample, or null if decoding must start from the beginning.
+    static const OggSeekPoint* FindSeekPoint(const SampleBuffer* seekTable, unsigned long long sample);
+
+private:
+    /// Scan Ogg page headers to read the stream format and build the seek table. Return true if successful.
+    bool BuildSeekTable(Deserializer& source);
+    /// Release compressed data and seek table. Playing voices keep them alive until they end.
+    void Release();
+
+    /// Compressed data when memory resident.
+    SampleBuffer* data_;
+    /// Page seek table.
+    SampleBuffer* seekTable_;
+    /// Streamed file name.
+    String fileName_;
+    /// Total length in samples.
+    unsigned long long totalSamples_;
+    /// Loop start in samples.
+    unsigned long long loopStart_;
+    /// Loop end in samples, zero for end of data.
+    unsigned long long loopEnd_;
+};
+
+}
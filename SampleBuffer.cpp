@@ -0,0 +1,123 @@
+//
+// Copyright (c) 2008-2016 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "../Precompiled.h"
+
+#include "../Audio/AudioRealtime.h"
+#include "../Audio/SampleBuffer.h"
+#include "../Core/Thread.h"
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+volatile bool SampleBuffer::lockMemory_ = false;
+SDL_atomic_t SampleBuffer::lockFailures_ = {0};
+SDL_atomic_t SampleBuffer::allocations_ = {0};
+void* SampleBuffer::pendingBuffers_ = 0;
+
+SampleBuffer::SampleBuffer(unsigned size) :
+    data_(0),
+    size_(size),
+    locked_(false),
+    nextPending_(0)
+{
+    SDL_AtomicSet(&refCount_, 1);
+    SDL_AtomicIncRef(&allocations_);
+
+    if (lockMemory_ && size)
+    {
+        data_ = static_cast<unsigned char*>(AllocateLockedAudioMemory(size));
+        if (data_)
+            locked_ = true;
+        else
+            SDL_AtomicIncRef(&lockFailures_);
+    }
+    if (!data_)
+        data_ = new unsigned char[size];
+}
+
+SampleBuffer::~SampleBuffer()
+{
+    if (locked_)
+        FreeLockedAudioMemory(data_, size_);
+    else
+        delete[] data_;
+}
+
+void SampleBuffer::SetLockMemory(bool enable)
+{
+    lockMemory_ = enable;
+    if (enable)
+        SDL_AtomicSet(&lockFailures_, 0);
+}
+
+unsigned SampleBuffer::GetNumLockFailures()
+{
+    return (unsigned)SDL_AtomicGet(&lockFailures_);
+}
+
+unsigned SampleBuffer::GetNumAllocations()
+{
+    return (unsigned)SDL_AtomicGet(&allocations_);
+}
+
+void SampleBuffer::FreePendingBuffers()
+{
+    // Detach the whole list at once; the mixer only ever pushes, so there is nothing else to race with
+    SampleBuffer* buffer = static_cast<SampleBuffer*>(SDL_AtomicSetPtr(&pendingBuffers_, 0));
+    while (buffer)
+    {
+        SampleBuffer* next = buffer->nextPending_;
+        delete buffer;
+        buffer = next;
+    }
+}
+
+void SampleBuffer::AddRef()
+{
+    SDL_AtomicIncRef(&refCount_);
+}
+
+void SampleBuffer::ReleaseRef()
+{
+    if (!SDL_AtomicDecRef(&refCount_))
+        return;
+
+    if (!locked_ || Thread::IsMainThread())
+    {
+        delete this;
+        return;
+    }
+
+    // Push onto the pending list without blocking or allocating
+    void* head;
+    do
+    {
+        head = SDL_AtomicGetPtr(&pendingBuffers_);
+        nextPending_ = static_cast<SampleBuffer*>(head);
+    } while (!SDL_AtomicCASPtr(&pendingBuffers_, head, this));
+}
+
+}
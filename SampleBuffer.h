@@ -0,0 +1,95 @@
+//
+// Copyright (c) 2008-2016 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include <SDL/SDL_atomic.h>
+
+namespace Urho3D
+{
+
+/// Reference counted audio data shared between a sound and its playing voices. The count is atomic so that whichever holder releases last frees the data, typically a voice ending on the mixer thread. Locked buffers released off the main thread are queued instead, because unlocking and freeing them are system calls the mixer must not make.
+class URHO3D_API SampleBuffer
+{
+public:
+    /// Construct with an uninitialized data block of the given size. The reference count starts at one.
+    SampleBuffer(unsigned size);
+
+    /// Add a reference.
+    void AddRef();
+    /// Release a reference. The buffer deletes itself when the last reference is released.
+    void ReleaseRef();
+
+    /// Return data.
+    unsigned char* GetData() const { return data_; }
+
+    /// Return data as float samples.
+    float* GetSamples() const { return reinterpret_cast<float*>(data_); }
+
+    /// Return data size in bytes.
+    unsigned GetSize() const { return size_; }
+
+    /// Return whether the data is locked into physical memory.
+    bool IsLocked() const { return locked_; }
+
+    /// Set whether buffers allocated afterwards are locked into physical memory, so that the mixer never page faults on them.
+    static void SetLockMemory(bool enable);
+    /// Return whether buffers are locked into physical memory.
+    static bool GetLockMemory() { return lockMemory_; }
+    /// Return number of buffers that could not be locked and fell back to ordinary memory.
+    static unsigned GetNumLockFailures();
+    /// Return number of buffers allocated since startup. Compare two readings to count allocations made in between.
+    static unsigned GetNumAllocations();
+    /// Free the locked buffers whose last reference was released off the main thread. Called by the audio subsystem each frame.
+    static void FreePendingBuffers();
+
+private:
+    /// Destruct. Only called by ReleaseRef.
+    ~SampleBuffer();
+    /// Prevent copy construction.
+    SampleBuffer(const SampleBuffer& rhs);
+    /// Prevent assignment.
+    SampleBuffer& operator =(const SampleBuffer& rhs);
+
+    /// Reference count.
+    SDL_atomic_t refCount_;
+    /// Data.
+    unsigned char* data_;
+    /// Data size in bytes.
+    unsigned size_;
+    /// Locked memory flag.
+    bool locked_;
+    /// Next buffer in the pending free list.
+    SampleBuffer* nextPending_;
+
+    /// Lock memory flag for new buffers.
+    static volatile bool lockMemory_;
+    /// Number of failed lock attempts.
+    static SDL_atomic_t lockFailures_;
+    /// Number of allocated buffers.
+    static SDL_atomic_t allocations_;
+    /// Head of the locked buffers waiting to be freed on the main thread.
+    static void* pendingBuffers_;
+};
+
+}
@@ -0,0 +1,198 @@
+//
+// Copyright (c) 2008-2016 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "../Precompiled.h"
+
+#include "../Audio/AudioTrace.h"
+#include "../Audio/SampleBuffer.h"
+#include "../Audio/SampleSource.h"
+#include "../IO/Deserializer.h"
+#include "../Math/MathDefs.h"
+#include "soloud_wav.h"
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+SampleSourceInstance::SampleSourceInstance(SampleSource* parent) :
+    buffer_(parent->buffer_),
+    sampleCount_(parent->sampleCount_),
+    dataChannels_(parent->mChannels),
+    loopStart_(parent->loopStart_),
+    loopEnd_(parent->loopEnd_ ? Min(parent->loopEnd_, parent->sampleCount_) : parent->sampleCount_),
+    offset_(0)
+{
+    if (buffer_)
+        buffer_->AddRef();
+    else
+        sampleCount_ = 0;
+}
+
+SampleSourceInstance::~SampleSourceInstance()
+{
+    URHO3D_AUDIO_TRACE(TRACE_VOICE_END, mPlayIndex, 0.0f);
+    if (buffer_)
+        buffer_->ReleaseRef();
+}
+
+void SampleSourceInstance::getAudio(float* aBuffer, unsigned int aSamples)
+{
+    unsigned written = 0;
+
+    bool looping = (mFlags & AudioSourceInstance::LOOPING) != 0;
+    unsigned end = looping ? loopEnd_ : sampleCount_;
+
+    while (written < aSamples)
+    {
+        if (offset_ >= end)
+        {
+            if (!looping || loopStart_ >= end)
+                break;
+            offset_ = loopStart_;
+            ++mLoopCount;
+        }
+
+        unsigned count = Min(aSamples - written, end - offset_);
+        const float* data = buffer_->GetSamples();
+        for (unsigned i = 0; i < mChannels; ++i)
+        {
+            unsigned channel = Min(i, dataChannels_ - 1);
+            memcpy(aBuffer + i * aSamples + written, data + channel * sampleCount_ + offset_, count * sizeof(float));
+        }
+        written += count;
+        offset_ += count;
+    }
+
+    if (written < aSamples)
+    {
+        for (unsigned i = 0; i < mChannels; ++i)
+            memset(aBuffer + i * aSamples + written, 0, (aSamples - written) * sizeof(float));
+    }
+}
+
+bool SampleSourceInstance::hasEnded()
+{
+    return !(mFlags & AudioSourceInstance::LOOPING) && offset_ >= sampleCount_;
+}
+
+SoLoud::result SampleSourceInstance::rewind()
+{
+    offset_ = 0;
+    return SoLoud::SO_NO_ERROR;
+}
+
+SoLoud::result SampleSourceInstance::seek(double aSeconds, float* mScratch, unsigned int mScratchSize)
+{
+    offset_ = Min((unsigned)(Max(aSeconds, 0.0) * mBaseSamplerate), sampleCount_);
+    mStreamTime = aSeconds;
+    return SoLoud::SO_NO_ERROR;
+}
+
+SampleSource::SampleSource() :
+    buffer_(0),
+    sampleCount_(0),
+    loopStart_(0),
+    loopEnd_(0)
+{
+}
+
+SampleSource::~SampleSource()
+{
+    // Detach from the engine so that the base class does not stop the voices; they keep their own data references
+    mSoloud = 0;
+    Release();
+}
+
+/// Copy the samples of a decoded SoLoud wave into a sample source.
+static void CopyWavData(SampleSource& dest, const SoLoud::Wav& wav)
+{
+    unsigned dataSize = wav.mSampleCount * wav.mChannels * sizeof(float);
+    SampleBuffer* buffer = new SampleBuffer(dataSize);
+    memcpy(buffer->GetData(), wav.mData, dataSize);
+    dest.SetData(buffer, wav.mSampleCount, wav.mChannels, wav.mBaseSamplerate);
+}
+
+bool SampleSource::Load(const String& fileName)
+{
+    SoLoud::Wav wav;
+    if (wav.load(fileName.CString()) != SoLoud::SO_NO_ERROR || !wav.mData)
+        return false;
+
+    CopyWavData(*this, wav);
+    return true;
+}
+
+bool SampleSource::Load(Deserializer& source)
+{
+    unsigned dataSize = source.GetSize() - source.GetPosition();
+    PODVector<unsigned char> data(dataSize);
+    if (!dataSize || source.Read(data.Buffer(), dataSize) != dataSize)
+        return false;
+
+    // The loader decodes all samples before returning, so it can borrow the encoded data
+    SoLoud::Wav wav;
+    if (wav.loadMem(data.Buffer(), dataSize, false, false) != SoLoud::SO_NO_ERROR || !wav.mData)
+        return false;
+
+    CopyWavData(*this, wav);
+    return true;
+}
+
+void SampleSource::SetData(SampleBuffer* buffer, unsigned sampleCount, unsigned channels, float frequency)
+{
+    Release();
+
+    buffer_ = buffer;
+    sampleCount_ = buffer ? sampleCount : 0;
+    mChannels = Clamp(channels, 1U, (unsigned)MAX_CHANNELS);
+    mBaseSamplerate = frequency;
+}
+
+void SampleSource::SetLoopPoints(unsigned start, unsigned end)
+{
+    loopStart_ = start;
+    loopEnd_ = end;
+}
+
+void SampleSource::Release()
+{
+    if (buffer_)
+    {
+        buffer_->ReleaseRef();
+        buffer_ = 0;
+    }
+    sampleCount_ = 0;
+}
+
+SoLoud::AudioSourceInstance* SampleSource::createInstance()
+{
+    return new SampleSourceInstance(this);
+}
+
+unsigned SampleSource::GetDataSize() const
+{
+    return buffer_ ? buffer_->GetSize() : 0;
+}
+
+}
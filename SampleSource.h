@@ -0,0 +1,116 @@
+//
+// Copyright (c) 2008-2016 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../Container/Str.h"
+#include "soloud.h"
+
+namespace Urho3D
+{
+
+class Deserializer;
+class SampleBuffer;
+class SampleSource;
+
+/// Playing instance of a decoded sample source. Holds a reference to the sample data until the voice ends.
+class SampleSourceInstance : public SoLoud::AudioSourceInstance
+{
+public:
+    /// Construct.
+    SampleSourceInstance(SampleSource* parent);
+    /// Destruct. Releases the sample data, freeing it if the source is already gone.
+    virtual ~SampleSourceInstance();
+
+    /// Copy samples into a non-interleaved buffer.
+    virtual void getAudio(float* aBuffer, unsigned int aSamples);
+    /// Return whether the end of data has been reached.
+    virtual bool hasEnded();
+    /// Restart from the beginning.
+    virtual SoLoud::result rewind();
+    /// Seek directly to a time position.
+    virtual SoLoud::result seek(double aSeconds, float* mScratch, unsigned int mScratchSize);
+
+private:
+    /// Sample data.
+    SampleBuffer* buffer_;
+    /// Length in samples per channel.
+    unsigned sampleCount_;
+    /// Number of channels in the data.
+    unsigned dataChannels_;
+    /// Loop start in samples.
+    unsigned loopStart_;
+    /// Loop end in samples.
+    unsigned loopEnd_;
+    /// Read position in samples.
+    unsigned offset_;
+};
+
+/// Decoded PCM audio source. Sample data is reference counted, so the source can be destroyed or its data released while voices still play it.
+class URHO3D_API SampleSource : public SoLoud::AudioSource
+{
+    friend class SampleSourceInstance;
+
+public:
+    /// Construct.
+    SampleSource();
+    /// Destruct. Does not stop playing voices.
+    virtual ~SampleSource();
+
+    /// Decode a file with the SoLoud loaders. Return true if successful.
+    bool Load(const String& fileName);
+    /// Decode the rest of a stream with the SoLoud loaders. Return true if successful.
+    bool Load(Deserializer& source);
+    /// Set non-interleaved float sample data, taking over a reference to the buffer.
+    void SetData(SampleBuffer* buffer, unsigned sampleCount, unsigned channels, float frequency);
+    /// Release sample data. Playing voices keep it alive until they end.
+    void Release();
+    /// Set loop start and end in samples for looped playback. Zero end loops at the end of data. Applies to voices started afterwards.
+    void SetLoopPoints(unsigned start, unsigned end);
+    /// Create a playing instance.
+    virtual SoLoud::AudioSourceInstance* createInstance();
+
+    /// Return length in seconds.
+    double GetLength() const { return mBaseSamplerate > 0.0f ? (double)sampleCount_ / mBaseSamplerate : 0.0; }
+
+    /// Return length in samples per channel.
+    unsigned GetSampleCount() const { return sampleCount_; }
+
+    /// Return sample data buffer.
+    SampleBuffer* GetBuffer() const { return buffer_; }
+
+    /// Return sample data size in bytes.
+    unsigned GetDataSize() const;
+
+private:
+    /// Sample data.
+    SampleBuffer* buffer_;
+    /// Length in samples per channel.
+    unsigned sampleCount_;
+    /// Loop start in samples.
+    unsigned loopStart_;
+    /// Loop end in samples, zero for end of data.
+    unsigned loopEnd_;
+};
+
+}
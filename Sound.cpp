@@ -22,9 +22,17 @@
 
 #include "../Precompiled.h"
 #include "../Audio/Audio.h"
+#include "../Audio/AudioTrace.h"
+#include "../Audio/SampleBuffer.h"
 #include "../Audio/Sound.h"
+#include "../Audio/SoundCooker.h"
 #include "../Core/Context.h"
 #include "../Core/Profiler.h"
+#include "../Core/Thread.h"
+#include "../Core/Timer.h"
+#include "../Core/WorkQueue.h"
+#include "../IO/Deserializer.h"
+#include "../IO/File.h"
 #include "../IO/FileSystem.h"
 #include "../IO/Log.h"
 #include "../Resource/ResourceCache.h"
@@ -35,17 +43,98 @@
 namespace Urho3D
 {
 
+/// Minimum compressed size for trying parallel decoding, so that short files are not read twice.
+static const unsigned PARALLEL_DECODE_MIN_SIZE = 128 * 1024;
+/// Minimum length in seconds for decoding Ogg Vorbis data in parallel.
+static const float PARALLEL_DECODE_MIN_LENGTH = 20.0f;
+/// Minimum chunk length in seconds for parallel decoding. Each chunk also decodes a preroll, so shorter chunks waste work.
+static const float PARALLEL_DECODE_MIN_CHUNK_LENGTH = 5.0f;
+/// Number of chunks per thread, to even out uneven decode speeds.
+static const unsigned PARALLEL_DECODE_CHUNKS_PER_THREAD = 2;
+
+/// Range of an Ogg Vorbis stream decoded by a work item.
+struct OggDecodeChunk
+{
+    /// Source to decode from.
+    OggVorbisSource* source_;
+    /// First sample.
+    unsigned long long start_;
+    /// Number of samples.
+    unsigned count_;
+    /// Destination for the first channel.
+    float* dest_;
+    /// Channel stride in the destination.
+    unsigned long long stride_;
+    /// Number of samples decoded.
+    unsigned decoded_;
+};
+
+static void DecodeOggChunkWork(const WorkItem* item, unsigned threadIndex)
+{
+    OggDecodeChunk* chunk = static_cast<OggDecodeChunk*>(item->aux_);
+    chunk->decoded_ = chunk->source_->DecodeRange(chunk->start_, chunk->count_, chunk->dest_, chunk->stride_);
+}
+
+static bool ReadWavInfo(Deserializer& source, float& length, unsigned& channels)
+{
+    source.Seek(0);
+    if (source.ReadFileID() != "RIFF")
+        return false;
+    source.ReadUInt();
+    if (source.ReadFileID() != "WAVE")
+        return false;
+
+    unsigned frequency = 0;
+    unsigned frameSize = 0;
+    while (!source.IsEof())
+    {
+        String chunkID = source.ReadFileID();
+        unsigned chunkSize = source.ReadUInt();
+        unsigned chunkStart = source.GetPosition();
+
+        if (chunkID == "fmt ")
+        {
+            source.ReadUShort();
+            channels = source.ReadUShort();
+            frequency = source.ReadUInt();
+            source.ReadUInt();
+            frameSize = source.ReadUShort();
+        }
+        else if (chunkID == "data")
+        {
+            if (!frequency || !frameSize)
+                return false;
+            length = (float)(chunkSize / frameSize) / (float)frequency;
+            return true;
+        }
+
+        // Chunks are padded to an even size
+        source.Seek(chunkStart + chunkSize + (chunkSize & 1));
+    }
+
+    return false;
+}
+
 Sound::Sound(Context* context) :
-    Resource(context)
+    Resource(context),
+    looped_(false),
+    storage_(SOUND_DECODED),
+    storageOverride_(false),
+    parallelDecode_(true),
+    lastPlayTime_(0),
+    evicted_(false),
+    metadataOnly_(false),
+    loudnessGain_(1.0f),
+    peak_(0.0f),
+    length_(0.0f),
+    channels_(0)
 {
-	URHO3D_LOGINFO("Sound");
 	audio_ = GetSubsystem<Audio>();
 }
 
 Sound::~Sound()
 {
-	//SoLoud::Soloud* soloud = audio_->GetSoLoud();
-	//soloud->stopAudioSource(wav_);
+    // Sources release their data references; playing voices hold their own and free the data on the mixer thread when they end
 }
 
 void Sound::RegisterObject(Context* context)
@@ -56,21 +145,97 @@ void Sound::RegisterObject(Context* context)
 bool Sound::BeginLoad(Deserializer& source)
 {
     URHO3D_PROFILE(LoadSound);
-	
-    bool success;
-   
-	int rslt;
-	FileSystem* fc = context_->GetSubsystem<FileSystem>(); //fc->GetCurrentDir()
-	String path = fc->GetProgramDir() + "Data/" + source.GetName();
-	
-	rslt = wav_.load(path.CString());
-	URHO3D_LOGINFO("SoLoud load ogg: " + path + " Result: " + String(rslt));
-	//wav_.setSingleInstance(true);
-	//wav_.setVolume(0.);
-	//wav_.set3dProcessing(true);
-	
-	return true;
 
+    unsigned nameHash = StringHash(source.GetName()).Value();
+    URHO3D_AUDIO_TRACE(TRACE_LOAD_BEGIN, nameHash, 0.0f);
+
+    // The load span is closed on failure too, so that failed loads do not leave it open
+    bool success = LoadData(source);
+    URHO3D_AUDIO_TRACE(TRACE_LOAD_END, nameHash, success ? (float)GetDataSize() : 0.0f);
+    return success;
+}
+
+bool Sound::LoadData(Deserializer& source)
+{
+    LoadParameters();
+
+    // Empty when the sound comes from a package or memory; such sounds can not be streamed or evicted
+    dataPath_ = GetSubsystem<ResourceCache>()->GetResourceFileName(source.GetName());
+    lastPlayTime_ = Time::GetSystemTime();
+    evicted_ = false;
+
+    // Dedicated servers only need the duration to track playback
+    if (audio_ && audio_->IsHeadless())
+    {
+        if (!LoadMetadata(source))
+            return false;
+
+        SetMemoryUse(sizeof(Sound));
+        return true;
+    }
+
+    if (storage_ != SOUND_DECODED && (GetExtension(source.GetName()) != ".ogg" || IsCookedSound(source)))
+    {
+        URHO3D_LOGWARNING("Only Ogg Vorbis sounds can be compressed or streamed, decoding " + source.GetName());
+        storage_ = SOUND_DECODED;
+    }
+    else if (storage_ == SOUND_STREAMED && dataPath_.Empty())
+    {
+        URHO3D_LOGWARNING("Streamed sounds must be files in a resource directory, keeping " + source.GetName() + " compressed");
+        storage_ = SOUND_COMPRESSED;
+    }
+
+    // Compressed and streamed sounds only scan page headers here to build the seek table
+    if (storage_ == SOUND_COMPRESSED)
+    {
+        unsigned dataSize = source.GetSize();
+        SampleBuffer* data = new SampleBuffer(dataSize);
+        if (source.Read(data->GetData(), dataSize) != dataSize)
+        {
+            data->ReleaseRef();
+            return false;
+        }
+        if (!oggSource_.LoadMemory(data))
+            return false;
+    }
+    else if (storage_ == SOUND_STREAMED)
+    {
+        if (!oggSource_.LoadFile(dataPath_, source))
+            return false;
+    }
+    else
+    {
+        if (!DecodeData(source))
+        {
+            URHO3D_LOGERROR("Could not decode sound " + source.GetName());
+            return false;
+        }
+    }
+
+    SetMemoryUse(sizeof(Sound) + GetDataSize());
+    return true;
+}
+
+void Sound::SetData(SampleBuffer* buffer, unsigned sampleCount, unsigned channels, float frequency)
+{
+    storage_ = SOUND_DECODED;
+    dataPath_.Clear();
+    evicted_ = false;
+    metadataOnly_ = false;
+    lastPlayTime_ = Time::GetSystemTime();
+    sampleSource_.SetData(buffer, sampleCount, channels, frequency);
+    SetMemoryUse(sizeof(Sound) + GetDataSize());
+}
+
+void Sound::SetStorage(SoundStorage storage)
+{
+    storage_ = storage;
+    storageOverride_ = true;
+}
+
+void Sound::SetParallelDecode(bool enable)
+{
+    parallelDecode_ = enable;
 }
 
 void Sound::LoadParameters()
@@ -93,16 +258,298 @@ void Sound::LoadParameters()
 		{
 			if (paramElem.HasAttribute("enable"))
 				looped_ = paramElem.GetBool("enable");
-			//if (paramElem.HasAttribute("start") && paramElem.HasAttribute("end"))
-			//	SetLoop((unsigned)paramElem.GetInt("start"), (unsigned)paramElem.GetInt("end"));
+			// Loop points are in samples; playback continues from start after reaching end
+			if (paramElem.HasAttribute("start") || paramElem.HasAttribute("end"))
+			{
+				unsigned start = paramElem.GetUInt("start");
+				unsigned end = paramElem.GetUInt("end");
+				sampleSource_.SetLoopPoints(start, end);
+				oggSource_.SetLoopPoints(start, end);
+			}
+		}
+		else if (name == "compressed")
+		{
+			if (paramElem.GetBool("enable") && !storageOverride_)
+				storage_ = SOUND_COMPRESSED;
+		}
+		else if (name == "stream")
+		{
+			if (paramElem.GetBool("enable") && !storageOverride_)
+				storage_ = SOUND_STREAMED;
 		}
 	}
 }
 
-SoLoud::Wav* Sound::GetWav()
+bool Sound::LoadMetadata(Deserializer& source)
+{
+    String extension = GetExtension(source.GetName());
+
+    if (IsCookedSound(source))
+    {
+        CookedSoundInfo info;
+        if (!ReadCookedSoundInfo(source, info))
+            return false;
+        length_ = info.length_;
+        channels_ = info.channels_;
+        looped_ = info.looped_;
+    }
+    else if (extension == ".ogg")
+    {
+        OggVorbisSource info;
+        if (!info.ReadInfo(source))
+            return false;
+        length_ = (float)info.GetLength();
+        channels_ = info.mChannels;
+    }
+    else if (extension == ".wav")
+    {
+        if (!ReadWavInfo(source, length_, channels_))
+        {
+            URHO3D_LOGERROR("Could not read WAV header from " + source.GetName());
+            return false;
+        }
+    }
+    else
+    {
+        // Other formats have to be decoded to find their length; the samples are discarded
+        SampleSource decoded;
+        if (!decoded.Load(source))
+        {
+            URHO3D_LOGERROR("Could not decode sound " + source.GetName());
+            return false;
+        }
+        length_ = (float)decoded.GetLength();
+        channels_ = decoded.mChannels;
+    }
+
+    metadataOnly_ = true;
+    return true;
+}
+
+bool Sound::DecodeData(Deserializer& source)
+{
+    if (IsCookedSound(source))
+        return LoadCooked(source);
+
+    // Only synchronous loads on the main thread decode in parallel: the work queue may only be fed from the main thread.
+    // Background and prewarm loads run on worker threads and decode serially
+    if (parallelDecode_ && GetExtension(source.GetName()) == ".ogg" && Thread::IsMainThread() && DecodeOggParallel(source))
+        return true;
+
+    source.Seek(0);
+    return sampleSource_.Load(source);
+}
+
+bool Sound::LoadCooked(Deserializer& source)
+{
+    CookedSoundInfo info;
+    if (!ReadCookedSoundInfo(source, info))
+        return false;
+
+    // Cooked data is already at the mix rate with its loop baked; only 16-bit data needs converting
+    unsigned numSamples = info.sampleCount_ * info.channels_;
+    SampleBuffer* buffer = new SampleBuffer(numSamples * sizeof(float));
+    if (info.format_ == COOKED_INT16)
+    {
+        PODVector<short> data(numSamples);
+        if (source.Read(data.Buffer(), numSamples * sizeof(short)) != numSamples * sizeof(short))
+        {
+            buffer->ReleaseRef();
+            return false;
+        }
+        float* dest = buffer->GetSamples();
+        for (unsigned i = 0; i < numSamples; ++i)
+            dest[i] = data[i] * (1.0f / 32768.0f);
+    }
+    else if (source.Read(buffer->GetData(), buffer->GetSize()) != buffer->GetSize())
+    {
+        buffer->ReleaseRef();
+        return false;
+    }
+
+    looped_ = info.looped_;
+    loudnessGain_ = info.loudnessGain_;
+    peak_ = info.peak_;
+    sampleSource_.SetData(buffer, info.sampleCount_, info.channels_, (float)info.frequency_);
+    sampleSource_.SetLoopPoints(info.loopStart_, info.loopEnd_);
+    return true;
+}
+
+bool Sound::DecodeOggParallel(Deserializer& source)
+{
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    if (!queue || !queue->GetNumThreads() || source.GetSize() < PARALLEL_DECODE_MIN_SIZE)
+        return false;
+
+    unsigned dataSize = source.GetSize();
+    SampleBuffer* data = new SampleBuffer(dataSize);
+    source.Seek(0);
+    if (source.Read(data->GetData(), dataSize) != dataSize)
+    {
+        data->ReleaseRef();
+        return false;
+    }
+
+    OggVorbisSource ogg;
+    if (!ogg.LoadMemory(data) || ogg.GetLength() < PARALLEL_DECODE_MIN_LENGTH)
+        return false;
+
+    URHO3D_PROFILE(DecodeOggParallel);
+
+    unsigned long long totalSamples = ogg.GetTotalSamples();
+    unsigned numChunks = Min((queue->GetNumThreads() + 1) * PARALLEL_DECODE_CHUNKS_PER_THREAD,
+        (unsigned)(ogg.GetLength() / PARALLEL_DECODE_MIN_CHUNK_LENGTH));
+    SampleBuffer* buffer = new SampleBuffer((unsigned)(totalSamples * ogg.mChannels * sizeof(float)));
+
+    // Split at page boundaries. Each chunk seeks to the page before its first sample and decodes it as overlap, then
+    // aligns on the granule position of the first decoded packet, so that its samples match a serial decode exactly
+    PODVector<OggDecodeChunk> chunks(numChunks);
+    Vector<SharedPtr<WorkItem> > items;
+    unsigned long long start = 0;
+    for (unsigned i = 0; i < numChunks; ++i)
+    {
+        unsigned long long end = i + 1 < numChunks ? Max(ogg.GetPageStart(totalSamples * (i + 1) / numChunks), start) : totalSamples;
+        OggDecodeChunk& chunk = chunks[i];
+        chunk.source_ = &ogg;
+        chunk.start_ = start;
+        chunk.count_ = (unsigned)(end - start);
+        chunk.dest_ = buffer->GetSamples() + start;
+        chunk.stride_ = totalSamples;
+        chunk.decoded_ = 0;
+        start = end;
+
+        // The first chunk is decoded on the main thread
+        if (chunk.count_ && i)
+        {
+            SharedPtr<WorkItem> item = queue->GetFreeItem();
+            item->workFunction_ = DecodeOggChunkWork;
+            item->aux_ = &chunk;
+            item->priority_ = M_MAX_UNSIGNED;
+            queue->AddWorkItem(item);
+            items.Push(item);
+        }
+    }
+
+    // Decoding may be reached from a work item completed event, for example when a music player prepares an evicted
+    // track. Completing the queue from there would purge it re-entrantly, so wait for the chunks' own items instead.
+    // Chunks no worker has taken yet are decoded here, latest first, so that a paused queue can not leave the wait hanging
+    chunks[0].decoded_ = ogg.DecodeRange(chunks[0].start_, chunks[0].count_, chunks[0].dest_, chunks[0].stride_);
+    for (unsigned i = items.Size() - 1; i < items.Size(); --i)
+    {
+        OggDecodeChunk* chunk = static_cast<OggDecodeChunk*>(items[i]->aux_);
+        if (queue->RemoveWorkItem(items[i]))
+            chunk->decoded_ = ogg.DecodeRange(chunk->start_, chunk->count_, chunk->dest_, chunk->stride_);
+        else
+        {
+            while (!items[i]->completed_)
+                Time::Sleep(1);
+        }
+    }
+
+    for (unsigned i = 0; i < numChunks; ++i)
+    {
+        if (chunks[i].decoded_ != chunks[i].count_)
+        {
+            URHO3D_LOGWARNING("Parallel decode failed for " + GetName() + ", decoding serially");
+            buffer->ReleaseRef();
+            return false;
+        }
+    }
+
+    sampleSource_.SetData(buffer, (unsigned)totalSamples, ogg.mChannels, ogg.mBaseSamplerate);
+    return true;
+}
+
+bool Sound::PrepareData()
+{
+    lastPlayTime_ = Time::GetSystemTime();
+
+    if (metadataOnly_)
+        return false;
+
+    if (evicted_)
+    {
+        URHO3D_PROFILE(DecodeEvictedSound);
+
+        File file(context_, dataPath_);
+        if (!DecodeData(file))
+        {
+            URHO3D_LOGERROR("Could not decode evicted sound " + GetName());
+            return false;
+        }
+        evicted_ = false;
+        UpdateMemoryUse();
+    }
+
+    return true;
+}
+
+bool Sound::EvictData(unsigned idleMSec)
+{
+    // Only fully decoded data can be evicted; compressed data is small and streamed data is not resident
+    if (storage_ != SOUND_DECODED || evicted_ || dataPath_.Empty() || !sampleSource_.GetBuffer() ||
+        Time::GetSystemTime() - lastPlayTime_ < idleMSec)
+        return false;
+
+    sampleSource_.Release();
+    evicted_ = true;
+    UpdateMemoryUse();
+    return true;
+}
+
+unsigned Sound::GetDataSize() const
+{
+    switch (storage_)
+    {
+    case SOUND_DECODED:
+        return sampleSource_.GetDataSize();
+
+    case SOUND_COMPRESSED:
+        return oggSource_.GetDataSize() + oggSource_.GetNumSeekPoints() * sizeof(OggSeekPoint);
+
+    default:
+        return oggSource_.GetNumSeekPoints() * sizeof(OggSeekPoint);
+    }
+}
+
+void Sound::UpdateMemoryUse()
+{
+    // The resource cache folds the new size into its group total and budget check the next time the sound group changes
+    SetMemoryUse(sizeof(Sound) + GetDataSize());
+}
+
+float Sound::GetLength() const
+{
+    if (metadataOnly_)
+        return length_;
+
+    return (float)(storage_ == SOUND_DECODED ? sampleSource_.GetLength() : oggSource_.GetLength());
+}
+
+unsigned long long Sound::GetSampleCount() const
+{
+    if (metadataOnly_)
+        return 0;
+
+    return storage_ == SOUND_DECODED ? sampleSource_.GetSampleCount() : oggSource_.GetTotalSamples();
+}
+
+unsigned Sound::GetChannels() const
+{
+    if (metadataOnly_)
+        return channels_;
+
+    return storage_ == SOUND_DECODED ? sampleSource_.mChannels : oggSource_.mChannels;
+}
+
+SoLoud::AudioSource* Sound::GetAudioSource()
 {
-	
-	return &wav_;
+    if (metadataOnly_)
+        return 0;
+    else if (storage_ == SOUND_DECODED)
+        return &sampleSource_;
+    else
+        return &oggSource_;
 }
 
 }
@@ -22,14 +22,26 @@
 
 #pragma once
 
+#include "../Audio/OggVorbisSource.h"
+#include "../Audio/SampleSource.h"
 #include "../Resource/Resource.h"
-#include "soloud_wav.h"
 
 namespace Urho3D
 {
 
 class SoundStream;
 
+/// %Sound data storage mode.
+enum SoundStorage
+{
+    /// Fully decoded to PCM at load time.
+    SOUND_DECODED = 0,
+    /// Ogg Vorbis data kept compressed in memory and decoded during playback.
+    SOUND_COMPRESSED,
+    /// Ogg Vorbis data streamed from disk during playback.
+    SOUND_STREAMED
+};
+
 /// %Sound resource.
 class URHO3D_API Sound : public Resource
 {
@@ -45,21 +57,100 @@ public:
 
     /// Load resource from stream. May be called from a worker thread. Return true if successful.
     virtual bool BeginLoad(Deserializer& source);
+    /// Set decoded non-interleaved float sample data, taking over a reference to the buffer. Used for procedurally generated sounds, which are never evicted.
+    void SetData(SampleBuffer* buffer, unsigned sampleCount, unsigned channels, float frequency);
+    /// Set storage mode for the next load, overriding the parameter XML file. Sounds that can not be compressed or streamed are still decoded.
+    void SetStorage(SoundStorage storage);
+    /// Set whether long Ogg Vorbis files may be decoded in parallel on the work queue. Only applies to synchronous loads on the main thread; background loads always decode serially. Enabled by default.
+    void SetParallelDecode(bool enable);
 
 	/// Return whether is looped.
 	bool IsLooped() const { return looped_; }
 
-	SoLoud::Wav* GetWav();
+    /// Return storage mode.
+    SoundStorage GetStorage() const { return storage_; }
+
+    /// Return whether parallel decoding is allowed.
+    bool GetParallelDecode() const { return parallelDecode_; }
+
+    /// Return whether only metadata was loaded, as in headless audio mode. Such sounds can not be played.
+    bool IsMetadataOnly() const { return metadataOnly_; }
+
+    /// Make sure sample data is resident, decoding it again if it was evicted, and mark the sound as played. Called by SoundSource before starting a voice. The decode runs synchronously on the calling thread, so playing an evicted sound hitches for its decode time; call ahead of time for sounds that must start instantly. Return true if data is available.
+    bool PrepareData();
+    /// Release decoded sample data if the sound has not been played for the idle time. Voices still playing keep the data alive until they end. Return true if data was released. Called by Audio.
+    bool EvictData(unsigned idleMSec);
+
+    /// Return length in seconds.
+    float GetLength() const;
+
+    /// Return length in samples per channel, or zero if only metadata was loaded.
+    unsigned long long GetSampleCount() const;
+
+    /// Return number of channels.
+    unsigned GetChannels() const;
+
+    /// Return resident sample data size in bytes for the storage mode.
+    unsigned GetDataSize() const;
+
+    /// Return gain that brings the sound to the cooker's target loudness, or 1 if the sound was not cooked.
+    float GetLoudnessGain() const { return loudnessGain_; }
+
+    /// Return peak absolute sample value measured by the cooker, or 0 if the sound was not cooked.
+    float GetPeak() const { return peak_; }
+
+    /// Return whether decoded sample data has been evicted.
+    bool IsEvicted() const { return evicted_; }
+
+    /// Return SoLoud audio source for playback.
+    SoLoud::AudioSource* GetAudioSource();
 
 private:
-	SoLoud::Wav wav_;
+    /// Decoded sample source.
+    SampleSource sampleSource_;
+    /// Compressed or streamed Ogg Vorbis source with seek table.
+    OggVorbisSource oggSource_;
 	SharedPtr<Audio> audio_;
 
 	/// Load optional parameters from an XML file.
 	void LoadParameters();
+    /// Load sample data or metadata in the storage mode. Called by BeginLoad. Return true if successful.
+    bool LoadData(Deserializer& source);
+    /// Decode the source to PCM, in parallel when it is long enough. Return true if successful.
+    bool DecodeData(Deserializer& source);
+    /// Load a cooked sound. Return true if successful.
+    bool LoadCooked(Deserializer& source);
+    /// Decode a long Ogg Vorbis file in chunks on the work queue. Main thread only, so only synchronous loads benefit; background loads decode serially. Return false if the file is too short or decoding failed.
+    bool DecodeOggParallel(Deserializer& source);
+    /// Read length and channel count without keeping sample data. Return true if successful.
+    bool LoadMetadata(Deserializer& source);
+    /// Update the memory use reported to the resource cache after data was decoded or evicted.
+    void UpdateMemoryUse();
 
 	/// Looped flag.
 	bool looped_;
+    /// Storage mode.
+    SoundStorage storage_;
+    /// Storage mode set from code flag. Takes precedence over the parameter XML file.
+    bool storageOverride_;
+    /// Parallel decode allowed flag.
+    bool parallelDecode_;
+    /// Resource file path used for streaming and to decode data again after eviction. Empty if not loaded from a resource directory.
+    String dataPath_;
+    /// System time in milliseconds when the sound was last played or loaded.
+    unsigned lastPlayTime_;
+    /// Decoded data evicted flag.
+    bool evicted_;
+    /// Metadata only flag.
+    bool metadataOnly_;
+    /// Loudness normalization gain from the cooker.
+    float loudnessGain_;
+    /// Peak absolute sample value from the cooker.
+    float peak_;
+    /// Length in seconds when only metadata is loaded.
+    float length_;
+    /// Channel count when only metadata is loaded.
+    unsigned channels_;
 };
 
 }
@@ -0,0 +1,377 @@
+//
+// Copyright (c) 2008-2016 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "../Precompiled.h"
+
+#include "../Audio/SampleBuffer.h"
+#include "../Audio/SampleSource.h"
+#include "../Audio/SoundCooker.h"
+#include "../Core/Context.h"
+#include "../IO/File.h"
+#include "../IO/FileSystem.h"
+#include "../IO/Log.h"
+#include "../Resource/XMLFile.h"
+
+#include <cmath>
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+static const unsigned COOKED_SOUND_VERSION = 1;
+static const unsigned DEFAULT_COOK_MIX_RATE = 44100;
+static const float DEFAULT_TARGET_LOUDNESS = -16.0f;
+/// Resampler filter half-width in zero crossings.
+static const int RESAMPLE_ZERO_CROSSINGS = 16;
+/// Loudness measurement block length in seconds.
+static const float LOUDNESS_BLOCK_LENGTH = 0.4f;
+/// Number of steps per measurement block; consecutive blocks overlap by all but one step.
+static const unsigned LOUDNESS_BLOCK_STEPS = 4;
+/// Blocks quieter than this in LUFS are silence and do not count towards loudness.
+static const float LOUDNESS_ABSOLUTE_GATE = -70.0f;
+/// Blocks more than this many LU below the loudness of the blocks passing the absolute gate do not count towards loudness.
+static const float LOUDNESS_RELATIVE_GATE = -10.0f;
+/// Offset of the K-weighted loudness scale, so that a full scale 997 Hz sine measures -3.01 LUFS.
+static const double LOUDNESS_OFFSET = -0.691;
+
+/// Return loudness in LUFS of a K-weighted mean square summed over channels.
+static double GetLoudness(double power)
+{
+    return LOUDNESS_OFFSET + 10.0 * log10(power);
+}
+
+/// Apply the ITU-R BS.1770 K-weighting filter to one channel: a high shelf modelling the head, followed by a high pass.
+static void KWeightChannel(const float* src, float* dest, unsigned count, unsigned sampleRate)
+{
+    // Filter parameters are those of the standard's 48 kHz coefficients, redesigned for the sample rate
+    double k = tan(M_PI * 1681.974450955533 / sampleRate);
+    double q = 0.7071752369554196;
+    double vh = pow(10.0, 3.999843853973347 / 20.0);
+    double vb = pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    double shelfB[3] = { (vh + vb * k / q + k * k) / a0, 2.0 * (k * k - vh) / a0, (vh - vb * k / q + k * k) / a0 };
+    double shelfA[2] = { 2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0 };
+
+    k = tan(M_PI * 38.13547087602444 / sampleRate);
+    q = 0.5003270373238773;
+    a0 = 1.0 + k / q + k * k;
+    double highPassA[2] = { 2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0 };
+
+    // Direct form II, high pass numerator 1, -2, 1
+    double s1 = 0.0, s2 = 0.0, h1 = 0.0, h2 = 0.0;
+    for (unsigned i = 0; i < count; ++i)
+    {
+        double w = src[i] - shelfA[0] * s1 - shelfA[1] * s2;
+        double shelved = shelfB[0] * w + shelfB[1] * s1 + shelfB[2] * s2;
+        s2 = s1;
+        s1 = w;
+
+        w = shelved - highPassA[0] * h1 - highPassA[1] * h2;
+        dest[i] = (float)(w - 2.0 * h1 + h2);
+        h2 = h1;
+        h1 = w;
+    }
+}
+
+/// Resample one channel with a Blackman windowed sinc filter, lowpassing when downsampling.
+static void ResampleChannel(const float* src, unsigned srcCount, float* dest, unsigned destCount, double step)
+{
+    double cutoff = Min(1.0, 1.0 / step);
+    int halfWidth = (int)ceil(RESAMPLE_ZERO_CROSSINGS / cutoff);
+
+    for (unsigned i = 0; i < destCount; ++i)
+    {
+        double center = i * step;
+        int first = Max((int)floor(center) - halfWidth + 1, 0);
+        int last = Min((int)floor(center) + halfWidth, (int)srcCount - 1);
+        double sum = 0.0;
+
+        for (int j = first; j <= last; ++j)
+        {
+            double offset = j - center;
+            double x = M_PI * offset * cutoff;
+            double sinc = Abs(x) < 1e-9 ? 1.0 : sin(x) / x;
+            double t = M_PI * offset / halfWidth;
+            double window = 0.42 + 0.5 * cos(t) + 0.08 * cos(2.0 * t);
+            sum += src[j] * cutoff * sinc * window;
+        }
+
+        dest[i] = (float)sum;
+    }
+}
+
+CookedSoundInfo::CookedSoundInfo() :
+    frequency_(0),
+    channels_(0),
+    sampleCount_(0),
+    format_(COOKED_FLOAT),
+    looped_(false),
+    loopStart_(0),
+    loopEnd_(0),
+    loudnessGain_(1.0f),
+    peak_(0.0f),
+    length_(0.0f)
+{
+}
+
+bool IsCookedSound(Deserializer& source)
+{
+    unsigned position = source.GetPosition();
+    bool cooked = source.GetSize() - position >= 4 && source.ReadFileID() == "USND";
+    source.Seek(position);
+    return cooked;
+}
+
+bool ReadCookedSoundInfo(Deserializer& source, CookedSoundInfo& info)
+{
+    if (source.ReadFileID() != "USND" || source.ReadUInt() != COOKED_SOUND_VERSION)
+        return false;
+
+    info.frequency_ = source.ReadUInt();
+    info.channels_ = source.ReadUByte();
+    info.format_ = (CookedSampleFormat)source.ReadUByte();
+    info.looped_ = source.ReadBool();
+    info.sampleCount_ = source.ReadUInt();
+    info.loopStart_ = source.ReadUInt();
+    info.loopEnd_ = source.ReadUInt();
+    info.loudnessGain_ = source.ReadFloat();
+    info.peak_ = source.ReadFloat();
+    info.length_ = source.ReadFloat();
+
+    return info.frequency_ && info.channels_ && info.format_ <= COOKED_INT16;
+}
+
+bool WriteCookedSoundInfo(Serializer& dest, const CookedSoundInfo& info)
+{
+    bool success = true;
+    success &= dest.WriteFileID("USND");
+    success &= dest.WriteUInt(COOKED_SOUND_VERSION);
+    success &= dest.WriteUInt(info.frequency_);
+    success &= dest.WriteUByte((unsigned char)info.channels_);
+    success &= dest.WriteUByte((unsigned char)info.format_);
+    success &= dest.WriteBool(info.looped_);
+    success &= dest.WriteUInt(info.sampleCount_);
+    success &= dest.WriteUInt(info.loopStart_);
+    success &= dest.WriteUInt(info.loopEnd_);
+    success &= dest.WriteFloat(info.loudnessGain_);
+    success &= dest.WriteFloat(info.peak_);
+    success &= dest.WriteFloat(info.length_);
+    return success;
+}
+
+SoundCooker::SoundCooker(Context* context) :
+    Object(context),
+    mixRate_(DEFAULT_COOK_MIX_RATE),
+    format_(COOKED_FLOAT),
+    targetLoudness_(DEFAULT_TARGET_LOUDNESS)
+{
+}
+
+SoundCooker::~SoundCooker()
+{
+}
+
+bool SoundCooker::Cook(const String& sourceFileName, const String& destFileName)
+{
+    info_ = CookedSoundInfo();
+    LoadParameters(ReplaceExtension(sourceFileName, ".xml"));
+
+    SampleSource decoded;
+    if (!decoded.Load(sourceFileName))
+    {
+        URHO3D_LOGERROR("Could not decode sound " + sourceFileName);
+        return false;
+    }
+
+    unsigned channels = decoded.mChannels;
+    unsigned srcCount = decoded.GetSampleCount();
+    double step = (double)decoded.mBaseSamplerate / mixRate_;
+
+    // Bake loop points: convert them to the target rate and drop data after the loop end, which a looped sound never plays
+    if (info_.looped_ && info_.loopEnd_ && info_.loopEnd_ < srcCount)
+        srcCount = info_.loopEnd_;
+    info_.loopStart_ = (unsigned)(info_.loopStart_ / step + 0.5);
+    info_.loopEnd_ = info_.loopEnd_ ? (unsigned)(Min(info_.loopEnd_, srcCount) / step + 0.5) : 0;
+
+    unsigned destCount = (unsigned)(srcCount / step);
+    PODVector<float> samples(destCount * channels);
+    const float* src = decoded.GetBuffer()->GetSamples();
+    for (unsigned i = 0; i < channels; ++i)
+    {
+        if (step == 1.0)
+            memcpy(&samples[i * destCount], src + i * decoded.GetSampleCount(), destCount * sizeof(float));
+        else
+            ResampleChannel(src + i * decoded.GetSampleCount(), srcCount, &samples[i * destCount], destCount, step);
+    }
+
+    info_.frequency_ = mixRate_;
+    info_.channels_ = channels;
+    info_.sampleCount_ = destCount;
+    info_.format_ = format_;
+    info_.length_ = (float)destCount / mixRate_;
+    info_.loopEnd_ = Min(info_.loopEnd_, destCount);
+
+    for (unsigned i = 0; i < samples.Size(); ++i)
+        info_.peak_ = Max(info_.peak_, Abs(samples[i]));
+
+    // Measure integrated loudness as in ITU-R BS.1770: K-weighted power summed over channels, in overlapping blocks
+    // gated first absolutely and then relative to the loudness of the remaining blocks
+    PODVector<float> weighted(samples.Size());
+    for (unsigned i = 0; i < channels; ++i)
+        KWeightChannel(&samples[i * destCount], &weighted[i * destCount], destCount, mixRate_);
+
+    unsigned stepSize = Max((unsigned)(LOUDNESS_BLOCK_LENGTH * mixRate_ / LOUDNESS_BLOCK_STEPS), 1U);
+    unsigned numSteps = destCount / stepSize;
+    PODVector<double> stepEnergy(numSteps);
+    for (unsigned i = 0; i < numSteps; ++i)
+    {
+        double energy = 0.0;
+        for (unsigned j = 0; j < channels; ++j)
+        {
+            const float* step = &weighted[j * destCount + i * stepSize];
+            for (unsigned k = 0; k < stepSize; ++k)
+                energy += step[k] * step[k];
+        }
+        stepEnergy[i] = energy;
+    }
+
+    PODVector<double> blockPower;
+    if (numSteps >= LOUDNESS_BLOCK_STEPS)
+    {
+        for (unsigned i = 0; i + LOUDNESS_BLOCK_STEPS <= numSteps; ++i)
+        {
+            double energy = 0.0;
+            for (unsigned j = 0; j < LOUDNESS_BLOCK_STEPS; ++j)
+                energy += stepEnergy[i + j];
+            blockPower.Push(energy / (stepSize * LOUDNESS_BLOCK_STEPS));
+        }
+    }
+    else if (destCount)
+    {
+        // Sounds shorter than one block are measured as a whole
+        double energy = 0.0;
+        for (unsigned i = 0; i < weighted.Size(); ++i)
+            energy += weighted[i] * weighted[i];
+        blockPower.Push(energy / destCount);
+    }
+
+    double gatedPower = 0.0;
+    unsigned gatedBlocks = 0;
+    for (unsigned i = 0; i < blockPower.Size(); ++i)
+    {
+        if (blockPower[i] > 0.0 && GetLoudness(blockPower[i]) > LOUDNESS_ABSOLUTE_GATE)
+        {
+            gatedPower += blockPower[i];
+            ++gatedBlocks;
+        }
+    }
+
+    if (gatedBlocks)
+    {
+        double relativeGate = GetLoudness(gatedPower / gatedBlocks) + LOUDNESS_RELATIVE_GATE;
+        gatedPower = 0.0;
+        gatedBlocks = 0;
+        for (unsigned i = 0; i < blockPower.Size(); ++i)
+        {
+            if (blockPower[i] > 0.0 && GetLoudness(blockPower[i]) > relativeGate)
+            {
+                gatedPower += blockPower[i];
+                ++gatedBlocks;
+            }
+        }
+    }
+
+    if (gatedBlocks)
+    {
+        float loudness = (float)GetLoudness(gatedPower / gatedBlocks);
+        info_.loudnessGain_ = powf(10.0f, (targetLoudness_ - loudness) / 20.0f);
+        // Never normalize into clipping
+        if (info_.peak_ > 0.0f)
+            info_.loudnessGain_ = Min(info_.loudnessGain_, 1.0f / info_.peak_);
+    }
+
+    File dest(context_, destFileName, FILE_WRITE);
+    if (!dest.IsOpen() || !WriteCookedSoundInfo(dest, info_))
+    {
+        URHO3D_LOGERROR("Could not write cooked sound " + destFileName);
+        return false;
+    }
+
+    bool success;
+    if (format_ == COOKED_INT16)
+    {
+        PODVector<short> converted(samples.Size());
+        for (unsigned i = 0; i < samples.Size(); ++i)
+            converted[i] = (short)Clamp((int)floorf(samples[i] * 32768.0f + 0.5f), -32768, 32767);
+        success = dest.Write(converted.Buffer(), converted.Size() * sizeof(short)) == converted.Size() * sizeof(short);
+    }
+    else
+        success = dest.Write(samples.Buffer(), samples.Size() * sizeof(float)) == samples.Size() * sizeof(float);
+
+    if (!success)
+        URHO3D_LOGERROR("Could not write cooked sound " + destFileName);
+    return success;
+}
+
+void SoundCooker::SetMixRate(unsigned mixRate)
+{
+    mixRate_ = Max(mixRate, 1U);
+}
+
+void SoundCooker::SetSampleFormat(CookedSampleFormat format)
+{
+    format_ = format;
+}
+
+void SoundCooker::SetTargetLoudness(float loudness)
+{
+    targetLoudness_ = loudness;
+}
+
+void SoundCooker::LoadParameters(const String& fileName)
+{
+    if (!GetSubsystem<FileSystem>()->FileExists(fileName))
+        return;
+
+    File file(context_, fileName);
+    XMLFile xml(context_);
+    if (!xml.Load(file))
+    {
+        URHO3D_LOGWARNING("Could not read sound parameters " + fileName);
+        return;
+    }
+
+    for (XMLElement paramElem = xml.GetRoot().GetChild(); paramElem; paramElem = paramElem.GetNext())
+    {
+        if (paramElem.GetName() == "loop")
+        {
+            if (paramElem.HasAttribute("enable"))
+                info_.looped_ = paramElem.GetBool("enable");
+            info_.loopStart_ = paramElem.GetUInt("start");
+            info_.loopEnd_ = paramElem.GetUInt("end");
+        }
+    }
+}
+
+}
@@ -0,0 +1,124 @@
+//
+// Copyright (c) 2008-2016 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../Core/Object.h"
+
+namespace Urho3D
+{
+
+class Deserializer;
+class Serializer;
+
+/// Sample format of cooked sound data.
+enum CookedSampleFormat
+{
+    /// 32-bit float, loaded without conversion.
+    COOKED_FLOAT = 0,
+    /// 16-bit integer, half the size on disk and converted to float at load.
+    COOKED_INT16
+};
+
+/// Header of a cooked sound file. Everything the runtime needs is precomputed so that loading does no analysis.
+struct URHO3D_API CookedSoundInfo
+{
+    /// Construct with defaults.
+    CookedSoundInfo();
+
+    /// Sample rate.
+    unsigned frequency_;
+    /// Number of channels.
+    unsigned channels_;
+    /// Length in samples per channel.
+    unsigned sampleCount_;
+    /// Sample format.
+    CookedSampleFormat format_;
+    /// Looped flag.
+    bool looped_;
+    /// Loop start in samples.
+    unsigned loopStart_;
+    /// Loop end in samples, zero for end of data.
+    unsigned loopEnd_;
+    /// Gain that brings the sound to the target loudness without clipping.
+    float loudnessGain_;
+    /// Peak absolute sample value.
+    float peak_;
+    /// Length in seconds.
+    float length_;
+};
+
+/// Return whether a stream holds a cooked sound, leaving the read position at the start.
+URHO3D_API bool IsCookedSound(Deserializer& source);
+/// Read a cooked sound header, leaving the read position at the sample data. Return true if successful.
+URHO3D_API bool ReadCookedSoundInfo(Deserializer& source, CookedSoundInfo& info);
+/// Write a cooked sound header. Return true if successful.
+URHO3D_API bool WriteCookedSoundInfo(Serializer& dest, const CookedSoundInfo& info);
+
+/// Offline sound asset cooker. Converts source audio and its parameter XML file into cooked sounds: resampled to the mix rate, in the target sample format, with loop points baked and loudness, peak and length stored, so that Sound loads them with a single read.
+class URHO3D_API SoundCooker : public Object
+{
+    URHO3D_OBJECT(SoundCooker, Object);
+
+public:
+    /// Construct.
+    SoundCooker(Context* context);
+    /// Destruct.
+    virtual ~SoundCooker();
+
+    /// Cook a source sound file (any format SoLoud decodes) with its optional parameter XML file of the same name. Return true if successful.
+    bool Cook(const String& sourceFileName, const String& destFileName);
+    /// Set target sample rate, usually the mix rate of the shipping configuration.
+    void SetMixRate(unsigned mixRate);
+    /// Set target sample format.
+    void SetSampleFormat(CookedSampleFormat format);
+    /// Set target integrated loudness in LUFS, measured K-weighted and gated as in ITU-R BS.1770.
+    void SetTargetLoudness(float loudness);
+
+    /// Return target sample rate.
+    unsigned GetMixRate() const { return mixRate_; }
+
+    /// Return target sample format.
+    CookedSampleFormat GetSampleFormat() const { return format_; }
+
+    /// Return target integrated loudness in LUFS.
+    float GetTargetLoudness() const { return targetLoudness_; }
+
+    /// Return header of the last cooked sound.
+    const CookedSoundInfo& GetInfo() const { return info_; }
+
+private:
+    /// Read loop parameters from the parameter XML file.
+    void LoadParameters(const String& fileName);
+
+    /// Target sample rate.
+    unsigned mixRate_;
+    /// Target sample format.
+    CookedSampleFormat format_;
+    /// Target loudness.
+    float targetLoudness_;
+    /// Header of the last cooked sound.
+    CookedSoundInfo info_;
+};
+
+}
@@ -0,0 +1,323 @@
+//
+// Copyright (c) 2008-2016 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "../Precompiled.h"
+
+#include "../Audio/Sound.h"
+#include "../Audio/SoundEvent.h"
+#include "../Core/Context.h"
+#include "../Core/Profiler.h"
+#include "../IO/Log.h"
+#include "../Math/Random.h"
+#include "../Resource/ResourceCache.h"
+#include "../Resource/XMLFile.h"
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+/// Scale from a 24-bit random value to the unit range.
+static const float RANDOM_SCALE = 1.0f / 16777216.0f;
+
+static void ReadRange(const XMLElement& element, const String& name, float& min, float& max)
+{
+    // Empty and whitespace-only values leave the range at unity
+    Vector<String> values = element.GetAttribute(name).Trimmed().Split(' ');
+    if (values.Empty())
+    {
+        min = max = 1.0f;
+        return;
+    }
+
+    min = ToFloat(values[0]);
+    max = values.Size() > 1 ? ToFloat(values[1]) : min;
+    if (max < min)
+        Swap(min, max);
+}
+
+SoundEvent::SoundEvent(Context* context) :
+    Resource(context),
+    seed_(1),
+    randomState_(1)
+{
+}
+
+SoundEvent::~SoundEvent()
+{
+}
+
+void SoundEvent::RegisterObject(Context* context)
+{
+    context->RegisterFactory<SoundEvent>();
+}
+
+bool SoundEvent::BeginLoad(Deserializer& source)
+{
+    URHO3D_PROFILE(LoadSoundEvent);
+
+    nodes_.Clear();
+    children_.Clear();
+    weights_.Clear();
+    sounds_.Clear();
+    soundNames_.Clear();
+
+    XMLFile xml(context_);
+    if (!xml.Load(source))
+        return false;
+
+    XMLElement rootElem = xml.GetRoot("soundevent");
+    XMLElement nodeElem = rootElem ? rootElem.GetChild() : XMLElement();
+    if (!nodeElem || ParseNode(nodeElem) == M_MAX_UNSIGNED)
+    {
+        URHO3D_LOGERROR("Sound event " + source.GetName() + " has no valid root node");
+        return false;
+    }
+
+    // A zero seed would stall the generator
+    seed_ = rootElem.HasAttribute("seed") ? rootElem.GetUInt("seed") : (unsigned)Rand() << 16 | (unsigned)Rand();
+    if (!seed_)
+        seed_ = 1;
+    Reset();
+
+    // Queue the sounds as dependencies when loading in the background
+    if (GetAsyncLoadState() == ASYNC_LOADING)
+    {
+        ResourceCache* cache = GetSubsystem<ResourceCache>();
+        for (unsigned i = 0; i < soundNames_.Size(); ++i)
+            cache->BackgroundLoadResource<Sound>(soundNames_[i], true, this);
+    }
+
+    SetMemoryUse(sizeof(SoundEvent) + nodes_.Size() * (sizeof(SoundEventNode) + sizeof(unsigned)) +
+        children_.Size() * 2 * sizeof(unsigned));
+    return true;
+}
+
+bool SoundEvent::EndLoad()
+{
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+    sounds_.Resize(soundNames_.Size());
+    for (unsigned i = 0; i < soundNames_.Size(); ++i)
+    {
+        sounds_[i] = cache->GetResource<Sound>(soundNames_[i]);
+        if (!sounds_[i])
+            URHO3D_LOGWARNING("Sound event " + GetName() + " could not load sound " + soundNames_[i]);
+    }
+
+    soundNames_.Clear();
+    return true;
+}
+
+bool SoundEvent::Resolve(StringHash switchValue, SoundEventResult& result)
+{
+    result.sound_ = 0;
+    result.gain_ = 1.0f;
+    result.pitch_ = 1.0f;
+
+    // Walk down from the root. Parsing only creates trees, so the depth is bounded by the node count
+    unsigned index = 0;
+    for (unsigned depth = 0; index < nodes_.Size() && depth < nodes_.Size(); ++depth)
+    {
+        const SoundEventNode& node = nodes_[index];
+        result.gain_ *= RandomRange(node.minGain_, node.maxGain_);
+        result.pitch_ *= RandomRange(node.minPitch_, node.maxPitch_);
+
+        if (node.type_ == SOUND_EVENT_SOUND)
+        {
+            result.sound_ = sounds_[node.soundIndex_];
+            return result.sound_ != 0;
+        }
+
+        if (!node.numChildren_)
+            return false;
+
+        unsigned child = M_MAX_UNSIGNED;
+        switch (node.type_)
+        {
+        case SOUND_EVENT_RANDOM:
+            child = PickRandomChild(index);
+            break;
+
+        case SOUND_EVENT_SEQUENCE:
+            child = nodeState_[index];
+            nodeState_[index] = child + 1 < node.numChildren_ ? child + 1 : 0;
+            break;
+
+        case SOUND_EVENT_SWITCH:
+            child = node.defaultChild_;
+            for (unsigned i = 0; i < node.numChildren_; ++i)
+            {
+                if (nodes_[children_[node.firstChild_ + i]].switchValue_ == switchValue)
+                {
+                    child = i;
+                    break;
+                }
+            }
+            break;
+
+        default:
+            break;
+        }
+
+        if (child >= node.numChildren_)
+            return false;
+        index = children_[node.firstChild_ + child];
+    }
+
+    return false;
+}
+
+void SoundEvent::Reset()
+{
+    nodeState_.Resize(nodes_.Size());
+    for (unsigned i = 0; i < nodeState_.Size(); ++i)
+        nodeState_[i] = nodes_[i].type_ == SOUND_EVENT_RANDOM ? M_MAX_UNSIGNED : 0;
+
+    randomState_ = seed_;
+}
+
+unsigned SoundEvent::ParseNode(const XMLElement& element)
+{
+    String type = element.GetName();
+
+    SoundEventNode node;
+    node.soundIndex_ = M_MAX_UNSIGNED;
+    node.firstChild_ = 0;
+    node.numChildren_ = 0;
+    node.totalWeight_ = 0;
+    node.defaultChild_ = M_MAX_UNSIGNED;
+    node.switchValue_ = element.HasAttribute("value") ? StringHash(element.GetAttribute("value")) : StringHash::ZERO;
+    node.avoidRepeat_ = element.HasAttribute("avoidrepeat") ? element.GetBool("avoidrepeat") : false;
+    ReadRange(element, "gain", node.minGain_, node.maxGain_);
+    ReadRange(element, "pitch", node.minPitch_, node.maxPitch_);
+
+    if (type == "sound")
+    {
+        String name = element.GetAttribute("name");
+        if (name.Empty())
+        {
+            URHO3D_LOGERROR("Sound event sound node has no name");
+            return M_MAX_UNSIGNED;
+        }
+
+        node.type_ = SOUND_EVENT_SOUND;
+        node.soundIndex_ = soundNames_.Size();
+        soundNames_.Push(name);
+        nodes_.Push(node);
+        return nodes_.Size() - 1;
+    }
+    else if (type == "random")
+        node.type_ = SOUND_EVENT_RANDOM;
+    else if (type == "sequence")
+        node.type_ = SOUND_EVENT_SEQUENCE;
+    else if (type == "switch")
+        node.type_ = SOUND_EVENT_SWITCH;
+    else
+    {
+        URHO3D_LOGERROR("Unknown sound event node " + type);
+        return M_MAX_UNSIGNED;
+    }
+
+    unsigned index = nodes_.Size();
+    nodes_.Push(node);
+
+    // Parse the subtrees first, then store the children contiguously
+    PODVector<unsigned> childIndices;
+    PODVector<unsigned> childWeights;
+    StringHash defaultValue = element.HasAttribute("default") ? StringHash(element.GetAttribute("default")) : StringHash::ZERO;
+    for (XMLElement childElem = element.GetChild(); childElem; childElem = childElem.GetNext())
+    {
+        unsigned childIndex = ParseNode(childElem);
+        if (childIndex == M_MAX_UNSIGNED)
+            return M_MAX_UNSIGNED;
+
+        childIndices.Push(childIndex);
+        childWeights.Push(childElem.HasAttribute("weight") ? childElem.GetUInt("weight") : 1);
+    }
+
+    SoundEventNode& container = nodes_[index];
+    container.firstChild_ = children_.Size();
+    container.numChildren_ = childIndices.Size();
+    for (unsigned i = 0; i < childIndices.Size(); ++i)
+    {
+        children_.Push(childIndices[i]);
+        weights_.Push(childWeights[i]);
+        container.totalWeight_ += childWeights[i];
+        if (container.type_ == SOUND_EVENT_SWITCH && defaultValue != StringHash::ZERO &&
+            nodes_[childIndices[i]].switchValue_ == defaultValue)
+            container.defaultChild_ = i;
+    }
+
+    return index;
+}
+
+unsigned SoundEvent::PickRandomChild(unsigned index)
+{
+    const SoundEventNode& node = nodes_[index];
+    const unsigned* weights = &weights_[node.firstChild_];
+
+    // Leave out the last pick, unless everything else has zero weight
+    unsigned excluded = node.avoidRepeat_ ? nodeState_[index] : M_MAX_UNSIGNED;
+    unsigned totalWeight = node.totalWeight_;
+    if (excluded < node.numChildren_ && weights[excluded] < totalWeight)
+        totalWeight -= weights[excluded];
+    else
+        excluded = M_MAX_UNSIGNED;
+
+    unsigned child = 0;
+    if (totalWeight)
+    {
+        unsigned value = NextRandom() % totalWeight;
+        for (; child < node.numChildren_; ++child)
+        {
+            if (child == excluded)
+                continue;
+            if (value < weights[child])
+                break;
+            value -= weights[child];
+        }
+    }
+    else
+        child = NextRandom() % node.numChildren_;
+
+    nodeState_[index] = child;
+    return child;
+}
+
+unsigned SoundEvent::NextRandom()
+{
+    // Xorshift
+    randomState_ ^= randomState_ << 13;
+    randomState_ ^= randomState_ >> 17;
+    randomState_ ^= randomState_ << 5;
+    return randomState_;
+}
+
+float SoundEvent::RandomRange(float min, float max)
+{
+    if (min == max)
+        return min;
+    return min + (max - min) * (float)(NextRandom() >> 8) * RANDOM_SCALE;
+}
+
+}
@@ -0,0 +1,151 @@
+//
+// Copyright (c) 2008-2016 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../Resource/Resource.h"
+
+namespace Urho3D
+{
+
+class Sound;
+class XMLElement;
+
+/// %Sound event node type.
+enum SoundEventNodeType
+{
+    /// Plays a sound.
+    SOUND_EVENT_SOUND = 0,
+    /// Picks a child by weight.
+    SOUND_EVENT_RANDOM,
+    /// Picks children in order, wrapping around.
+    SOUND_EVENT_SEQUENCE,
+    /// Picks the child matching the switch value of the play call.
+    SOUND_EVENT_SWITCH
+};
+
+/// %Sound event node: a sound or a container. Children of a container are stored contiguously in the event's child arrays.
+struct SoundEventNode
+{
+    /// Node type.
+    SoundEventNodeType type_;
+    /// Index of the sound for sound nodes.
+    unsigned soundIndex_;
+    /// First entry in the child arrays.
+    unsigned firstChild_;
+    /// Number of children.
+    unsigned numChildren_;
+    /// Sum of child weights for random containers.
+    unsigned totalWeight_;
+    /// Child picked when no child matches the switch value, or M_MAX_UNSIGNED for none.
+    unsigned defaultChild_;
+    /// Value selecting this node within a switch container.
+    StringHash switchValue_;
+    /// Minimum gain multiplier.
+    float minGain_;
+    /// Maximum gain multiplier.
+    float maxGain_;
+    /// Minimum pitch multiplier.
+    float minPitch_;
+    /// Maximum pitch multiplier.
+    float maxPitch_;
+    /// Whether a random container avoids picking the same child twice in a row.
+    bool avoidRepeat_;
+};
+
+/// Resolved playback parameters of a sound event.
+struct SoundEventResult
+{
+    /// Sound to play.
+    Sound* sound_;
+    /// Gain with randomization applied.
+    float gain_;
+    /// Pitch with randomization applied.
+    float pitch_;
+};
+
+/// %Sound event resource. Describes random, sequence and switch containers of sounds with weights and gain and pitch randomization in XML, for example:
+/// <soundevent><random pitch="0.95 1.05" avoidrepeat="true"><sound name="Sounds/Step1.wav" weight="2" /><sound name="Sounds/Step2.wav" /></random></soundevent> The containers are flattened at load time and the sounds loaded as dependencies, so that resolving a play does not allocate or look up resources.
+class URHO3D_API SoundEvent : public Resource
+{
+    URHO3D_OBJECT(SoundEvent, Resource);
+
+public:
+    /// Construct.
+    SoundEvent(Context* context);
+    /// Destruct.
+    virtual ~SoundEvent();
+    /// Register object factory.
+    static void RegisterObject(Context* context);
+
+    /// Load resource from stream. May be called from a worker thread. Return true if successful.
+    virtual bool BeginLoad(Deserializer& source);
+    /// Finish resource loading. Always called from the main thread. Return true if successful.
+    virtual bool EndLoad();
+
+    /// Resolve the event to a sound with randomized gain and pitch. Switch containers pick the child whose value matches the switch value, or their default child. Advances sequences and the random generator, so call from the main thread only. Return true if a sound was reached.
+    bool Resolve(StringHash switchValue, SoundEventResult& result);
+    /// Restart all sequences and reseed the random generator.
+    void Reset();
+
+    /// Return number of nodes.
+    unsigned GetNumNodes() const { return nodes_.Size(); }
+
+    /// Return node by index. The root is node 0.
+    const SoundEventNode* GetNode(unsigned index) const { return index < nodes_.Size() ? &nodes_[index] : 0; }
+
+    /// Return number of sounds.
+    unsigned GetNumSounds() const { return sounds_.Size(); }
+
+    /// Return sound by index.
+    Sound* GetSound(unsigned index) const { return index < sounds_.Size() ? sounds_[index].Get() : 0; }
+
+private:
+    /// Parse a node element and its children. Return node index, or M_MAX_UNSIGNED on error.
+    unsigned ParseNode(const XMLElement& element);
+    /// Pick a child of a random container.
+    unsigned PickRandomChild(unsigned index);
+    /// Return next value from the random generator.
+    unsigned NextRandom();
+    /// Return a random value within a range.
+    float RandomRange(float min, float max);
+
+    /// Nodes, root first.
+    PODVector<SoundEventNode> nodes_;
+    /// Child node indices.
+    PODVector<unsigned> children_;
+    /// Child weights.
+    PODVector<unsigned> weights_;
+    /// Per node playback state: next child of sequences or last child of random containers.
+    PODVector<unsigned> nodeState_;
+    /// Sounds referenced by sound nodes.
+    Vector<SharedPtr<Sound> > sounds_;
+    /// Sound names for the load.
+    Vector<String> soundNames_;
+    /// Random generator seed.
+    unsigned seed_;
+    /// Random generator state.
+    unsigned randomState_;
+};
+
+}
@@ -0,0 +1,408 @@
+//
+// Copyright (c) 2008-2016 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "../Precompiled.h"
+
+#include "../Audio/SampleBuffer.h"
+#include "../Audio/SoundLoadBenchmark.h"
+#include "../Core/Context.h"
+#include "../Core/Thread.h"
+#include "../Core/Timer.h"
+#include "../IO/File.h"
+#include "../IO/Log.h"
+#include "../IO/MemoryBuffer.h"
+#include "../Resource/ResourceCache.h"
+
+#include <SDL/SDL_atomic.h>
+
+#ifdef _WIN32
+#include <windows.h>
+// Version 2 resolves to the kernel32 entry point, so no psapi library is needed
+#define PSAPI_VERSION 2
+#include <psapi.h>
+#elif !defined(__EMSCRIPTEN__)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#endif
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+static const char* storageNames[] =
+{
+    "decoded",
+    "compressed",
+    "streamed"
+};
+
+static const char* sourceNames[] =
+{
+    "file",
+    "package",
+    "memory"
+};
+
+/// Memory buffer that reports a resource name, which sounds use to pick the decoder and the streaming path.
+class NamedMemoryBuffer : public MemoryBuffer
+{
+public:
+    /// Construct with read-only data and a name.
+    NamedMemoryBuffer(const void* data, unsigned size, const String& name) :
+        MemoryBuffer(data, size),
+        name_(name)
+    {
+    }
+
+    /// Return the resource name.
+    virtual const String& GetName() const { return name_; }
+
+private:
+    /// Resource name.
+    String name_;
+};
+
+/// One load performed by a benchmark case.
+struct SoundLoadItem
+{
+    /// Sound being loaded.
+    SharedPtr<Sound> sound_;
+    /// Resource name.
+    String name_;
+    /// Full path in a resource directory, empty if the asset is only in a package.
+    String fileName_;
+    /// In-memory image of the file.
+    SharedArrayPtr<unsigned char> image_;
+    /// In-memory image size.
+    unsigned imageSize_;
+    /// Source data size read by the load.
+    unsigned sourceSize_;
+    /// Load time in milliseconds.
+    float msec_;
+    /// Success flag.
+    bool success_;
+};
+
+/// Load one item from the given source and time it.
+static void LoadSoundItem(Context* context, SoundLoadItem& item, SoundLoadSource source)
+{
+    HiresTimer timer;
+    item.success_ = false;
+    item.sourceSize_ = 0;
+
+    switch (source)
+    {
+    case SOUND_LOAD_FILE:
+        if (!item.fileName_.Empty())
+        {
+            File file(context, item.fileName_);
+            // Sounds derive the streaming path from the resource name, as when opened by the resource cache
+            file.SetName(item.name_);
+            item.sourceSize_ = file.GetSize();
+            item.success_ = file.IsOpen() && item.sound_->BeginLoad(file);
+        }
+        break;
+
+    case SOUND_LOAD_PACKAGE:
+        {
+            SharedPtr<File> file = context->GetSubsystem<ResourceCache>()->GetFile(item.name_, false);
+            if (file)
+            {
+                item.sourceSize_ = file->GetSize();
+                item.success_ = item.sound_->BeginLoad(*file);
+            }
+        }
+        break;
+
+    case SOUND_LOAD_MEMORY:
+        if (item.image_)
+        {
+            NamedMemoryBuffer buffer(item.image_.Get(), item.imageSize_, item.name_);
+            item.sourceSize_ = item.imageSize_;
+            item.success_ = item.sound_->BeginLoad(buffer);
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    item.msec_ = timer.GetUSec(false) / 1000.0f;
+}
+
+/// Worker thread of a benchmark case. Takes items from a shared counter until all are loaded.
+class SoundLoadThread : public Thread
+{
+public:
+    /// Construct.
+    SoundLoadThread(Context* context, Vector<SoundLoadItem>& items, SDL_atomic_t& next, SoundLoadSource source) :
+        context_(context),
+        items_(items),
+        next_(next),
+        source_(source)
+    {
+    }
+
+    /// Load items.
+    virtual void ThreadFunction()
+    {
+        for (;;)
+        {
+            unsigned index = (unsigned)SDL_AtomicAdd(&next_, 1);
+            if (index >= items_.Size())
+                break;
+            LoadSoundItem(context_, items_[index], source_);
+        }
+    }
+
+private:
+    /// Execution context.
+    Context* context_;
+    /// Items of the case.
+    Vector<SoundLoadItem>& items_;
+    /// Index of the next item to load.
+    SDL_atomic_t& next_;
+    /// Data source.
+    SoundLoadSource source_;
+};
+
+SoundLoadBenchmark::SoundLoadBenchmark(Context* context) :
+    Object(context),
+    iterations_(1)
+{
+}
+
+SoundLoadBenchmark::~SoundLoadBenchmark()
+{
+}
+
+void SoundLoadBenchmark::AddAsset(const String& name)
+{
+    assets_.Push(name);
+}
+
+void SoundLoadBenchmark::ClearAssets()
+{
+    assets_.Clear();
+}
+
+void SoundLoadBenchmark::SetIterations(unsigned iterations)
+{
+    iterations_ = Max(iterations, 1U);
+}
+
+SoundLoadResult SoundLoadBenchmark::Run(SoundStorage storage, SoundLoadSource source, unsigned threads)
+{
+    SoundLoadResult result;
+    result.storage_ = storage;
+    result.source_ = source;
+    result.threads_ = threads = Max(threads, 1U);
+
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
+
+    // Resolve paths and read memory images up front, so that only the load itself is timed
+    Vector<SoundLoadItem> items(assets_.Size() * iterations_);
+    for (unsigned i = 0; i < assets_.Size(); ++i)
+    {
+        String fileName;
+        SharedArrayPtr<unsigned char> image;
+        unsigned imageSize = 0;
+
+        if (source == SOUND_LOAD_FILE)
+            fileName = cache->GetResourceFileName(assets_[i]);
+        else if (source == SOUND_LOAD_MEMORY)
+        {
+            SharedPtr<File> file = cache->GetFile(assets_[i], false);
+            if (file)
+            {
+                imageSize = file->GetSize();
+                image = new unsigned char[imageSize];
+                if (file->Read(image.Get(), imageSize) != imageSize)
+                    image.Reset();
+            }
+        }
+
+        for (unsigned j = 0; j < iterations_; ++j)
+        {
+            SoundLoadItem& item = items[j * assets_.Size() + i];
+            item.sound_ = new Sound(context_);
+            item.sound_->SetName(assets_[i]);
+            item.sound_->SetStorage(storage);
+            // Single-threaded cases run on the main thread, which would otherwise hand long files to the work queue
+            item.sound_->SetParallelDecode(false);
+            item.name_ = assets_[i];
+            item.fileName_ = fileName;
+            item.image_ = image;
+            item.imageSize_ = imageSize;
+            item.sourceSize_ = 0;
+            item.msec_ = 0.0f;
+            item.success_ = false;
+        }
+    }
+
+    // The peak is a process high-water mark. Where it can be reset it starts from the current resident size, elsewhere
+    // only growth above the peak of earlier cases shows
+    ResetPeakRSS();
+    unsigned long long rssBefore = GetPeakRSS();
+    unsigned allocationsBefore = SampleBuffer::GetNumAllocations();
+    HiresTimer timer;
+
+    // A single thread loads on the main thread, as a synchronous resource load would
+    if (threads == 1)
+    {
+        for (unsigned i = 0; i < items.Size(); ++i)
+            LoadSoundItem(context_, items[i], source);
+    }
+    else
+    {
+        SDL_atomic_t next;
+        SDL_AtomicSet(&next, 0);
+
+        PODVector<SoundLoadThread*> loadThreads;
+        for (unsigned i = 0; i < threads; ++i)
+        {
+            SoundLoadThread* thread = new SoundLoadThread(context_, items, next, source);
+            thread->Run();
+            loadThreads.Push(thread);
+        }
+        for (unsigned i = 0; i < loadThreads.Size(); ++i)
+        {
+            loadThreads[i]->Stop();
+            delete loadThreads[i];
+        }
+    }
+
+    result.totalMSec_ = timer.GetUSec(false) / 1000.0f;
+    result.allocations_ = SampleBuffer::GetNumAllocations() - allocationsBefore;
+    unsigned long long rssAfter = GetPeakRSS();
+    result.peakRSSGrowth_ = rssAfter > rssBefore ? rssAfter - rssBefore : 0;
+
+    float loadMSec = 0.0f;
+    for (unsigned i = 0; i < items.Size(); ++i)
+    {
+        const SoundLoadItem& item = items[i];
+        if (!item.success_)
+        {
+            ++result.failures_;
+            continue;
+        }
+
+        ++result.assets_;
+        result.sourceBytes_ += item.sourceSize_;
+        result.residentBytes_ += item.sound_->GetDataSize();
+        loadMSec += item.msec_;
+    }
+
+    if (result.assets_)
+        result.msPerAsset_ = loadMSec / result.assets_;
+    if (result.totalMSec_ > 0.0f)
+        result.mbPerSec_ = (float)(result.sourceBytes_ / (1024.0 * 1024.0) / (result.totalMSec_ / 1000.0));
+
+    return result;
+}
+
+void SoundLoadBenchmark::RunAll(const PODVector<unsigned>& threadCounts)
+{
+    results_.Clear();
+
+    for (unsigned i = 0; i < threadCounts.Size(); ++i)
+    {
+        for (unsigned storage = SOUND_DECODED; storage <= SOUND_STREAMED; ++storage)
+        {
+            for (unsigned source = SOUND_LOAD_FILE; source < MAX_SOUND_LOAD_SOURCES; ++source)
+                results_.Push(Run((SoundStorage)storage, (SoundLoadSource)source, threadCounts[i]));
+        }
+    }
+}
+
+void SoundLoadBenchmark::LogResults() const
+{
+    URHO3D_LOGINFO(ToString("Sound load benchmark: %u assets, %u iterations", assets_.Size(), iterations_));
+    URHO3D_LOGINFO("storage    source   threads  loaded failed     MB/s  ms/asset  resident MB peak RSS +MB  allocs");
+
+    for (unsigned i = 0; i < results_.Size(); ++i)
+    {
+        const SoundLoadResult& result = results_[i];
+        URHO3D_LOGINFO(ToString("%-10s %-8s %7u %7u %6u %8.1f %9.3f %12.1f %12.1f %7u", storageNames[result.storage_],
+            sourceNames[result.source_], result.threads_, result.assets_, result.failures_, result.mbPerSec_, result.msPerAsset_,
+            result.residentBytes_ / (1024.0 * 1024.0), result.peakRSSGrowth_ / (1024.0 * 1024.0), result.allocations_));
+    }
+}
+
+unsigned long long SoundLoadBenchmark::GetPeakRSS()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PeakWorkingSetSize;
+    return 0;
+#elif defined(__linux__)
+    // Read the high-water mark the kernel resets, rather than getrusage, which also keeps the peaks of exited threads
+    FILE* file = fopen("/proc/self/status", "r");
+    if (!file)
+        return 0;
+    char line[256];
+    unsigned long long peak = 0;
+    while (fgets(line, sizeof(line), file))
+    {
+        if (!strncmp(line, "VmHWM:", 6))
+        {
+            peak = strtoull(line + 6, 0, 10) * 1024;
+            break;
+        }
+    }
+    fclose(file);
+    return peak;
+#elif !defined(__EMSCRIPTEN__)
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage))
+        return 0;
+#ifdef __APPLE__
+    // Reported in bytes on Apple platforms and in kilobytes elsewhere
+    return (unsigned long long)usage.ru_maxrss;
+#else
+    return (unsigned long long)usage.ru_maxrss * 1024;
+#endif
+#else
+    return 0;
+#endif
+}
+
+bool SoundLoadBenchmark::ResetPeakRSS()
+{
+#ifdef __linux__
+    // Writing 5 resets the high-water mark to the current resident size (Linux 4.0 and later)
+    FILE* file = fopen("/proc/self/clear_refs", "w");
+    if (!file)
+        return false;
+    bool success = fputs("5", file) >= 0;
+    return fclose(file) == 0 && success;
+#else
+    return false;
+#endif
+}
+
+}
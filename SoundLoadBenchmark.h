@@ -0,0 +1,137 @@
+//
+// Copyright (c) 2008-2016 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../Audio/Sound.h"
+#include "../Core/Object.h"
+
+namespace Urho3D
+{
+
+/// Where a sound load benchmark reads asset data from.
+enum SoundLoadSource
+{
+    /// A file opened directly by its path in a resource directory.
+    SOUND_LOAD_FILE = 0,
+    /// The resource cache, reading from resource directories or packages.
+    SOUND_LOAD_PACKAGE,
+    /// An in-memory image of the file read before timing starts, standing in for a memory-mapped file.
+    SOUND_LOAD_MEMORY,
+    MAX_SOUND_LOAD_SOURCES
+};
+
+/// Result of one sound load benchmark case.
+struct URHO3D_API SoundLoadResult
+{
+    /// Construct with zero measurements.
+    SoundLoadResult() :
+        storage_(SOUND_DECODED),
+        source_(SOUND_LOAD_FILE),
+        threads_(1),
+        assets_(0),
+        failures_(0),
+        sourceBytes_(0),
+        residentBytes_(0),
+        totalMSec_(0.0f),
+        msPerAsset_(0.0f),
+        mbPerSec_(0.0f),
+        peakRSSGrowth_(0),
+        allocations_(0)
+    {
+    }
+
+    /// Storage mode.
+    SoundStorage storage_;
+    /// Data source.
+    SoundLoadSource source_;
+    /// Number of loading threads.
+    unsigned threads_;
+    /// Number of assets loaded, counting each iteration.
+    unsigned assets_;
+    /// Number of failed loads.
+    unsigned failures_;
+    /// Source data size in bytes.
+    unsigned long long sourceBytes_;
+    /// Resident sample data size in bytes after loading.
+    unsigned long long residentBytes_;
+    /// Wall clock time in milliseconds.
+    float totalMSec_;
+    /// Average time of one load in milliseconds, as measured by the loading thread.
+    float msPerAsset_;
+    /// Source data throughput in megabytes per second of wall clock time.
+    float mbPerSec_;
+    /// Growth of the process peak resident set size during the case in bytes, or zero if not supported. Where the peak can not be reset, only growth above the peak of earlier cases is counted.
+    unsigned long long peakRSSGrowth_;
+    /// Number of sample buffers allocated.
+    unsigned allocations_;
+};
+
+/// %Sound loading and decoding throughput benchmark. Loads a set of assets in every storage mode from every data source with varying thread counts, so that load path regressions show up as numbers instead of longer level loads. Run from the main thread with the resource cache set up.
+class URHO3D_API SoundLoadBenchmark : public Object
+{
+    URHO3D_OBJECT(SoundLoadBenchmark, Object);
+
+public:
+    /// Construct.
+    SoundLoadBenchmark(Context* context);
+    /// Destruct.
+    virtual ~SoundLoadBenchmark();
+
+    /// Add an asset by resource name. Use a spread of formats, channel counts and sample rates; only Ogg Vorbis assets can be compressed or streamed, others are decoded in those cases.
+    void AddAsset(const String& name);
+    /// Remove all assets.
+    void ClearAssets();
+    /// Set number of times each asset is loaded per case.
+    void SetIterations(unsigned iterations);
+    /// Run one case. Loaded sounds are released before returning.
+    SoundLoadResult Run(SoundStorage storage, SoundLoadSource source, unsigned threads);
+    /// Run every combination of storage mode and data source for each thread count, storing the results.
+    void RunAll(const PODVector<unsigned>& threadCounts);
+    /// Log the stored results as a table.
+    void LogResults() const;
+
+    /// Return number of iterations.
+    unsigned GetIterations() const { return iterations_; }
+
+    /// Return asset names.
+    const Vector<String>& GetAssets() const { return assets_; }
+
+    /// Return stored results.
+    const Vector<SoundLoadResult>& GetResults() const { return results_; }
+
+    /// Return process peak resident set size in bytes, or zero if not supported.
+    static unsigned long long GetPeakRSS();
+    /// Reset the process peak resident set size to the current resident set size. Return true if supported.
+    static bool ResetPeakRSS();
+
+private:
+    /// Asset names.
+    Vector<String> assets_;
+    /// Iterations per case.
+    unsigned iterations_;
+    /// Stored results.
+    Vector<SoundLoadResult> results_;
+};
+
+}
@@ -0,0 +1,160 @@
+//
+// Copyright (c) 2008-2016 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "../Precompiled.h"
+
+#include "../Audio/SoundPortal.h"
+#include "../Audio/SoundPropagation.h"
+#include "../Audio/SoundRoom.h"
+#include "../Core/Context.h"
+#include "../Graphics/DebugRenderer.h"
+#include "../Scene/Node.h"
+#include "../Scene/Scene.h"
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+static const float PORTAL_DEBUG_RADIUS = 0.25f;
+static const Color OPEN_PORTAL_COLOR(0.0f, 1.0f, 0.0f);
+static const Color CLOSED_PORTAL_COLOR(1.0f, 0.0f, 0.0f);
+
+extern const char* AUDIO_CATEGORY;
+
+SoundPortal::SoundPortal(Context* context) :
+    Component(context),
+    roomANodeID_(0),
+    roomBNodeID_(0),
+    open_(true)
+{
+}
+
+SoundPortal::~SoundPortal()
+{
+    if (propagation_)
+        propagation_->RemovePortal(this);
+}
+
+void SoundPortal::RegisterObject(Context* context)
+{
+    context->RegisterFactory<SoundPortal>(AUDIO_CATEGORY);
+
+    URHO3D_ACCESSOR_ATTRIBUTE("Room A NodeID", GetRoomANodeIDAttr, SetRoomANodeIDAttr, unsigned, 0, AM_DEFAULT | AM_NODEID);
+    URHO3D_ACCESSOR_ATTRIBUTE("Room B NodeID", GetRoomBNodeIDAttr, SetRoomBNodeIDAttr, unsigned, 0, AM_DEFAULT | AM_NODEID);
+    URHO3D_ACCESSOR_ATTRIBUTE("Is Open", IsOpen, SetOpen, bool, true, AM_DEFAULT);
+}
+
+void SoundPortal::ApplyAttributes()
+{
+    // Node IDs are remapped after load, so the rooms are resolved again
+    MarkPropagationDirty();
+}
+
+void SoundPortal::DrawDebugGeometry(DebugRenderer* debug, bool depthTest)
+{
+    if (!debug || !node_)
+        return;
+
+    Vector3 position = node_->GetWorldPosition();
+    const Color& color = open_ ? OPEN_PORTAL_COLOR : CLOSED_PORTAL_COLOR;
+    debug->AddSphere(Sphere(position, PORTAL_DEBUG_RADIUS), color, depthTest);
+
+    SoundRoom* roomA = GetRoomA();
+    SoundRoom* roomB = GetRoomB();
+    if (roomA)
+        debug->AddLine(position, roomA->GetNode()->GetWorldPosition(), color, depthTest);
+    if (roomB)
+        debug->AddLine(position, roomB->GetNode()->GetWorldPosition(), color, depthTest);
+}
+
+void SoundPortal::SetRooms(SoundRoom* roomA, SoundRoom* roomB)
+{
+    roomANodeID_ = roomA && roomA->GetNode() ? roomA->GetNode()->GetID() : 0;
+    roomBNodeID_ = roomB && roomB->GetNode() ? roomB->GetNode()->GetID() : 0;
+    MarkPropagationDirty();
+    MarkNetworkUpdate();
+}
+
+void SoundPortal::SetOpen(bool enable)
+{
+    if (enable == open_)
+        return;
+
+    open_ = enable;
+    MarkPropagationDirty();
+    MarkNetworkUpdate();
+}
+
+SoundRoom* SoundPortal::GetRoomA() const
+{
+    return GetRoom(roomANodeID_);
+}
+
+SoundRoom* SoundPortal::GetRoomB() const
+{
+    return GetRoom(roomBNodeID_);
+}
+
+void SoundPortal::SetRoomANodeIDAttr(unsigned value)
+{
+    roomANodeID_ = value;
+    MarkPropagationDirty();
+}
+
+void SoundPortal::SetRoomBNodeIDAttr(unsigned value)
+{
+    roomBNodeID_ = value;
+    MarkPropagationDirty();
+}
+
+void SoundPortal::OnSceneSet(Scene* scene)
+{
+    if (propagation_)
+    {
+        propagation_->RemovePortal(this);
+        propagation_.Reset();
+    }
+
+    if (scene)
+    {
+        // Every peer builds its own propagation graph from the replicated rooms and portals
+        propagation_ = scene->GetOrCreateComponent<SoundPropagation>(LOCAL);
+        propagation_->AddPortal(this);
+    }
+}
+
+SoundRoom* SoundPortal::GetRoom(unsigned nodeID) const
+{
+    Scene* scene = GetScene();
+    Node* node = scene && nodeID ? scene->GetNode(nodeID) : 0;
+    return node ? node->GetComponent<SoundRoom>() : 0;
+}
+
+void SoundPortal::MarkPropagationDirty()
+{
+    if (propagation_)
+        propagation_->MarkDirty();
+}
+
+}
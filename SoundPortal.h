@@ -0,0 +1,96 @@
+//
+// Copyright (c) 2008-2016 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../Scene/Component.h"
+
+namespace Urho3D
+{
+
+class SoundPropagation;
+class SoundRoom;
+
+/// %Sound propagation portal component. Connects two sound rooms at its scene node position, such as a doorway; sound between the rooms travels through open portals only.
+class URHO3D_API SoundPortal : public Component
+{
+    URHO3D_OBJECT(SoundPortal, Component);
+
+public:
+    /// Construct.
+    SoundPortal(Context* context);
+    /// Destruct.
+    virtual ~SoundPortal();
+    /// Register object factory.
+    static void RegisterObject(Context* context);
+
+    /// Apply attribute changes that can not be applied immediately.
+    virtual void ApplyAttributes();
+    /// Visualize the component as debug geometry.
+    virtual void DrawDebugGeometry(DebugRenderer* debug, bool depthTest);
+
+    /// Set the rooms connected by the portal.
+    void SetRooms(SoundRoom* roomA, SoundRoom* roomB);
+    /// Open or close the portal. Invalidates the precomputed propagation paths.
+    void SetOpen(bool enable);
+
+    /// Return first connected room.
+    SoundRoom* GetRoomA() const;
+    /// Return second connected room.
+    SoundRoom* GetRoomB() const;
+
+    /// Return whether the portal is open.
+    bool IsOpen() const { return open_; }
+
+    /// Set first room node ID attribute.
+    void SetRoomANodeIDAttr(unsigned value);
+    /// Set second room node ID attribute.
+    void SetRoomBNodeIDAttr(unsigned value);
+
+    /// Return first room node ID attribute.
+    unsigned GetRoomANodeIDAttr() const { return roomANodeID_; }
+
+    /// Return second room node ID attribute.
+    unsigned GetRoomBNodeIDAttr() const { return roomBNodeID_; }
+
+protected:
+    /// Handle scene being assigned.
+    virtual void OnSceneSet(Scene* scene);
+
+private:
+    /// Return the room on a node of the scene.
+    SoundRoom* GetRoom(unsigned nodeID) const;
+    /// Mark the propagation paths for rebuild.
+    void MarkPropagationDirty();
+
+    /// First room node ID.
+    unsigned roomANodeID_;
+    /// Second room node ID.
+    unsigned roomBNodeID_;
+    /// Open flag.
+    bool open_;
+    /// Propagation graph the portal belongs to.
+    WeakPtr<SoundPropagation> propagation_;
+};
+
+}
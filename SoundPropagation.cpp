@@ -0,0 +1,244 @@
+//
+// Copyright (c) 2008-2016 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "../Precompiled.h"
+
+#include "../Audio/SoundPortal.h"
+#include "../Audio/SoundPropagation.h"
+#include "../Audio/SoundRoom.h"
+#include "../Core/Context.h"
+#include "../Core/Profiler.h"
+#include "../Scene/Node.h"
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+static const Vector3 INVALID_POSITION(M_INFINITY, M_INFINITY, M_INFINITY);
+
+extern const char* AUDIO_CATEGORY;
+
+SoundPropagation::SoundPropagation(Context* context) :
+    Component(context),
+    listenerRoom_(M_MAX_UNSIGNED),
+    listenerPosition_(INVALID_POSITION),
+    dirty_(true)
+{
+}
+
+SoundPropagation::~SoundPropagation()
+{
+}
+
+void SoundPropagation::RegisterObject(Context* context)
+{
+    context->RegisterFactory<SoundPropagation>(AUDIO_CATEGORY);
+}
+
+void SoundPropagation::AddRoom(SoundRoom* room)
+{
+    rooms_.Push(room);
+    dirty_ = true;
+}
+
+void SoundPropagation::RemoveRoom(SoundRoom* room)
+{
+    rooms_.Remove(room);
+    dirty_ = true;
+}
+
+void SoundPropagation::AddPortal(SoundPortal* portal)
+{
+    portals_.Push(portal);
+    dirty_ = true;
+}
+
+void SoundPropagation::RemovePortal(SoundPortal* portal)
+{
+    portals_.Remove(portal);
+    dirty_ = true;
+}
+
+Vector3 SoundPropagation::GetApparentPosition(const Vector3& listenerPosition, const Vector3& sourcePosition, unsigned& sourceRoomHint)
+{
+    if (dirty_)
+        Rebuild();
+
+    // All sources share the listener's room for the frame
+    if (listenerPosition != listenerPosition_)
+    {
+        listenerRoom_ = GetRoomIndex(listenerPosition, listenerRoom_);
+        listenerPosition_ = listenerPosition;
+    }
+
+    sourceRoomHint = GetRoomIndex(sourcePosition, sourceRoomHint);
+    if (listenerRoom_ == M_MAX_UNSIGNED || sourceRoomHint == M_MAX_UNSIGNED || listenerRoom_ == sourceRoomHint)
+        return sourcePosition;
+
+    const PODVector<SoundPortalPath>& paths = GetPaths(listenerRoom_, sourceRoomHint);
+    float bestLength = M_INFINITY;
+    unsigned bestPortal = M_MAX_UNSIGNED;
+    for (unsigned i = 0; i < paths.Size(); ++i)
+    {
+        const SoundPortalPath& path = paths[i];
+        float length = (portalPositions_[path.listenerPortal_] - listenerPosition).Length() + path.distance_ +
+            (sourcePosition - portalPositions_[path.sourcePortal_]).Length();
+        if (length < bestLength)
+        {
+            bestLength = length;
+            bestPortal = path.listenerPortal_;
+        }
+    }
+
+    // Without an open path, move the source out of hearing range of any attenuation curve
+    if (bestPortal == M_MAX_UNSIGNED)
+        return listenerPosition + (sourcePosition - listenerPosition).Normalized() * M_LARGE_VALUE;
+
+    Vector3 direction = portalPositions_[bestPortal] - listenerPosition;
+    if (direction.LengthSquared() < M_EPSILON)
+        direction = sourcePosition - listenerPosition;
+    return listenerPosition + direction.Normalized() * bestLength;
+}
+
+unsigned SoundPropagation::GetRoomIndex(const Vector3& point, unsigned hint) const
+{
+    if (hint < rooms_.Size() && rooms_[hint]->IsInside(point))
+        return hint;
+
+    for (unsigned i = 0; i < rooms_.Size(); ++i)
+    {
+        if (rooms_[i]->IsInside(point))
+            return i;
+    }
+
+    return M_MAX_UNSIGNED;
+}
+
+void SoundPropagation::Rebuild()
+{
+    URHO3D_PROFILE(RebuildSoundPropagation);
+
+    unsigned numPortals = portals_.Size();
+    HashMap<SoundRoom*, unsigned> roomIndices;
+    for (unsigned i = 0; i < rooms_.Size(); ++i)
+        roomIndices[rooms_[i]] = i;
+
+    portalPositions_.Resize(numPortals);
+    roomPortals_.Clear();
+    roomPortals_.Resize(rooms_.Size());
+
+    for (unsigned i = 0; i < numPortals; ++i)
+    {
+        SoundPortal* portal = portals_[i];
+        portalPositions_[i] = portal->GetNode()->GetWorldPosition();
+        if (!portal->IsOpen())
+            continue;
+
+        HashMap<SoundRoom*, unsigned>::ConstIterator roomA = roomIndices.Find(portal->GetRoomA());
+        HashMap<SoundRoom*, unsigned>::ConstIterator roomB = roomIndices.Find(portal->GetRoomB());
+        if (roomA != roomIndices.End() && roomB != roomIndices.End())
+        {
+            roomPortals_[roomA->second_].Push(i);
+            roomPortals_[roomB->second_].Push(i);
+        }
+    }
+
+    // Open portals sharing a room are connected through it in a straight line
+    portalDistances_.Resize(numPortals * numPortals);
+    for (unsigned i = 0; i < portalDistances_.Size(); ++i)
+        portalDistances_[i] = M_INFINITY;
+    for (unsigned i = 0; i < numPortals; ++i)
+        portalDistances_[i * numPortals + i] = 0.0f;
+
+    for (unsigned r = 0; r < roomPortals_.Size(); ++r)
+    {
+        const PODVector<unsigned>& portals = roomPortals_[r];
+        for (unsigned i = 0; i < portals.Size(); ++i)
+        {
+            for (unsigned j = i + 1; j < portals.Size(); ++j)
+            {
+                unsigned a = portals[i];
+                unsigned b = portals[j];
+                float distance = Min((portalPositions_[a] - portalPositions_[b]).Length(), portalDistances_[a * numPortals + b]);
+                portalDistances_[a * numPortals + b] = distance;
+                portalDistances_[b * numPortals + a] = distance;
+            }
+        }
+    }
+
+    // Floyd-Warshall; portal counts of indoor levels keep the cubic cost small, and it only runs when a portal opens or closes
+    for (unsigned k = 0; k < numPortals; ++k)
+    {
+        for (unsigned i = 0; i < numPortals; ++i)
+        {
+            float ik = portalDistances_[i * numPortals + k];
+            if (ik == M_INFINITY)
+                continue;
+            for (unsigned j = 0; j < numPortals; ++j)
+            {
+                float distance = ik + portalDistances_[k * numPortals + j];
+                if (distance < portalDistances_[i * numPortals + j])
+                    portalDistances_[i * numPortals + j] = distance;
+            }
+        }
+    }
+
+    pathCache_.Clear();
+    listenerRoom_ = M_MAX_UNSIGNED;
+    listenerPosition_ = INVALID_POSITION;
+    dirty_ = false;
+}
+
+const PODVector<SoundPortalPath>& SoundPropagation::GetPaths(unsigned listenerRoom, unsigned sourceRoom)
+{
+    unsigned key = listenerRoom * rooms_.Size() + sourceRoom;
+    HashMap<unsigned, PODVector<SoundPortalPath> >::ConstIterator i = pathCache_.Find(key);
+    if (i != pathCache_.End())
+        return i->second_;
+
+    // Keep every reachable portal pair; the best one depends on where the listener and source stand in their rooms
+    unsigned numPortals = portals_.Size();
+    PODVector<SoundPortalPath>& paths = pathCache_[key];
+    const PODVector<unsigned>& listenerPortals = roomPortals_[listenerRoom];
+    const PODVector<unsigned>& sourcePortals = roomPortals_[sourceRoom];
+    for (unsigned j = 0; j < listenerPortals.Size(); ++j)
+    {
+        for (unsigned k = 0; k < sourcePortals.Size(); ++k)
+        {
+            float distance = portalDistances_[listenerPortals[j] * numPortals + sourcePortals[k]];
+            if (distance < M_INFINITY)
+            {
+                SoundPortalPath path;
+                path.listenerPortal_ = listenerPortals[j];
+                path.sourcePortal_ = sourcePortals[k];
+                path.distance_ = distance;
+                paths.Push(path);
+            }
+        }
+    }
+
+    return paths;
+}
+
+}
@@ -0,0 +1,110 @@
+//
+// Copyright (c) 2008-2016 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../Container/HashMap.h"
+#include "../Scene/Component.h"
+
+namespace Urho3D
+{
+
+class SoundPortal;
+class SoundRoom;
+
+/// Path between two rooms through a pair of portals.
+struct SoundPortalPath
+{
+    /// Portal leaving the listener's room.
+    unsigned listenerPortal_;
+    /// Portal leaving the source's room.
+    unsigned sourcePortal_;
+    /// Shortest distance between the two portals through open portals.
+    float distance_;
+};
+
+/// %Sound propagation graph scene component, created automatically by the first sound room or portal. Precomputes shortest paths between portals and caches the candidate paths of each listener and source room pair, so that a source in another room is placed at its apparent position with a table lookup. Rooms and portals are assumed static; paths are rebuilt only when the graph changes or a portal opens or closes.
+class URHO3D_API SoundPropagation : public Component
+{
+    URHO3D_OBJECT(SoundPropagation, Component);
+
+public:
+    /// Construct.
+    SoundPropagation(Context* context);
+    /// Destruct.
+    virtual ~SoundPropagation();
+    /// Register object factory.
+    static void RegisterObject(Context* context);
+
+    /// Add a room. Called by SoundRoom.
+    void AddRoom(SoundRoom* room);
+    /// Remove a room. Called by SoundRoom.
+    void RemoveRoom(SoundRoom* room);
+    /// Add a portal. Called by SoundPortal.
+    void AddPortal(SoundPortal* portal);
+    /// Remove a portal. Called by SoundPortal.
+    void RemovePortal(SoundPortal* portal);
+    /// Invalidate the precomputed paths, e.g. when a portal opens or closes.
+    void MarkDirty() { dirty_ = true; }
+
+    /// Return the position a source should be heard from: in the direction of the first portal on the shortest open path, at the path length, so that distance attenuation follows the path. Sources in the listener's room or outside all rooms are heard directly; unreachable sources are placed out of hearing range. The room hint is updated to speed up the next query.
+    Vector3 GetApparentPosition(const Vector3& listenerPosition, const Vector3& sourcePosition, unsigned& sourceRoomHint);
+    /// Return index of the room containing a point, or M_MAX_UNSIGNED if none. A hint room is tested first.
+    unsigned GetRoomIndex(const Vector3& point, unsigned hint = M_MAX_UNSIGNED) const;
+
+    /// Return number of rooms.
+    unsigned GetNumRooms() const { return rooms_.Size(); }
+
+    /// Return room index of the listener at the last apparent position query, or M_MAX_UNSIGNED if outside all rooms.
+    unsigned GetListenerRoom() const { return listenerRoom_; }
+
+    /// Return number of portals.
+    unsigned GetNumPortals() const { return portals_.Size(); }
+
+private:
+    /// Rebuild portal positions, adjacency and shortest portal distances.
+    void Rebuild();
+    /// Return the cached candidate paths between two rooms, finding them on first use.
+    const PODVector<SoundPortalPath>& GetPaths(unsigned listenerRoom, unsigned sourceRoom);
+
+    /// Rooms.
+    PODVector<SoundRoom*> rooms_;
+    /// Portals.
+    PODVector<SoundPortal*> portals_;
+    /// Portal world positions.
+    PODVector<Vector3> portalPositions_;
+    /// Open portals of each room.
+    Vector<PODVector<unsigned> > roomPortals_;
+    /// Shortest distances between portals, row-major.
+    PODVector<float> portalDistances_;
+    /// Candidate paths by listener and source room pair.
+    HashMap<unsigned, PODVector<SoundPortalPath> > pathCache_;
+    /// Room of the last queried listener position.
+    unsigned listenerRoom_;
+    /// Last queried listener position.
+    Vector3 listenerPosition_;
+    /// Rebuild needed flag.
+    bool dirty_;
+};
+
+}
@@ -0,0 +1,103 @@
+//
+// Copyright (c) 2008-2016 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "../Precompiled.h"
+
+#include "../Audio/SoundPropagation.h"
+#include "../Audio/SoundRoom.h"
+#include "../Core/Context.h"
+#include "../Graphics/DebugRenderer.h"
+#include "../Scene/Node.h"
+#include "../Scene/Scene.h"
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+static const Vector3 DEFAULT_ROOM_SIZE(10.0f, 4.0f, 10.0f);
+static const Color ROOM_COLOR(0.0f, 1.0f, 0.5f);
+
+extern const char* AUDIO_CATEGORY;
+
+SoundRoom::SoundRoom(Context* context) :
+    Component(context),
+    size_(DEFAULT_ROOM_SIZE)
+{
+}
+
+SoundRoom::~SoundRoom()
+{
+    if (propagation_)
+        propagation_->RemoveRoom(this);
+}
+
+void SoundRoom::RegisterObject(Context* context)
+{
+    context->RegisterFactory<SoundRoom>(AUDIO_CATEGORY);
+
+    URHO3D_ACCESSOR_ATTRIBUTE("Size", GetSize, SetSize, Vector3, DEFAULT_ROOM_SIZE, AM_DEFAULT);
+}
+
+void SoundRoom::DrawDebugGeometry(DebugRenderer* debug, bool depthTest)
+{
+    if (!debug || !node_)
+        return;
+
+    Vector3 halfSize = size_ * 0.5f;
+    debug->AddBoundingBox(BoundingBox(-halfSize, halfSize), node_->GetWorldTransform(), ROOM_COLOR, depthTest);
+}
+
+void SoundRoom::SetSize(const Vector3& size)
+{
+    size_ = Vector3(Max(size.x_, 0.0f), Max(size.y_, 0.0f), Max(size.z_, 0.0f));
+    MarkNetworkUpdate();
+}
+
+bool SoundRoom::IsInside(const Vector3& point) const
+{
+    if (!node_)
+        return false;
+
+    Vector3 local = node_->GetWorldTransform().Inverse() * point;
+    Vector3 halfSize = size_ * 0.5f;
+    return Abs(local.x_) <= halfSize.x_ && Abs(local.y_) <= halfSize.y_ && Abs(local.z_) <= halfSize.z_;
+}
+
+void SoundRoom::OnSceneSet(Scene* scene)
+{
+    if (propagation_)
+    {
+        propagation_->RemoveRoom(this);
+        propagation_.Reset();
+    }
+
+    if (scene)
+    {
+        // Every peer builds its own propagation graph from the replicated rooms and portals
+        propagation_ = scene->GetOrCreateComponent<SoundPropagation>(LOCAL);
+        propagation_->AddRoom(this);
+    }
+}
+
+}
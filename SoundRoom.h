@@ -0,0 +1,69 @@
+//
+// Copyright (c) 2008-2016 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../Scene/Component.h"
+
+namespace Urho3D
+{
+
+class SoundPropagation;
+
+/// %Sound propagation room component. Defines a box-shaped room, centered on and oriented with its scene node, that sound portals connect to others.
+class URHO3D_API SoundRoom : public Component
+{
+    URHO3D_OBJECT(SoundRoom, Component);
+
+public:
+    /// Construct.
+    SoundRoom(Context* context);
+    /// Destruct.
+    virtual ~SoundRoom();
+    /// Register object factory.
+    static void RegisterObject(Context* context);
+
+    /// Visualize the component as debug geometry.
+    virtual void DrawDebugGeometry(DebugRenderer* debug, bool depthTest);
+
+    /// Set room size in node space.
+    void SetSize(const Vector3& size);
+
+    /// Return room size in node space.
+    const Vector3& GetSize() const { return size_; }
+
+    /// Return whether a world space point is inside the room.
+    bool IsInside(const Vector3& point) const;
+
+protected:
+    /// Handle scene being assigned.
+    virtual void OnSceneSet(Scene* scene);
+
+private:
+    /// Room size.
+    Vector3 size_;
+    /// Propagation graph the room belongs to.
+    WeakPtr<SoundPropagation> propagation_;
+};
+
+}
@@ -24,16 +24,19 @@
 
 #include "../Audio/Audio.h"
 #include "../Audio/AudioEvents.h"
+#include "../Audio/AudioTrace.h"
 #include "../Audio/Sound.h"
+#include "../Audio/SoundEvent.h"
 #include "../Audio/SoundSource.h"
 #include "../Audio/SoundStream.h"
 #include "../Core/Context.h"
+#include "../Core/Timer.h"
 #include "../IO/Log.h"
 #include "../Resource/ResourceCache.h"
+#include "../Resource/ResourceEvents.h"
 #include "../Scene/Node.h"
 #include "../Scene/ReplicationState.h"
 #include "soloud.h"
-#include "soloud_speech.h"
 #include "soloud_wav.h"
 
 #include "../DebugNew.h"
@@ -46,8 +49,17 @@ static const float AUTOREMOVE_DELAY = 0.25f;
 
 static const int STREAM_SAFETY_SAMPLES = 4;
 
+static const float FREQUENCY_QUANTUM = 1.0f;
+static const float GAIN_QUANTUM = 1.0f / 128.0f;
+static const float ATTENUATION_QUANTUM = 1.0f / 128.0f;
+static const float PANNING_QUANTUM = 1.0f / 64.0f;
+
 extern const char* AUDIO_CATEGORY;
 
+static inline float Quantize(float value, float quantum)
+{
+    return Round(value / quantum) * quantum;
+}
 
 SoundSource::SoundSource(Context* context) :
     Component(context),
@@ -56,16 +68,27 @@ SoundSource::SoundSource(Context* context) :
     gain_(1.0f),
     attenuation_(1.0f),
     panning_(0.0f),
+    pitch_(1.0f),
+    voiceGainScale_(1.0f),
+    voicePitchScale_(1.0f),
+    voiceGain_(1.0f),
+    voicePanning_(0.0f),
     autoRemoveTimer_(0.0f),
     autoRemove_(false),
     sendFinishedEvent_(false),
-    position_(0),
-    fractPosition_(0),
-    timePosition_(0.0f),
+    skippedTime_(0.0f),
+    updateKey_(0),
+    eventGain_(1.0f),
+    pendingPosition_(0.0f),
+    startAudioTime_(-1.0),
+    playOnLoad_(false),
+    startTime_(-1.0),
+    stopTime_(-1.0),
+    queuedTime_(0),
+    queued_(false),
     unusedStreamSize_(0),
 	handle_(0)
 {
-	URHO3D_LOGINFO("SoundSource");
 	audio_ = GetSubsystem<Audio>();
 
     if (audio_)
@@ -78,11 +101,11 @@ SoundSource::SoundSource(Context* context) :
 
 SoundSource::~SoundSource()
 {
-	SoLoud::Soloud* soloud = audio_->GetSoLoud();
-	soloud->stop(handle_);
-
 	if (audio_)
+    {
+        audio_->GetSoLoud()->stop(handle_);
         audio_->RemoveSoundSource(this);
+    }
 }
 
 void SoundSource::RegisterObject(Context* context)
@@ -92,34 +115,29 @@ void SoundSource::RegisterObject(Context* context)
     URHO3D_ACCESSOR_ATTRIBUTE("Is Enabled", IsEnabled, SetEnabled, bool, true, AM_DEFAULT);
     URHO3D_MIXED_ACCESSOR_ATTRIBUTE("Sound", GetSoundAttr, SetSoundAttr, ResourceRef, ResourceRef(Sound::GetTypeStatic()), AM_DEFAULT);
     URHO3D_MIXED_ACCESSOR_ATTRIBUTE("Type", GetSoundType, SetSoundType, String, SOUND_EFFECT, AM_DEFAULT);
-    URHO3D_ATTRIBUTE("Frequency", float, frequency_, 0.0f, AM_DEFAULT);
-    URHO3D_ATTRIBUTE("Gain", float, gain_, 1.0f, AM_DEFAULT);
-    URHO3D_ATTRIBUTE("Attenuation", float, attenuation_, 1.0f, AM_DEFAULT);
-    URHO3D_ATTRIBUTE("Panning", float, panning_, 0.0f, AM_DEFAULT);
-    URHO3D_ACCESSOR_ATTRIBUTE("Is Playing", IsPlaying, SetPlayingAttr, bool, false, AM_DEFAULT);
+    URHO3D_ATTRIBUTE("Frequency", float, frequency_, 0.0f, AM_FILE);
+    URHO3D_ATTRIBUTE("Gain", float, gain_, 1.0f, AM_FILE);
+    URHO3D_ATTRIBUTE("Attenuation", float, attenuation_, 1.0f, AM_FILE);
+    URHO3D_ATTRIBUTE("Panning", float, panning_, 0.0f, AM_FILE);
+    URHO3D_ACCESSOR_ATTRIBUTE("Is Playing", IsPlaying, SetPlayingAttr, bool, false, AM_FILE);
     URHO3D_ATTRIBUTE("Autoremove on Stop", bool, autoRemove_, false, AM_FILE);
     URHO3D_ACCESSOR_ATTRIBUTE("Play Position", GetPositionAttr, SetPositionAttr, int, 0, AM_FILE);
+    // Continuous values are replicated quantized as latest data, and playback as compact play events
+    URHO3D_ACCESSOR_ATTRIBUTE("Network Frequency", GetNetFrequencyAttr, SetFrequency, float, 0.0f, AM_NET | AM_LATESTDATA | AM_NOEDIT);
+    URHO3D_ACCESSOR_ATTRIBUTE("Network Gain", GetNetGainAttr, SetGain, float, 1.0f, AM_NET | AM_LATESTDATA | AM_NOEDIT);
+    URHO3D_ACCESSOR_ATTRIBUTE("Network Attenuation", GetNetAttenuationAttr, SetAttenuation, float, 1.0f, AM_NET | AM_LATESTDATA | AM_NOEDIT);
+    URHO3D_ACCESSOR_ATTRIBUTE("Network Panning", GetNetPanningAttr, SetPanning, float, 0.0f, AM_NET | AM_LATESTDATA | AM_NOEDIT);
+    URHO3D_MIXED_ACCESSOR_ATTRIBUTE("Play Event", GetPlayEventAttr, SetPlayEventAttr, IntVector2, IntVector2::ZERO, AM_NET | AM_NOEDIT);
 }
 
 void SoundSource::Play(Sound* sound)
 {
-	MarkNetworkUpdate();
-	if (sound!=NULL)
-	{
-		SoLoud::Soloud* soloud = audio_->GetSoLoud();
-	
-		// Play the sound source (we could do this several times if we wanted)
-		SoLoud::Wav *wav = sound->GetWav();
-		if (wav != NULL)
-		{
-			handle_ = soloud->play(*wav);
-			soloud->setLooping(handle_, sound->IsLooped());
-			//soloud->setVolume(handle_, 0.0f);
-			URHO3D_LOGINFO("SoLoud Play: " + String(handle_));
-		}
-	} else {
-		URHO3D_LOGERROR("Unable to play sound, it is NULL");
-	}
+    eventGain_ = 1.0f;
+    voicePitchScale_ = 1.0f;
+    StartPlayback(sound);
+
+    if (IsPlaying())
+        SendPlayEvent(true);
 }
 
 void SoundSource::Play(Sound* sound, float frequency)
@@ -143,11 +161,44 @@ void SoundSource::Play(Sound* sound, float frequency, float gain, float panning)
     Play(sound);
 }
 
+void SoundSource::Play(SoundEvent* event, StringHash switchValue)
+{
+    SoundEventResult result;
+    if (!event || !event->Resolve(switchValue, result))
+        return;
+
+    // The randomization scales this voice only; the gain and pitch attributes keep their values
+    eventGain_ = result.gain_;
+    voicePitchScale_ = result.pitch_;
+    StartPlayback(result.sound_);
+
+    if (IsPlaying())
+        SendPlayEvent(true);
+}
+
+void SoundSource::PlayAt(Sound* sound, double audioTime)
+{
+    if (!audio_)
+        return;
+
+    if (audio_->IsHeadless())
+    {
+        Play(sound);
+        if (IsPlaying())
+            startTime_ = Max(startTime_, audioTime);
+        return;
+    }
+
+    // The voice is created paused without the audio mutex; StartPlayback delays it to the clock time as it unpauses
+    startAudioTime_ = audioTime;
+    Play(sound);
+    startAudioTime_ = -1.0;
+}
 
 void SoundSource::Stop()
 {
-	SoLoud::Soloud* soloud = audio_->GetSoLoud();
-	soloud->stop(handle_);
+    StopPlayback();
+    SendPlayEvent(false);
 }
 
 void SoundSource::SetSoundType(const String& type)
@@ -164,26 +215,34 @@ void SoundSource::SetSoundType(const String& type)
 
 void SoundSource::SetFrequency(float frequency)
 {
+    float oldValue = GetNetFrequencyAttr();
     frequency_ = Clamp(frequency, 0.0f, 535232.0f);
-    MarkNetworkUpdate();
+    if (GetNetFrequencyAttr() != oldValue)
+        MarkNetworkUpdate();
 }
 
 void SoundSource::SetGain(float gain)
 {
+    float oldValue = GetNetGainAttr();
     gain_ = Max(gain, 0.0f);
-    MarkNetworkUpdate();
+    if (GetNetGainAttr() != oldValue)
+        MarkNetworkUpdate();
 }
 
 void SoundSource::SetAttenuation(float attenuation)
 {
+    float oldValue = GetNetAttenuationAttr();
     attenuation_ = Clamp(attenuation, 0.0f, 1.0f);
-    MarkNetworkUpdate();
+    if (GetNetAttenuationAttr() != oldValue)
+        MarkNetworkUpdate();
 }
 
 void SoundSource::SetPanning(float panning)
 {
+    float oldValue = GetNetPanningAttr();
     panning_ = Clamp(panning, -1.0f, 1.0f);
-    MarkNetworkUpdate();
+    if (GetNetPanningAttr() != oldValue)
+        MarkNetworkUpdate();
 }
 
 void SoundSource::SetAutoRemove(bool enable)
@@ -194,29 +253,169 @@ void SoundSource::SetAutoRemove(bool enable)
     autoRemove_ = enable;
 }
 
+void SoundSource::FadeGain(float targetGain, float time)
+{
+    SetGain(targetGain);
+
+    if (IsPlaying() && !audio_->IsHeadless())
+        FadeVoiceGain(gain_, time);
+    voiceGain_ = gain_;
+}
+
+void SoundSource::FadePitch(float targetPitch, float time)
+{
+    pitch_ = Max(targetPitch, M_EPSILON);
+
+    if (IsPlaying() && !audio_->IsHeadless())
+        FadeVoicePitch(GetVoicePitch(), time);
+}
+
+void SoundSource::FadePanning(float targetPanning, float time)
+{
+    SetPanning(targetPanning);
+
+    if (IsPlaying() && !audio_->IsHeadless())
+        audio_->GetSoLoud()->fadePan(handle_, panning_, time);
+    voicePanning_ = panning_;
+}
+
+void SoundSource::FadeOutAndStop(float time)
+{
+    if (!IsPlaying())
+        return;
+
+    if (audio_->IsHeadless())
+    {
+        stopTime_ = audio_->GetHeadlessTime() + Max(time, 0.0f);
+        return;
+    }
+
+    // The voice stops itself when the fade completes; the stop is not replicated until then
+    SoLoud::Soloud* soloud = audio_->GetSoLoud();
+    FadeVoiceGain(0.0f, time);
+    soloud->scheduleStop(handle_, time);
+    voiceGain_ = gain_;
+}
+
 bool SoundSource::IsPlaying() const
 {
+    if (!audio_)
+        return false;
+
+    // Without voices, playback is tracked from the sound duration
+    if (audio_->IsHeadless())
+    {
+        double time = audio_->GetHeadlessTime();
+        if (!sound_ || startTime_ < 0.0 || (stopTime_ >= 0.0 && time >= stopTime_))
+            return false;
+        return sound_->IsLooped() || time - startTime_ < sound_->GetLength();
+    }
+
+    // Queued plays count as playing for as long as the sound would have played
+    if (queued_)
+        return sound_ && (sound_->IsLooped() || GetQueuedTime() < sound_->GetLength());
+
 	SoLoud::Soloud* soloud = audio_->GetSoLoud();
 	return soloud->isValidVoiceHandle(handle_); //MUTEXES AND SHIT
 }
 
-void SoundSource::SetPlayPosition(signed char* pos)
+void SoundSource::SetPlayPosition(float time)
 {
+    if (!sound_ || !IsPlaying())
+        return;
+
+    float length = sound_->GetLength();
+    if (length > 0.0f && time >= length)
+    {
+        if (!sound_->IsLooped())
+        {
+            StopPlayback();
+            return;
+        }
+        time = fmodf(time, length);
+    }
 
+    // Compressed and streamed sounds seek through their page table, decoded sounds seek directly
+    if (audio_->IsHeadless())
+        startTime_ = audio_->GetHeadlessTime() - Max(time, 0.0f);
+    else
+        audio_->GetSoLoud()->seek(handle_, Max(time, 0.0f));
 }
 
-void SoundSource::Update(float timeStep)
+float SoundSource::GetTimePosition() const
 {
-	
-	//if (handle_ == NULL) URHO3D_LOGINFO("BAM!1111");
-	SoLoud::Soloud* soloud = audio_->GetSoLoud();
-	//if (soloud->isValidVoiceHandle(handle_))
-	soloud->setVolume(handle_, gain_);
+    if (!sound_ || !IsPlaying())
+        return 0.0f;
+
+    float time = audio_->IsHeadless() ? (float)(audio_->GetHeadlessTime() - startTime_) :
+        (float)audio_->GetSoLoud()->getStreamTime(handle_);
+    float length = sound_->GetLength();
+    return length > 0.0f ? fmodf(time, length) : time;
 }
 
-void SoundSource::Mix(int* dest, unsigned samples, int mixRate, bool stereo, bool interpolation)
+void SoundSource::Update(float timeStep)
 {
+    if (!audio_)
+        return;
+
+    bool playing = IsPlaying();
+
+    if (!playing && sendFinishedEvent_)
+    {
+        sendFinishedEvent_ = false;
+
+        // Make a weak pointer to self to check for destruction during event handling
+        WeakPtr<SoundSource> self(this);
+
+        using namespace SoundFinished;
+
+        VariantMap& eventData = context_->GetEventDataMap();
+        eventData[P_NODE] = node_;
+        eventData[P_SOUNDSOURCE] = this;
+        eventData[P_SOUND] = sound_;
+
+        if (node_)
+            node_->SendEvent(E_SOUNDFINISHED, eventData);
+        else
+            SendEvent(E_SOUNDFINISHED, eventData);
 
+        if (self.Expired())
+            return;
+    }
+
+    // Check for autoremove
+    if (autoRemove_)
+    {
+        if (!playing)
+        {
+            autoRemoveTimer_ += timeStep;
+            if (autoRemoveTimer_ > AUTOREMOVE_DELAY)
+            {
+                Remove();
+                // Note: this object is now deleted, so only returning immediately is safe
+                return;
+            }
+        }
+        else
+            autoRemoveTimer_ = 0.0f;
+    }
+
+    if (!playing || audio_->IsHeadless())
+        return;
+
+	SoLoud::Soloud* soloud = audio_->GetSoLoud();
+
+	// Push changed values only; fades in progress keep running in the mixer until a new value is set
+	if (gain_ != voiceGain_)
+	{
+		soloud->setVolume(handle_, GetVoiceGain());
+		voiceGain_ = gain_;
+	}
+	if (panning_ != voicePanning_)
+	{
+		soloud->setPan(handle_, panning_);
+		voicePanning_ = panning_;
+	}
 }
 
 void SoundSource::UpdateMasterGain()
@@ -227,22 +426,35 @@ void SoundSource::UpdateMasterGain()
 
 void SoundSource::SetSoundAttr(const ResourceRef& value)
 {
-	URHO3D_LOGDEBUG("SetSoundAttr");
-	ResourceCache* cache = GetSubsystem<ResourceCache>();
-	Sound* newSound = cache->GetResource<Sound>(value.name_);
-	sound_ = newSound;
+    ResourceCache* cache = GetSubsystem<ResourceCache>();
 
-	if (IsPlaying())
-	{
-		Stop();
-		Play(newSound);
-	}
-	URHO3D_LOGDEBUG("Done_SetSoundAttr");
+    // Wait for a sound that is being prewarmed instead of loading it synchronously. The name is matched against the
+    // loaded event in the sanitized form the cache reports
+    if (audio_ && audio_->IsSoundPrewarming(value.name_))
+    {
+        pendingSound_ = cache->SanitateResourceName(value.name_);
+        SubscribeToEvent(E_RESOURCEBACKGROUNDLOADED, URHO3D_HANDLER(SoundSource, HandleSoundLoaded));
+        return;
+    }
+
+    if (!pendingSound_.Empty())
+    {
+        pendingSound_.Clear();
+        playOnLoad_ = false;
+        UnsubscribeFromEvent(E_RESOURCEBACKGROUNDLOADED);
+    }
+
+	ApplySound(cache->GetResource<Sound>(value.name_));
 }
 
 void SoundSource::SetPlayingAttr(bool value)
 {
-	URHO3D_LOGDEBUG("SetPlayingAttr");
+    if (!pendingSound_.Empty())
+    {
+        playOnLoad_ = value;
+        return;
+    }
+
 	if (value)
     {
         if (!IsPlaying())
@@ -250,25 +462,237 @@ void SoundSource::SetPlayingAttr(bool value)
     }
     else
         Stop();
-	URHO3D_LOGDEBUG("done_SetPlayingAttr");
 }
 
 void SoundSource::SetPositionAttr(int value)
 {
-  //  if (sound_)
-   //     SetPlayPosition(sound_->GetStart() + value);
+    // A stopped source only keeps the position for a play waiting on its sound to load; a later unrelated play starts from the beginning
+    if (IsPlaying())
+        SetPlayPosition(value * 0.001f);
+    else if (playOnLoad_)
+        pendingPosition_ = value * 0.001f;
+}
+
+void SoundSource::SetPlayEventAttr(const IntVector2& value)
+{
+    // Resends of the same event, e.g. along with other changed attributes, are ignored
+    if (value.x_ == playEvent_.x_)
+        return;
+
+    playEvent_ = IntVector2(value.x_, value.y_ >= 0 ? value.y_ : -1);
+    if (value.y_ >= 0)
+    {
+        // Start from the position the server's playback started from
+        pendingPosition_ = value.y_ * 0.000001f;
+        StartPlayback(sound_);
+    }
+    else
+        StopPlayback();
+}
+
+IntVector2 SoundSource::GetPlayEventAttr() const
+{
+    return playEvent_;
 }
 
 ResourceRef SoundSource::GetSoundAttr() const
 {
+    if (!pendingSound_.Empty())
+        return ResourceRef(Sound::GetTypeStatic(), pendingSound_);
+
     return GetResourceRef(sound_, Sound::GetTypeStatic());
 }
 
 int SoundSource::GetPositionAttr() const
 {
+    return (int)(GetTimePosition() * 1000.0f);
+}
 
-        return 0;
+float SoundSource::GetNetFrequencyAttr() const
+{
+    return Quantize(frequency_, FREQUENCY_QUANTUM);
+}
+
+float SoundSource::GetNetGainAttr() const
+{
+    return Quantize(gain_, GAIN_QUANTUM);
+}
+
+float SoundSource::GetNetAttenuationAttr() const
+{
+    return Quantize(attenuation_, ATTENUATION_QUANTUM);
+}
+
+float SoundSource::GetNetPanningAttr() const
+{
+    return Quantize(panning_, PANNING_QUANTUM);
+}
 
+unsigned SoundSource::StartVoice(Sound* sound)
+{
+	SoLoud::Soloud* soloud = audio_->GetSoLoud();
+
+	// Start paused; StartPlayback unpauses once the voice is set up
+	SoLoud::AudioSource* source = sound->GetAudioSource();
+	unsigned handle = soloud->play(*source, GetVoiceGain(), panning_, true);
+	soloud->setLooping(handle, sound->IsLooped());
+	URHO3D_AUDIO_TRACE(TRACE_PLAY, handle, GetVoiceGain());
+	return handle;
+}
+
+void SoundSource::FadeVoiceGain(float targetGain, float time)
+{
+    audio_->GetSoLoud()->fadeVolume(handle_, targetGain * voiceGainScale_, time);
+}
+
+void SoundSource::FadeVoicePitch(float targetPitch, float time)
+{
+    if (time > 0.0f)
+        audio_->GetSoLoud()->fadeRelativePlaySpeed(handle_, targetPitch, time);
+    else
+        audio_->GetSoLoud()->setRelativePlaySpeed(handle_, targetPitch);
+}
+
+void SoundSource::StartPlayback(Sound* sound)
+{
+    if (!sound)
+    {
+        URHO3D_LOGERROR("Unable to play sound, it is NULL");
+        return;
+    }
+
+    sound_ = sound;
+
+    if (audio_->IsHeadless())
+    {
+        // Dedicated servers only track the timeline; no voice is started
+        startTime_ = audio_->GetHeadlessTime() - pendingPosition_;
+        stopTime_ = -1.0;
+        pendingPosition_ = 0.0f;
+        sendFinishedEvent_ = true;
+        return;
+    }
+
+    // Until the device is ready the play is queued and tracked from the time it was requested
+    if (audio_->IsInitializing())
+    {
+        queued_ = true;
+        queuedTime_ = Time::GetSystemTime();
+        sendFinishedEvent_ = true;
+        return;
+    }
+
+    // The pending position applies to this start only, whether or not it succeeds
+    float position = pendingPosition_;
+    pendingPosition_ = 0.0f;
+
+    if (!sound->PrepareData())
+        return;
+
+    voiceGainScale_ = sound->GetLoudnessGain() * eventGain_;
+
+    // Set up the voice while it is paused, so that its first mixed block already has its speed and position. The audio
+    // mutex is not held: creating the instance may open and parse a file, and seeking decodes, which must not stall the mixer
+    handle_ = StartVoice(sound);
+    voiceGain_ = gain_;
+    voicePanning_ = panning_;
+    if (GetVoicePitch() != 1.0f)
+        FadeVoicePitch(GetVoicePitch(), 0.0f);
+    sendFinishedEvent_ = true;
+
+    if (position > 0.0f)
+        SetPlayPosition(position);
+
+    SoLoud::Soloud* soloud = audio_->GetSoLoud();
+    if (startAudioTime_ >= 0.0)
+    {
+        // Hold the audio mutex so that no block is mixed between reading the clock and delaying the voice
+        MutexLock lock(audio_->GetMutex());
+        double delay = (startAudioTime_ - audio_->GetAudioClock()) * audio_->GetMixRate();
+        if (delay >= 0.5)
+            soloud->setDelaySamples(handle_, (unsigned)(delay + 0.5));
+        soloud->setPause(handle_, false);
+    }
+    else
+        soloud->setPause(handle_, false);
+}
+
+void SoundSource::StopPlayback()
+{
+    startTime_ = -1.0;
+    stopTime_ = -1.0;
+    queued_ = false;
+    pendingPosition_ = 0.0f;
+
+	SoLoud::Soloud* soloud = audio_->GetSoLoud();
+	soloud->stop(handle_);
+	URHO3D_AUDIO_TRACE(TRACE_STOP, handle_, 0.0f);
+}
+
+void SoundSource::FinishQueuedPlayback(bool start)
+{
+    if (!queued_)
+        return;
+
+    queued_ = false;
+    if (!start || !sound_)
+        return;
+
+    // Loops continue in phase as if they had played while the device was opening. One-shots start late from the beginning, or not at all once they would have ended
+    float elapsed = GetQueuedTime();
+    float length = sound_->GetLength();
+    if (sound_->IsLooped())
+    {
+        if (length > 0.0f)
+            pendingPosition_ = fmodf(elapsed, length);
+    }
+    else if (elapsed >= length)
+        return;
+
+    StartPlayback(sound_);
+}
+
+float SoundSource::GetQueuedTime() const
+{
+    return (Time::GetSystemTime() - queuedTime_) * 0.001f + pendingPosition_;
+}
+
+void SoundSource::ApplySound(Sound* sound)
+{
+	sound_ = sound;
+
+	if (IsPlaying())
+	{
+		StopPlayback();
+		StartPlayback(sound);
+	}
+}
+
+void SoundSource::HandleSoundLoaded(StringHash eventType, VariantMap& eventData)
+{
+    using namespace ResourceBackgroundLoaded;
+
+    if (eventData[P_RESOURCENAME].GetString() != pendingSound_)
+        return;
+
+    pendingSound_.Clear();
+    UnsubscribeFromEvent(E_RESOURCEBACKGROUNDLOADED);
+
+    // A failed load leaves the sound empty like a failed synchronous load would
+    ApplySound(static_cast<Sound*>(eventData[P_RESOURCE].GetPtr()));
+    if (playOnLoad_)
+    {
+        playOnLoad_ = false;
+        SetPlayingAttr(true);
+    }
+}
+
+void SoundSource::SendPlayEvent(bool playing)
+{
+    // The start position is captured once, so that the event stays unchanged until the next play or stop
+    int position = playing ? (int)Min(GetTimePosition() * 1000000.0, (double)M_MAX_INT) : -1;
+    playEvent_ = IntVector2(playEvent_.x_ + 1, position);
+    MarkNetworkUpdate();
 }
 
 }
@@ -25,7 +25,6 @@
 #include "../Audio/AudioDefs.h"
 #include "../Scene/Component.h"
 #include "soloud.h"
-#include "soloud_speech.h"
 #include "soloud_wav.h"
 
 namespace Urho3D
@@ -33,6 +32,7 @@ namespace Urho3D
 
 class Audio;
 class Sound;
+class SoundEvent;
 class SoundStream;
 
 // Compressed audio decode buffer length in milliseconds
@@ -52,13 +52,17 @@ public:
     static void RegisterObject(Context* context);
 
     /// Play a sound.
-	virtual void Play(Sound* sound);
+    void Play(Sound* sound);
     /// Play a sound with specified frequency.
     void Play(Sound* sound, float frequency);
     /// Play a sound with specified frequency and gain.
     void Play(Sound* sound, float frequency, float gain);
     /// Play a sound with specified frequency, gain and panning.
     void Play(Sound* sound, float frequency, float gain, float panning);
+    /// Play a sound event, resolving it to a sound with the switch value selecting children of switch containers. The event's gain and pitch multiply those of the source for this voice only.
+    void Play(SoundEvent* event, StringHash switchValue = StringHash::ZERO);
+    /// Play a sound starting exactly at a time on the audio clock (see Audio::GetAudioClock). Times in the past start immediately.
+    void PlayAt(Sound* sound, double audioTime);
     /// Start playing a sound stream.
     void Play(SoundStream* stream);
     /// Stop playback.
@@ -75,20 +79,25 @@ public:
     void SetPanning(float panning);
     /// \deprecated Set whether sound source will be automatically removed from the scene node when playback stops. Note: this is deprecated, consider subscribing to the SoundFinished event instead.
     URHO3D_DEPRECATED void SetAutoRemove(bool enable);
-    /// Set new playback position.
-    void SetPlayPosition(signed char* pos);
+    /// Set new playback position in seconds. Looped sounds wrap around, other sounds stop when seeking past the end.
+    void SetPlayPosition(float time);
+    /// Fade gain to a target value over time in seconds. The fade runs in the mixer and needs no further updates.
+    void FadeGain(float targetGain, float time);
+    /// Fade pitch (relative playback speed, 1.0 is unaltered) to a target value over time in seconds.
+    void FadePitch(float targetPitch, float time);
+    /// Fade stereo panning to a target value over time in seconds.
+    void FadePanning(float targetPanning, float time);
+    /// Fade out over time in seconds and stop. Gain is kept for the next play.
+    void FadeOutAndStop(float time);
 
     /// Return sound.
     Sound* GetSound() const { return sound_; }
 
-    /// Return playback position.
-    volatile signed char* GetPlayPosition() const { return position_; }
-
     /// Return sound type, determines the master gain group.
     String GetSoundType() const { return soundType_; }
 
-    /// Return playback time position.
-    float GetTimePosition() const { return timePosition_; }
+    /// Return playback time position in seconds.
+    float GetTimePosition() const;
 
     /// Return frequency.
     float GetFrequency() const { return frequency_; }
@@ -96,37 +105,83 @@ public:
     /// Return gain.
     float GetGain() const { return gain_; }
 
+    /// Return gain applied to the voice: the gain scaled by the playing sound's loudness normalization and sound event randomization.
+    float GetVoiceGain() const { return gain_ * voiceGainScale_; }
+
+    /// Return pitch applied to the voice before Doppler: the pitch scaled by sound event randomization.
+    float GetVoicePitch() const { return pitch_ * voicePitchScale_; }
+
     /// Return attenuation.
     float GetAttenuation() const { return attenuation_; }
 
     /// Return stereo panning.
     float GetPanning() const { return panning_; }
 
+    /// Return pitch as relative playback speed.
+    float GetPitch() const { return pitch_; }
+
     /// \deprecated Return autoremove mode.
     URHO3D_DEPRECATED bool GetAutoRemove() const { return autoRemove_; }
 
     /// Return whether is playing.
     bool IsPlaying() const;
 
+    /// Return SoLoud handle of the voice last started.
+    unsigned GetVoiceHandle() const { return handle_; }
+
     /// Update the sound source. Perform subclass specific operations. Called by Audio.
     virtual void Update(float timeStep);
-    /// Mix sound source output to a 32-bit clipping buffer. Called by Audio.
-    void Mix(int* dest, unsigned samples, int mixRate, bool stereo, bool interpolation);
+    /// Return squared distance to the listener for update tiering. Non-positional sources return zero and are updated every frame.
+    virtual float GetListenerDistanceSquared(const Vector3& listenerPosition) const { return 0.0f; }
+    /// Set the key that staggers tiered updates. Stays fixed while other sources come and go. Called by Audio.
+    void SetUpdateKey(unsigned key) { updateKey_ = key; }
+    /// Return the key that staggers tiered updates.
+    unsigned GetUpdateKey() const { return updateKey_; }
+    /// Defer the update to a later frame, accumulating the elapsed time. Called by Audio.
+    void SkipUpdate(float timeStep) { skippedTime_ += timeStep; }
+    /// Return and reset time accumulated by skipped updates. Called by Audio.
+    float ConsumeSkippedTime()
+    {
+        float time = skippedTime_;
+        skippedTime_ = 0.0f;
+        return time;
+    }
     /// Update the effective master gain. Called internally and by Audio when the master gain changes.
     void UpdateMasterGain();
 
     /// Set sound attribute.
     void SetSoundAttr(const ResourceRef& value);
-    /// Set sound position attribute.
+    /// Set sound position attribute in milliseconds.
     void SetPositionAttr(int value);
     /// Return sound attribute.
     ResourceRef GetSoundAttr() const;
     /// Set sound playing attribute
     void SetPlayingAttr(bool value);
-    /// Return sound position attribute.
+    /// Return sound position attribute in milliseconds.
     int GetPositionAttr() const;
+    /// Set play event attribute. Starts or stops playback when an event with a new sequence number is replicated.
+    void SetPlayEventAttr(const IntVector2& value);
+    /// Start playback queued while the audio device was opening, or drop it. Called by Audio.
+    virtual void FinishQueuedPlayback(bool start);
+    /// Return play event attribute: sequence number and the playback position in microseconds the event started from, or -1 for a stop.
+    IntVector2 GetPlayEventAttr() const;
+    /// Return frequency quantized for network replication.
+    float GetNetFrequencyAttr() const;
+    /// Return gain quantized for network replication.
+    float GetNetGainAttr() const;
+    /// Return attenuation quantized for network replication.
+    float GetNetAttenuationAttr() const;
+    /// Return stereo panning quantized for network replication.
+    float GetNetPanningAttr() const;
 
 protected:
+    /// Start a paused voice for the sound and return its handle. Called by StartPlayback, which unpauses the voice once it is set up.
+    virtual unsigned StartVoice(Sound* sound);
+    /// Fade the playing voice's gain to a target over time. Called by FadeGain and FadeOutAndStop.
+    virtual void FadeVoiceGain(float targetGain, float time);
+    /// Fade the playing voice's pitch to a target over time, or set it with zero time. Called by FadePitch and when playback starts.
+    virtual void FadeVoicePitch(float targetPitch, float time);
+
     /// Audio subsystem.
     SharedPtr<Audio> audio_;
     /// SoundSource type, determines the master gain group.
@@ -141,6 +196,16 @@ protected:
     float attenuation_;
     /// Stereo panning.
     float panning_;
+    /// Pitch as relative playback speed.
+    float pitch_;
+    /// Gain multiplier of the playing voice, from the cooked loudness normalization of its sound and the sound event it was played from.
+    float voiceGainScale_;
+    /// Pitch multiplier of the playing voice, from the sound event it was played from.
+    float voicePitchScale_;
+    /// Gain last applied to the voice. Updates push only changed values so that fades are not interrupted.
+    float voiceGain_;
+    /// Panning last applied to the voice.
+    float voicePanning_;
     /// Autoremove timer.
     float autoRemoveTimer_;
     /// Effective master gain.
@@ -149,28 +214,55 @@ protected:
     bool autoRemove_;
     /// Whether finished event should be sent on playback stop.
     bool sendFinishedEvent_;
+    /// Time accumulated by updates skipped by Audio.
+    float skippedTime_;
+    /// Key that staggers tiered updates.
+    unsigned updateKey_;
 
 	unsigned int handle_;
 
 private:
-   
+    /// Start playback without generating a play event.
+    void StartPlayback(Sound* sound);
+    /// Stop playback without generating a play event.
+    void StopPlayback();
+    /// Replicate a play or stop event.
+    void SendPlayEvent(bool playing);
+    /// Return seconds a queued play would have played.
+    float GetQueuedTime() const;
+    /// Apply a new sound, restarting playback if playing.
+    void ApplySound(Sound* sound);
+    /// Handle background loaded resource event for a sound waiting on a prewarm.
+    void HandleSoundLoaded(StringHash eventType, VariantMap& eventData);
+
     /// Sound that is being played.
     SharedPtr<Sound> sound_;
     /// Sound stream that is being played.
     SharedPtr<SoundStream> soundStream_;
-    /// Playback position.
-    volatile signed char* position_;
-    /// Playback fractional position.
-    volatile int fractPosition_;
-    /// Playback time position.
-    volatile float timePosition_;
+    /// Gain multiplier from the sound event resolved for the current voice.
+    float eventGain_;
+    /// Position in seconds to seek to when playback next starts.
+    float pendingPosition_;
+    /// Audio clock time in seconds the voice being started is delayed to, negative to start immediately. Set by PlayAt.
+    double startAudioTime_;
+    /// Name of a prewarming sound to apply once loaded.
+    String pendingSound_;
+    /// Whether to start playback once the pending sound has loaded.
+    bool playOnLoad_;
+    /// Headless mode playback start time, negative when stopped.
+    double startTime_;
+    /// Headless mode time of a stop scheduled by a fade out, negative when none.
+    double stopTime_;
+    /// System time in milliseconds when a play was queued.
+    unsigned queuedTime_;
+    /// Whether a play is queued until the audio device is ready.
+    bool queued_;
     /// Decode buffer.
     SharedPtr<Sound> streamBuffer_;
     /// Unused stream bytes from previous frame.
     int unusedStreamSize_;
-
-	//SoLoud::Speech speech;
-	
+    /// Last play event: sequence number, and the playback position in microseconds it started from or -1 when it stopped.
+    IntVector2 playEvent_;
 };
 
 }
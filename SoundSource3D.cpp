@@ -22,14 +22,18 @@
 
 #include "../Precompiled.h"
 
+#include "../Audio/AmbisonicBed.h"
 #include "../Audio/Audio.h"
+#include "../Audio/AudioTrace.h"
 #include "../Audio/Sound.h"
 #include "../Audio/SoundListener.h"
+#include "../Audio/SoundPropagation.h"
 #include "../Audio/SoundSource3D.h"
 #include "../IO/Log.h"
 #include "../Core/Context.h"
 #include "../Graphics/DebugRenderer.h"
 #include "../Scene/Node.h"
+#include "../Scene/Scene.h"
 
 #include "../IO/Log.h"
 
@@ -109,14 +113,33 @@ SoundSource3D::SoundSource3D(Context* context) :
     SoundSource(context),
     nearDistance_(DEFAULT_NEARDISTANCE),
     farDistance_(DEFAULT_FARDISTANCE),
-    rolloffFactor_(DEFAULT_ROLLOFF)
-
+    rolloffFactor_(DEFAULT_ROLLOFF),
+    clusterState_(CLUSTER_NONE),
+    clusterGain_(1.0f),
+    ambient_(false),
+    ambientEmitter_(0),
+    propagationRoom_(M_MAX_UNSIGNED),
+    listenerRoom_(M_MAX_UNSIGNED),
+    resetVelocity_(false),
+    voice3DSlot_(M_MAX_UNSIGNED),
+    fadeGain_(1.0f),
+    fadeTargetGain_(1.0f),
+    fadeSpeed_(0.0f),
+    fadePitch_(1.0f),
+    fadeTargetPitch_(1.0f),
+    pitchFadeSpeed_(0.0f)
 {
 	
     // Start from zero volume until attenuation properly calculated
     attenuation_ = 0.0f;
 }
 
+SoundSource3D::~SoundSource3D()
+{
+    RemoveAmbientEmitter();
+    RemoveVoice3D();
+}
+
 void SoundSource3D::RegisterObject(Context* context)
 {
     context->RegisterFactory<SoundSource3D>(AUDIO_CATEGORY);
@@ -125,9 +148,12 @@ void SoundSource3D::RegisterObject(Context* context)
     // Remove Attenuation and Panning as attribute as they are constantly being updated
     URHO3D_REMOVE_ATTRIBUTE("Attenuation");
     URHO3D_REMOVE_ATTRIBUTE("Panning");
+    URHO3D_REMOVE_ATTRIBUTE("Network Attenuation");
+    URHO3D_REMOVE_ATTRIBUTE("Network Panning");
     URHO3D_ATTRIBUTE("Near Distance", float, nearDistance_, DEFAULT_NEARDISTANCE, AM_DEFAULT);
     URHO3D_ATTRIBUTE("Far Distance", float, farDistance_, DEFAULT_FARDISTANCE, AM_DEFAULT);
     URHO3D_ATTRIBUTE("Rolloff Factor", float, rolloffFactor_, DEFAULT_ROLLOFF, AM_DEFAULT);
+    URHO3D_ACCESSOR_ATTRIBUTE("Is Ambient", IsAmbient, SetAmbient, bool, false, AM_DEFAULT);
 }
 
 void SoundSource3D::DrawDebugGeometry(DebugRenderer* debug, bool depthTest)
@@ -145,77 +171,255 @@ void SoundSource3D::DrawDebugGeometry(DebugRenderer* debug, bool depthTest)
 	debug->AddSphere(Sphere(worldPosition, farDistance_), OUTER_COLOR, depthTest);
 }
 
-void SoundSource3D::Play(Sound* sound)
+unsigned SoundSource3D::StartVoice(Sound* sound)
 {
-	
-	MarkNetworkUpdate();
-	if (sound != NULL)
+	// A restarted source plays its own voice until Audio moves it into the ambisonic bed again
+	RemoveAmbientEmitter();
+	RemoveVoice3D();
+
+	SoLoud::Soloud* soloud = audio_->GetSoLoud();
+
+	// Start paused, so that the first mixed block already has the voice's attenuation, panning and Doppler. StartPlayback
+	// unpauses it once set up
+	SoLoud::AudioSource* source = sound->GetAudioSource();
+	unsigned handle = soloud->play(*source, 0.0f, 0.0f, true);
+	soloud->setLooping(handle, sound->IsLooped());
+
+	fadeGain_ = gain_;
+	fadeSpeed_ = 0.0f;
+	fadePitch_ = GetVoicePitch();
+	pitchFadeSpeed_ = 0.0f;
+	resetVelocity_ = false;
+	voice3DSlot_ = audio_->AddVoice3D(this, handle);
+	audio_->SetVoice3D(voice3DSlot_, GetPropagatedPosition(node_->GetWorldPosition()), 0.0f, GetVoiceGain(), GetVoicePitch(), nearDistance_,
+		farDistance_, rolloffFactor_);
+	audio_->Update3DVoices(voice3DSlot_, 1);
+
+	URHO3D_AUDIO_TRACE(TRACE_PLAY, handle, GetVoiceGain());
+	return handle;
+}
+
+
+void SoundSource3D::Update(float timeStep)
+{
+	// Muted cluster members need no updates until the cluster splits
+	if (clusterState_ == CLUSTER_MEMBER)
+		return;
+
+	// Follow gain changes and fades; the 3D voice block applies the gain together with distance attenuation
+	if (fadeSpeed_ > 0.0f)
 	{
-		
-		SoLoud::Soloud* soloud = audio_->GetSoLoud();
-
-		// Play the sound source (we could do this several times if we wanted)
-		
-		SoLoud::Wav *wav = sound->GetWav();
-		
-		wav->set3dAttenuator(&audio_->customAttenuator_);
-		
-		Vector3 p = node_->GetWorldPosition();
-		
-		handle_ = soloud->play3d(*wav, p.x_, p.y_, p.z_, 0.0f, 0.0f, 0.0f, 0.0f,false,0U);
-		soloud->setVolume(handle_, gain_);
-		//soloud->set3dSourcePosition(handle_ , p.x_ , p.y_ , p.z_);
-		
-		soloud->set3dSourceMinMaxDistance(handle_, nearDistance_, farDistance_);
-		soloud->set3dSourceAttenuation(handle_, 1, rolloffFactor_);
-		
-		//soloud->set3dSourceDopplerFactor(handle_, 50.0f);
-		soloud->setLooping(handle_, sound->IsLooped());
-		
-		URHO3D_LOGINFO("SoLoud Play3D: " + String(handle_) + " pos: " + String(p));
-		//soloud->update3dVoices((unsigned int *)&handle_, 1);
-		
+		float step = fadeSpeed_ * timeStep;
+		if (Abs(fadeTargetGain_ - fadeGain_) <= step)
+		{
+			fadeGain_ = fadeTargetGain_;
+			fadeSpeed_ = 0.0f;
+		}
+		else
+			fadeGain_ += fadeTargetGain_ > fadeGain_ ? step : -step;
 	}
-	else {
-		URHO3D_LOGERROR("Unable to play sound, it is NULL");
+	else if (gain_ != voiceGain_)
+		fadeGain_ = gain_;
+
+	if (pitchFadeSpeed_ > 0.0f)
+	{
+		float step = pitchFadeSpeed_ * timeStep;
+		if (Abs(fadeTargetPitch_ - fadePitch_) <= step)
+		{
+			fadePitch_ = fadeTargetPitch_;
+			pitchFadeSpeed_ = 0.0f;
+		}
+		else
+			fadePitch_ += fadeTargetPitch_ > fadePitch_ ? step : -step;
 	}
+	else
+		fadePitch_ = GetVoicePitch();
+
+	// Gain and panning reach the voice through the 3D voice block, so the base update must not push them
+	voiceGain_ = gain_;
+	voicePanning_ = panning_;
+
+	if (voice3DSlot_ != M_MAX_UNSIGNED && !IsPlaying())
+		RemoveVoice3D();
+
+	// Headless mode has no voices to position, and the ambisonic bed positions its own emitter
+	if (audio_->IsHeadless() || ambientEmitter_)
+	{
+		// Silence the bed emitter as soon as playback stops
+		if (ambientEmitter_ && !IsPlaying())
+			RemoveAmbientEmitter();
+		SoundSource::Update(timeStep);
+		return;
+	}
+
+	if (voice3DSlot_ != M_MAX_UNSIGNED)
+	{
+		if (clusterState_ == CLUSTER_LEADER)
+			audio_->SetVoice3D(voice3DSlot_, clusterPosition_, timeStep, clusterGain_, fadePitch_, nearDistance_, farDistance_, rolloffFactor_);
+		else
+			audio_->SetVoice3D(voice3DSlot_, GetPropagatedPosition(node_->GetWorldPosition()), timeStep, fadeGain_ * voiceGainScale_, fadePitch_,
+				nearDistance_, farDistance_, rolloffFactor_);
+
+		// The position jumped, so the difference to the previous one is not a velocity
+		if (resetVelocity_)
+		{
+			audio_->ResetVoice3DVelocity(voice3DSlot_);
+			resetVelocity_ = false;
+		}
+	}
+
+	if (clusterState_ != CLUSTER_LEADER)
+		SoundSource::Update(timeStep);
 }
 
+void SoundSource3D::SetClusterLeader(const Vector3& position, float gain)
+{
+    if (clusterState_ == CLUSTER_MEMBER)
+        audio_->GetSoLoud()->setPause(handle_, false);
 
-void SoundSource3D::Update(float timeStep)
+    clusterState_ = CLUSTER_LEADER;
+    clusterPosition_ = position;
+    clusterGain_ = gain;
+}
+
+void SoundSource3D::SetClusterMember()
 {
-	
-	SoLoud::Soloud* soloud = audio_->GetSoLoud();
-	Vector3 p = node_->GetWorldPosition();
-	soloud->set3dSourcePosition(handle_, p.x_, p.y_, p.z_);
-	
-	SoundSource::Update(timeStep);
+    if (clusterState_ != CLUSTER_MEMBER)
+        audio_->GetSoLoud()->setPause(handle_, true);
+
+    clusterState_ = CLUSTER_MEMBER;
+}
+
+void SoundSource3D::ClearCluster()
+{
+    if (clusterState_ == CLUSTER_MEMBER)
+        audio_->GetSoLoud()->setPause(handle_, false);
 
+    clusterState_ = CLUSTER_NONE;
+}
+
+void SoundSource3D::SetAmbientEmitter(AmbientEmitter* emitter)
+{
+    if (emitter && !ambientEmitter_)
+    {
+        ClearCluster();
+        audio_->GetSoLoud()->setPause(handle_, true);
+    }
+    else if (!emitter && ambientEmitter_)
+        audio_->GetSoLoud()->setPause(handle_, false);
+
+    ambientEmitter_ = emitter;
+}
+
+void SoundSource3D::RemoveAmbientEmitter()
+{
+    if (!ambientEmitter_ || !audio_)
+        return;
+
+    MutexLock lock(audio_->GetMutex());
+    audio_->GetAmbientBed()->RemoveEmitter(ambientEmitter_);
+    ambientEmitter_ = 0;
+}
+
+void SoundSource3D::RemoveVoice3D()
+{
+    if (voice3DSlot_ == M_MAX_UNSIGNED || !audio_)
+        return;
+
+    audio_->RemoveVoice3D(voice3DSlot_);
+    voice3DSlot_ = M_MAX_UNSIGNED;
+}
+
+void SoundSource3D::FadeVoiceGain(float targetGain, float time)
+{
+    // The 3D voice block owns the voice volume, so fade the gain it applies instead
+    fadeTargetGain_ = targetGain;
+    fadeSpeed_ = time > 0.0f ? Abs(targetGain - fadeGain_) / time : 0.0f;
+    if (fadeSpeed_ <= 0.0f)
+        fadeGain_ = targetGain;
+}
+
+void SoundSource3D::FadeVoicePitch(float targetPitch, float time)
+{
+    // Doppler is multiplied in by the 3D voice block, so fade the pitch it applies instead of the voice's speed
+    fadeTargetPitch_ = targetPitch;
+    pitchFadeSpeed_ = time > 0.0f ? Abs(targetPitch - fadePitch_) / time : 0.0f;
+    if (pitchFadeSpeed_ <= 0.0f)
+        fadePitch_ = targetPitch;
+}
+
+void SoundSource3D::SetAmbient(bool enable)
+{
+    ambient_ = enable;
+}
+
+Vector3 SoundSource3D::GetPropagatedPosition(const Vector3& position)
+{
+    Scene* scene = GetScene();
+    SoundPropagation* propagation = scene ? scene->GetComponent<SoundPropagation>() : 0;
+    SoundListener* listener = audio_->GetListener();
+    if (!propagation || !listener || !listener->GetNode())
+        return position;
+
+    unsigned sourceRoom = propagationRoom_;
+    Vector3 apparentPosition = propagation->GetApparentPosition(listener->GetNode()->GetWorldPosition(), position, propagationRoom_);
+
+    // Routing through different portals moves the apparent position discontinuously
+    if (propagationRoom_ != sourceRoom || propagation->GetListenerRoom() != listenerRoom_)
+    {
+        listenerRoom_ = propagation->GetListenerRoom();
+        resetVelocity_ = true;
+    }
+
+    return apparentPosition;
+}
+
+float SoundSource3D::GetListenerDistanceSquared(const Vector3& listenerPosition) const
+{
+    return node_ ? (node_->GetWorldPosition() - listenerPosition).LengthSquared() : 0.0f;
 }
 
 void SoundSource3D::SetDistanceAttenuation(float nearDistance, float farDistance, float rolloffFactor)
 {
-    nearDistance_ = Max(nearDistance, 0.0f);
-    farDistance_ = Max(farDistance, 0.0f);
-    rolloffFactor_ = Max(rolloffFactor, MIN_ROLLOFF);
+    nearDistance = Max(nearDistance, 0.0f);
+    farDistance = Max(farDistance, 0.0f);
+    rolloffFactor = Max(rolloffFactor, MIN_ROLLOFF);
+    if (nearDistance == nearDistance_ && farDistance == farDistance_ && rolloffFactor == rolloffFactor_)
+        return;
+
+    nearDistance_ = nearDistance;
+    farDistance_ = farDistance;
+    rolloffFactor_ = rolloffFactor;
     MarkNetworkUpdate();
 }
 
 void SoundSource3D::SetFarDistance(float distance)
 {
-    farDistance_ = Max(distance, 0.0f);
+    distance = Max(distance, 0.0f);
+    if (distance == farDistance_)
+        return;
+
+    farDistance_ = distance;
     MarkNetworkUpdate();
 }
 
 void SoundSource3D::SetNearDistance(float distance)
 {
-    nearDistance_ = Max(distance, 0.0f);
+    distance = Max(distance, 0.0f);
+    if (distance == nearDistance_)
+        return;
+
+    nearDistance_ = distance;
     MarkNetworkUpdate();
 }
 
 void SoundSource3D::SetRolloffFactor(float factor)
 {
-    rolloffFactor_ = Max(factor, MIN_ROLLOFF);
+    factor = Max(factor, MIN_ROLLOFF);
+    if (factor == rolloffFactor_)
+        return;
+
+    rolloffFactor_ = factor;
     MarkNetworkUpdate();
 }
 
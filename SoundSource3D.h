@@ -29,6 +29,7 @@ namespace Urho3D
 {
 
 class Audio;
+struct AmbientEmitter;
 
 /// %Sound source component with three-dimensional position.
 class URHO3D_API SoundSource3D : public SoundSource
@@ -38,6 +39,8 @@ class URHO3D_API SoundSource3D : public SoundSource
 public:
     /// Construct.
     SoundSource3D(Context* context);
+    /// Destruct. Remove own emitter from the ambisonic bed.
+    virtual ~SoundSource3D();
     /// Register object factory.
     static void RegisterObject(Context* context);
 
@@ -45,8 +48,22 @@ public:
     virtual void DrawDebugGeometry(DebugRenderer* debug, bool depthTest);
     /// Update sound source.
     virtual void Update(float timeStep);
-
-	void Play(Sound* sound);
+    /// Return squared distance to the listener for update tiering.
+    virtual float GetListenerDistanceSquared(const Vector3& listenerPosition) const;
+    /// Play an emitter cluster from this source's voice at the cluster centroid and combined gain. Called by Audio.
+    void SetClusterLeader(const Vector3& position, float gain);
+    /// Pause own voice while another cluster member plays for the cluster. Called by Audio.
+    void SetClusterMember();
+    /// Leave emitter cluster and resume own voice. Called by Audio.
+    void ClearCluster();
+    /// Play through an emitter in the ambisonic bed and pause own voice, or resume own voice with null. Called by Audio.
+    void SetAmbientEmitter(AmbientEmitter* emitter);
+    /// Set whether the source always plays through the ambisonic bed while looping, regardless of distance.
+    void SetAmbient(bool enable);
+    /// Forget the velocity used for Doppler on the next update, for example after teleporting the node.
+    void ResetVelocity() { resetVelocity_ = true; }
+    /// Set slot in the packed 3D voice parameter block. Called by Audio when slots move.
+    void SetVoice3DSlot(unsigned slot) { voice3DSlot_ = slot; }
 
     /// Set attenuation parameters.
     void SetDistanceAttenuation(float nearDistance, float farDistance, float rolloffFactor);
@@ -65,7 +82,26 @@ public:
 	/// Return rolloff power factor.
 	float RollAngleoffFactor() const { return rolloffFactor_; }
 
+    /// Return whether the source always plays through the ambisonic bed while looping.
+    bool IsAmbient() const { return ambient_; }
+
+    /// Return emitter in the ambisonic bed, or null when playing own voice.
+    AmbientEmitter* GetAmbientEmitter() const { return ambientEmitter_; }
+
+    /// Return whether this source's voice plays an emitter cluster.
+    bool IsClusterLeader() const { return clusterState_ == CLUSTER_LEADER; }
+
+    /// Return whether this source is muted as part of an emitter cluster.
+    bool IsClusterMember() const { return clusterState_ == CLUSTER_MEMBER; }
+
 protected:
+    /// Start a positional voice for the sound and return its handle.
+    virtual unsigned StartVoice(Sound* sound);
+    /// Fade the gain applied through the 3D voice block.
+    virtual void FadeVoiceGain(float targetGain, float time);
+    /// Fade the pitch applied through the 3D voice block, which multiplies in Doppler.
+    virtual void FadeVoicePitch(float targetPitch, float time);
+
     /// Near distance.
     float nearDistance_;
     /// Far distance.
@@ -73,6 +109,53 @@ protected:
     /// Rolloff power factor.
     float rolloffFactor_;
 
+private:
+    /// Remove own emitter from the ambisonic bed without resuming the voice.
+    void RemoveAmbientEmitter();
+    /// Remove own slot from the packed 3D voice parameter block.
+    void RemoveVoice3D();
+    /// Return the position to play from, moved to the apparent position through portals when the scene has a sound propagation graph.
+    Vector3 GetPropagatedPosition(const Vector3& position);
+
+    /// Emitter cluster membership.
+    enum ClusterState
+    {
+        CLUSTER_NONE = 0,
+        CLUSTER_LEADER,
+        CLUSTER_MEMBER
+    };
+
+    /// Emitter cluster membership.
+    ClusterState clusterState_;
+    /// Cluster centroid when leading a cluster.
+    Vector3 clusterPosition_;
+    /// Combined cluster gain when leading a cluster.
+    float clusterGain_;
+    /// Ambient flag.
+    bool ambient_;
+    /// Emitter in the ambisonic bed.
+    AmbientEmitter* ambientEmitter_;
+    /// Room index hint for sound propagation.
+    unsigned propagationRoom_;
+    /// Listener room index when the apparent position was last computed.
+    unsigned listenerRoom_;
+    /// Velocity reset flag, set on teleport or when the apparent position moves to another room.
+    bool resetVelocity_;
+    /// Slot in the packed 3D voice parameter block.
+    unsigned voice3DSlot_;
+    /// Gain applied to the voice, following fades.
+    float fadeGain_;
+    /// Gain fade target.
+    float fadeTargetGain_;
+    /// Gain fade speed per second, zero when not fading.
+    float fadeSpeed_;
+    /// Pitch applied to the voice, following fades.
+    float fadePitch_;
+    /// Pitch fade target.
+    float fadeTargetPitch_;
+    /// Pitch fade speed per second, zero when not fading.
+    float pitchFadeSpeed_;
+
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,361 @@
+//
+// Copyright (c) 2008-2016 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#include "../Precompiled.h"
+
+#include "../Audio/AudioEvents.h"
+#include "../Audio/SampleBuffer.h"
+#include "../Audio/Sound.h"
+#include "../Audio/SpeechCache.h"
+#include "../Core/Context.h"
+#include "../Core/CoreEvents.h"
+#include "../Core/Profiler.h"
+#include "../Core/Timer.h"
+#include "../Core/WorkQueue.h"
+#include "../IO/File.h"
+#include "../IO/FileSystem.h"
+#include "../IO/Log.h"
+#include "soloud_speech.h"
+
+#include "../DebugNew.h"
+
+namespace Urho3D
+{
+
+static const unsigned DEFAULT_SPEECH_MEMORY_BUDGET = 8 * 1024 * 1024;
+static const unsigned SPEECH_RENDER_BLOCK = 1024;
+/// Render length limit in seconds, guarding against runaway synthesis.
+static const float MAX_SPEECH_LENGTH = 60.0f;
+
+/// Phrase render job, shared between the main thread and a worker thread.
+struct SpeechJob
+{
+    /// Phrase text.
+    String text_;
+    /// Synthesis parameters.
+    SpeechParams params_;
+    /// Cache key.
+    StringHash key_;
+    /// Persisted file name, empty if not persisted.
+    String fileName_;
+    /// Execution context.
+    Context* context_;
+    /// Rendered mono samples.
+    SampleBuffer* buffer_;
+    /// Rendered length in samples.
+    unsigned sampleCount_;
+    /// Sample rate.
+    float frequency_;
+    /// Work item when rendering in the background.
+    SharedPtr<WorkItem> item_;
+};
+
+static StringHash GetPhraseKey(const String& text, const SpeechParams& params)
+{
+    return StringHash(text + "|" + String(params.pitch_) + "|" + String(params.gain_));
+}
+
+static bool LoadPhrase(SpeechJob* job)
+{
+    if (job->fileName_.Empty() || !job->context_->GetSubsystem<FileSystem>()->FileExists(job->fileName_))
+        return false;
+
+    File file(job->context_, job->fileName_);
+    if (!file.IsOpen() || file.ReadFileID() != "SPCH")
+        return false;
+
+    // The file name is only a hash, so check that it holds this phrase
+    if (file.ReadString() != job->text_ || file.ReadFloat() != job->params_.pitch_ || file.ReadFloat() != job->params_.gain_)
+        return false;
+
+    job->frequency_ = file.ReadFloat();
+    job->sampleCount_ = file.ReadUInt();
+    job->buffer_ = new SampleBuffer(job->sampleCount_ * sizeof(float));
+    if (file.Read(job->buffer_->GetData(), job->buffer_->GetSize()) != job->buffer_->GetSize())
+    {
+        job->buffer_->ReleaseRef();
+        job->buffer_ = 0;
+        return false;
+    }
+
+    return true;
+}
+
+static void SavePhrase(SpeechJob* job)
+{
+    File file(job->context_, job->fileName_, FILE_WRITE);
+    if (!file.IsOpen())
+        return;
+
+    file.WriteFileID("SPCH");
+    file.WriteString(job->text_);
+    file.WriteFloat(job->params_.pitch_);
+    file.WriteFloat(job->params_.gain_);
+    file.WriteFloat(job->frequency_);
+    file.WriteUInt(job->sampleCount_);
+    file.Write(job->buffer_->GetData(), job->buffer_->GetSize());
+}
+
+static void RenderSpeech(SpeechJob* job)
+{
+    if (LoadPhrase(job))
+        return;
+
+    SoLoud::Speech speech;
+    speech.setText(job->text_.CString());
+    SoLoud::AudioSourceInstance* instance = speech.createInstance();
+    instance->init(speech, 0);
+
+    float frequency = speech.mBaseSamplerate;
+    unsigned maxSamples = (unsigned)(MAX_SPEECH_LENGTH * frequency);
+    PODVector<float> samples;
+    while (!instance->hasEnded() && samples.Size() < maxSamples)
+    {
+        unsigned start = samples.Size();
+        samples.Resize(start + SPEECH_RENDER_BLOCK);
+        instance->getAudio(&samples[start], SPEECH_RENDER_BLOCK);
+    }
+    delete instance;
+
+    // Resample for pitch with linear interpolation
+    float pitch = Max(job->params_.pitch_, M_EPSILON);
+    unsigned count = samples.Size() > 1 ? (unsigned)((samples.Size() - 1) / pitch) : 0;
+    job->buffer_ = new SampleBuffer(count * sizeof(float));
+    float* dest = job->buffer_->GetSamples();
+    for (unsigned i = 0; i < count; ++i)
+    {
+        float position = i * pitch;
+        unsigned index = (unsigned)position;
+        float fract = position - index;
+        dest[i] = Lerp(samples[index], samples[index + 1], fract) * job->params_.gain_;
+    }
+
+    job->sampleCount_ = count;
+    job->frequency_ = frequency;
+
+    if (!job->fileName_.Empty())
+        SavePhrase(job);
+}
+
+static void RenderSpeechWork(const WorkItem* item, unsigned threadIndex)
+{
+    RenderSpeech(static_cast<SpeechJob*>(item->aux_));
+}
+
+SpeechCache::SpeechCache(Context* context) :
+    Object(context),
+    memoryBudget_(DEFAULT_SPEECH_MEMORY_BUDGET),
+    memoryUse_(0),
+    useCounter_(0)
+{
+    SubscribeToEvent(E_WORKITEMCOMPLETED, URHO3D_HANDLER(SpeechCache, HandleWorkItemCompleted));
+}
+
+SpeechCache::~SpeechCache()
+{
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+
+    for (HashMap<StringHash, SpeechJob*>::Iterator i = pendingJobs_.Begin(); i != pendingJobs_.End(); ++i)
+    {
+        SpeechJob* job = i->second_;
+        // Renders already running must finish before their job can be freed
+        if (!queue || !queue->RemoveWorkItem(job->item_))
+        {
+            while (!job->item_->completed_)
+                Time::Sleep(1);
+        }
+
+        if (job->buffer_)
+            job->buffer_->ReleaseRef();
+        delete job;
+    }
+}
+
+Sound* SpeechCache::GetPhrase(const String& text, const SpeechParams& params)
+{
+    StringHash key = GetPhraseKey(text, params);
+
+    HashMap<StringHash, Phrase>::Iterator i = phrases_.Find(key);
+    if (i != phrases_.End())
+    {
+        i->second_.lastUse_ = ++useCounter_;
+        return i->second_.sound_;
+    }
+
+    if (pendingJobs_.Contains(key) || failedPhrases_.Contains(key))
+        return 0;
+
+    WorkQueue* queue = GetSubsystem<WorkQueue>();
+    if (!queue)
+        return RenderPhrase(text, params);
+
+    SpeechJob* job = new SpeechJob();
+    job->text_ = text;
+    job->params_ = params;
+    job->key_ = key;
+    job->fileName_ = cacheDir_.Empty() ? String::EMPTY : cacheDir_ + key.ToString() + ".spc";
+    job->context_ = context_;
+    job->buffer_ = 0;
+    job->sampleCount_ = 0;
+    job->frequency_ = 0.0f;
+
+    job->item_ = queue->GetFreeItem();
+    job->item_->workFunction_ = RenderSpeechWork;
+    job->item_->aux_ = job;
+    job->item_->priority_ = 0;
+    job->item_->sendEvent_ = true;
+    pendingJobs_[key] = job;
+    queue->AddWorkItem(job->item_);
+
+    return 0;
+}
+
+Sound* SpeechCache::RenderPhrase(const String& text, const SpeechParams& params)
+{
+    StringHash key = GetPhraseKey(text, params);
+
+    HashMap<StringHash, Phrase>::Iterator i = phrases_.Find(key);
+    if (i != phrases_.End())
+    {
+        i->second_.lastUse_ = ++useCounter_;
+        return i->second_.sound_;
+    }
+
+    if (failedPhrases_.Contains(key))
+        return 0;
+
+    URHO3D_PROFILE(RenderSpeech);
+
+    SpeechJob job;
+    job.text_ = text;
+    job.params_ = params;
+    job.key_ = key;
+    job.fileName_ = cacheDir_.Empty() ? String::EMPTY : cacheDir_ + key.ToString() + ".spc";
+    job.context_ = context_;
+    job.buffer_ = 0;
+    job.sampleCount_ = 0;
+    job.frequency_ = 0.0f;
+    RenderSpeech(&job);
+
+    return AddPhrase(&job);
+}
+
+void SpeechCache::SetMemoryBudget(unsigned bytes)
+{
+    memoryBudget_ = bytes;
+    ApplyMemoryBudget();
+}
+
+void SpeechCache::SetCacheDir(const String& pathName)
+{
+    cacheDir_ = pathName.Empty() ? String::EMPTY : AddTrailingSlash(pathName);
+
+    if (!cacheDir_.Empty())
+    {
+        FileSystem* fileSystem = GetSubsystem<FileSystem>();
+        if (!fileSystem->DirExists(cacheDir_) && !fileSystem->CreateDir(cacheDir_))
+        {
+            URHO3D_LOGERROR("Could not create speech cache directory " + cacheDir_);
+            cacheDir_.Clear();
+        }
+    }
+}
+
+void SpeechCache::Clear()
+{
+    phrases_.Clear();
+    failedPhrases_.Clear();
+    memoryUse_ = 0;
+}
+
+void SpeechCache::HandleWorkItemCompleted(StringHash eventType, VariantMap& eventData)
+{
+    using namespace WorkItemCompleted;
+
+    WorkItem* item = static_cast<WorkItem*>(eventData[P_ITEM].GetPtr());
+    if (!item || item->workFunction_ != RenderSpeechWork)
+        return;
+
+    SpeechJob* job = static_cast<SpeechJob*>(item->aux_);
+    pendingJobs_.Erase(job->key_);
+
+    String text = job->text_;
+    SharedPtr<Sound> sound(AddPhrase(job));
+    delete job;
+
+    if (sound)
+    {
+        using namespace SpeechRendered;
+
+        VariantMap& newEventData = GetEventDataMap();
+        newEventData[P_TEXT] = text;
+        newEventData[P_SOUND] = sound;
+        SendEvent(E_SPEECHRENDERED, newEventData);
+    }
+}
+
+Sound* SpeechCache::AddPhrase(SpeechJob* job)
+{
+    if (!job->buffer_ || !job->sampleCount_)
+    {
+        // Remember the failure so that the phrase is not requeued on every request; the error is logged once
+        URHO3D_LOGERROR("Could not render speech \"" + job->text_ + "\"");
+        failedPhrases_.Insert(job->key_);
+        if (job->buffer_)
+            job->buffer_->ReleaseRef();
+        job->buffer_ = 0;
+        return 0;
+    }
+
+    SharedPtr<Sound> sound(new Sound(context_));
+    sound->SetName("Speech/" + job->key_.ToString());
+    sound->SetData(job->buffer_, job->sampleCount_, 1, job->frequency_);
+    job->buffer_ = 0;
+
+    Phrase& phrase = phrases_[job->key_];
+    phrase.sound_ = sound;
+    phrase.lastUse_ = ++useCounter_;
+    memoryUse_ += sound->GetMemoryUse();
+
+    ApplyMemoryBudget();
+    return sound;
+}
+
+void SpeechCache::ApplyMemoryBudget()
+{
+    // Voices keep their data until they end, so phrases can be dropped while playing
+    while (memoryUse_ > memoryBudget_ && phrases_.Size() > 1)
+    {
+        HashMap<StringHash, Phrase>::Iterator oldest = phrases_.Begin();
+        for (HashMap<StringHash, Phrase>::Iterator i = phrases_.Begin(); i != phrases_.End(); ++i)
+        {
+            if (i->second_.lastUse_ < oldest->second_.lastUse_)
+                oldest = i;
+        }
+
+        memoryUse_ -= oldest->second_.sound_->GetMemoryUse();
+        phrases_.Erase(oldest);
+    }
+}
+
+}
@@ -0,0 +1,119 @@
+//
+// Copyright (c) 2008-2016 the Urho3D project.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+
+#pragma once
+
+#include "../Container/HashMap.h"
+#include "../Container/HashSet.h"
+#include "../Core/Object.h"
+
+namespace Urho3D
+{
+
+class Sound;
+struct SpeechJob;
+
+/// Speech synthesis parameters.
+struct URHO3D_API SpeechParams
+{
+    /// Construct with defaults.
+    SpeechParams() :
+        pitch_(1.0f),
+        gain_(1.0f)
+    {
+    }
+
+    /// Pitch multiplier, applied by resampling the rendered phrase. Also changes the speaking rate.
+    float pitch_;
+    /// Gain applied to the rendered samples.
+    float gain_;
+};
+
+/// %Speech cache subsystem. Renders text-to-speech phrases to PCM on worker threads and keeps them as sounds in a memory limited LRU cache, optionally persisted to disk.
+class URHO3D_API SpeechCache : public Object
+{
+    URHO3D_OBJECT(SpeechCache, Object);
+
+public:
+    /// Construct.
+    SpeechCache(Context* context);
+    /// Destruct. Wait for renders in progress.
+    virtual ~SpeechCache();
+
+    /// Return the sound for a phrase if it has been rendered. Otherwise queue rendering on a worker thread and return null; E_SPEECHRENDERED is sent when ready. Phrases that failed to render return null without retrying.
+    Sound* GetPhrase(const String& text, const SpeechParams& params = SpeechParams());
+    /// Return the sound for a phrase, rendering it immediately if not cached.
+    Sound* RenderPhrase(const String& text, const SpeechParams& params = SpeechParams());
+    /// Set memory budget in bytes for rendered phrases. Least recently used phrases are dropped beyond it.
+    void SetMemoryBudget(unsigned bytes);
+    /// Set directory to persist rendered phrases in. Empty disables persistence.
+    void SetCacheDir(const String& pathName);
+    /// Drop all rendered phrases from memory and forget failed renders, so that they are retried.
+    void Clear();
+
+    /// Return memory budget in bytes.
+    unsigned GetMemoryBudget() const { return memoryBudget_; }
+
+    /// Return memory use of rendered phrases in bytes.
+    unsigned GetMemoryUse() const { return memoryUse_; }
+
+    /// Return number of rendered phrases in memory.
+    unsigned GetNumPhrases() const { return phrases_.Size(); }
+
+    /// Return persistence directory.
+    const String& GetCacheDir() const { return cacheDir_; }
+
+private:
+    /// Rendered phrase entry.
+    struct Phrase
+    {
+        /// Sound holding the samples.
+        SharedPtr<Sound> sound_;
+        /// Use counter value when last requested.
+        unsigned lastUse_;
+    };
+
+    /// Handle work item completed event to finish background renders.
+    void HandleWorkItemCompleted(StringHash eventType, VariantMap& eventData);
+    /// Create a sound from a finished job and add it to the cache.
+    Sound* AddPhrase(SpeechJob* job);
+    /// Drop least recently used phrases until within the memory budget.
+    void ApplyMemoryBudget();
+
+    /// Rendered phrases by key.
+    HashMap<StringHash, Phrase> phrases_;
+    /// Keys of phrases that failed to render.
+    HashSet<StringHash> failedPhrases_;
+    /// Background renders by key.
+    HashMap<StringHash, SpeechJob*> pendingJobs_;
+    /// Persistence directory.
+    String cacheDir_;
+    /// Memory budget in bytes.
+    unsigned memoryBudget_;
+    /// Memory use in bytes.
+    unsigned memoryUse_;
+    /// Use counter for LRU ordering.
+    unsigned useCounter_;
+};
+
+}